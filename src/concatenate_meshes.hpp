@@ -0,0 +1,261 @@
+#ifndef DVIDUTILS_CONCATENATE_MESHES_HPP
+#define DVIDUTILS_CONCATENATE_MESHES_HPP
+
+#include <cstdint>
+#include <array>
+#include <vector>
+#include <tuple>
+#include <sstream>
+#include <limits>
+#include <unordered_set>
+#include <algorithm>
+
+#include <boost/functional/hash.hpp>
+
+#include "pybind11/pybind11.h"
+#include "pybind11/stl.h"
+
+#include "pydraco.hpp"
+#include "parallel.hpp"
+
+using std::size_t;
+using std::uint32_t;
+
+namespace dvidutils
+{
+    // Find the duplicate rows of a row-major (N,3) vertex buffer.
+    //
+    // On return, vertex_map[i] is the index of vertex i in the deduplicated vertex list,
+    // and first_indexes lists the original index of each unique vertex, in order of first appearance.
+    // (So the deduplicated list is vertices[first_indexes], and the surviving vertices keep their relative order.)
+    //
+    // Vertices are hashed in parallel, and then split into one shard per thread (by hash),
+    // so each thread can find the duplicates within its own shard independently.
+    void weld_vertices( float const * vertices,
+                        size_t vertex_count,
+                        int num_threads,
+                        std::vector<uint32_t> & vertex_map,
+                        std::vector<uint32_t> & first_indexes )
+    {
+        size_t const block_size = 65536;
+        size_t num_blocks = (vertex_count + block_size - 1) / block_size;
+
+        std::vector<size_t> hashes(vertex_count);
+        parallel_for(num_blocks, num_threads, [&](size_t block) {
+            size_t end = std::min((block + 1) * block_size, vertex_count);
+            for (size_t i = block * block_size; i < end; ++i)
+            {
+                size_t hash = 0;
+                boost::hash_combine(hash, vertices[3*i + 0]);
+                boost::hash_combine(hash, vertices[3*i + 1]);
+                boost::hash_combine(hash, vertices[3*i + 2]);
+                hashes[i] = hash;
+            }
+        });
+
+        // As in remap_duplicates(), the sets store vertex indexes rather than the vertices themselves.
+        auto hasher = [&](uint32_t index) { return hashes[index]; };
+        auto comparer = [&](uint32_t left, uint32_t right) {
+            return vertices[3*left + 0] == vertices[3*right + 0]
+                && vertices[3*left + 1] == vertices[3*right + 1]
+                && vertices[3*left + 2] == vertices[3*right + 2];
+        };
+        typedef std::unordered_set<uint32_t, decltype(hasher), decltype(comparer)> index_set_t;
+
+        // First, map each vertex to the first index at which it appears.
+        // Shards are scanned in index order, so the first occurrence is always the one inserted.
+        vertex_map.resize(vertex_count);
+        size_t num_shards = resolve_num_threads(num_threads, vertex_count / block_size);
+        parallel_for(num_shards, num_threads, [&](size_t shard) {
+            index_set_t first_occurrences(10, hasher, comparer);
+            for (size_t i = 0; i < vertex_count; ++i)
+            {
+                if (hashes[i] % num_shards == shard)
+                {
+                    vertex_map[i] = *(first_occurrences.insert(uint32_t(i)).first);
+                }
+            }
+        });
+
+        // Then number the unique vertices in order.
+        // Every vertex's first occurrence precedes it, so it has already been renumbered.
+        first_indexes.clear();
+        for (size_t i = 0; i < vertex_count; ++i)
+        {
+            if (vertex_map[i] == i)
+            {
+                vertex_map[i] = uint32_t(first_indexes.size());
+                first_indexes.push_back(uint32_t(i));
+            }
+            else
+            {
+                vertex_map[i] = vertex_map[vertex_map[i]];
+            }
+        }
+    }
+
+    // Combine a list of (vertices, normals, faces) meshes into a single mesh.
+    //
+    // The output arrays are allocated once, at their final size, and each mesh is copied
+    // into its own portion of them in parallel (with the GIL released), with its face indexes
+    // offset to refer to its own vertices in the combined vertices array.
+    //
+    // As with decode_many_drc_bytes(concatenate=True), the combined normals are only returned
+    // if every (non-empty) mesh has normals.  Otherwise, the returned normals array is empty.
+    //
+    // If deduplicate is true, duplicate vertices (e.g. along the boundaries between supervoxels)
+    // are welded together: Only the first occurrence of each vertex (and its normal) is kept,
+    // and the faces are remapped accordingly, just as remap_duplicates() would prescribe.
+    std::tuple<vertices_array_t, normals_array_t, faces_array_t>
+    concatenate_meshes( std::vector<mesh_arrays_t> const & meshes,
+                        bool deduplicate,
+                        int num_threads )
+    {
+        size_t mesh_count = meshes.size();
+
+        std::vector<size_t> vertex_offsets(mesh_count+1, 0);
+        std::vector<size_t> face_offsets(mesh_count+1, 0);
+        bool all_normals = true;
+        for (size_t i = 0; i < mesh_count; ++i)
+        {
+            check_rows(std::get<0>(meshes[i]), 3, "vertices");
+            check_rows(std::get<1>(meshes[i]), 3, "normals");
+            check_rows(std::get<2>(meshes[i]), 3, "faces");
+
+            size_t vertex_count = std::get<0>(meshes[i]).shape()[0];
+            size_t normal_count = std::get<1>(meshes[i]).shape()[0];
+            size_t face_count = std::get<2>(meshes[i]).shape()[0];
+
+            if (normal_count != 0 && normal_count != vertex_count)
+            {
+                std::ostringstream ss;
+                ss << "Mesh " << i << ": normals array size does not correspond to vertices array size";
+                throw std::runtime_error(ss.str());
+            }
+            if (normal_count == 0 && vertex_count > 0)
+            {
+                all_normals = false;
+            }
+
+            vertex_offsets[i+1] = vertex_offsets[i] + vertex_count;
+            face_offsets[i+1] = face_offsets[i] + face_count;
+        }
+
+        size_t total_vertices = vertex_offsets[mesh_count];
+        size_t total_faces = face_offsets[mesh_count];
+        if (total_vertices > std::numeric_limits<uint32_t>::max())
+        {
+            throw std::runtime_error("Concatenated mesh has too many vertices for uint32 face indexes");
+        }
+
+        // Copy mesh i into the given (combined) buffers.
+        auto copy_mesh = [&](size_t i, float * vertices, float * normals, uint32_t * faces) {
+            auto const & mesh = meshes[i];
+            size_t vertex_count = vertex_offsets[i+1] - vertex_offsets[i];
+            size_t face_count = face_offsets[i+1] - face_offsets[i];
+
+            std::vector<float> vertices_scratch;
+            float const * mesh_vertices = packed_rows(std::get<0>(mesh), vertices_scratch);
+            std::copy(mesh_vertices, mesh_vertices + 3*vertex_count, vertices + 3*vertex_offsets[i]);
+
+            if (normals != nullptr)
+            {
+                std::vector<float> normals_scratch;
+                float const * mesh_normals = packed_rows(std::get<1>(mesh), normals_scratch);
+                std::copy(mesh_normals, mesh_normals + 3*vertex_count, normals + 3*vertex_offsets[i]);
+            }
+
+            std::vector<uint32_t> faces_scratch;
+            uint32_t const * mesh_faces = packed_rows(std::get<2>(mesh), faces_scratch);
+            uint32_t * out_faces = faces + 3*face_offsets[i];
+            uint32_t offset = uint32_t(vertex_offsets[i]);
+            for (size_t j = 0; j < 3*face_count; ++j)
+            {
+                if (mesh_faces[j] >= vertex_count)
+                {
+                    std::ostringstream ss;
+                    ss << "Mesh " << i << ": Face indexes exceed vertices length";
+                    throw std::runtime_error(ss.str());
+                }
+                out_faces[j] = mesh_faces[j] + offset;
+            }
+        };
+
+        if (!deduplicate)
+        {
+            vertices_array_t::shape_type verts_shape = {{total_vertices, 3}};
+            vertices_array_t vertices(verts_shape);
+
+            normals_array_t::shape_type normals_shape = {{all_normals ? total_vertices : 0, 3}};
+            normals_array_t normals(normals_shape);
+
+            faces_array_t::shape_type faces_shape = {{total_faces, 3}};
+            faces_array_t faces(faces_shape);
+
+            {
+                py::gil_scoped_release nogil;
+                parallel_for(mesh_count, num_threads, [&](size_t i) {
+                    copy_mesh(i, vertices.data(), all_normals ? normals.data() : nullptr, faces.data());
+                });
+            }
+            return std::make_tuple( std::move(vertices), std::move(normals), std::move(faces) );
+        }
+
+        // Deduplicate: Combine into temporary buffers first,
+        // since the final vertex count isn't known until the duplicates have been found.
+        std::vector<float> combined_vertices(3 * total_vertices);
+        std::vector<float> combined_normals(all_normals ? 3 * total_vertices : 0);
+        std::vector<uint32_t> combined_faces(3 * total_faces);
+        std::vector<uint32_t> vertex_map;
+        std::vector<uint32_t> first_indexes;
+        {
+            py::gil_scoped_release nogil;
+            parallel_for(mesh_count, num_threads, [&](size_t i) {
+                copy_mesh(i, combined_vertices.data(), all_normals ? combined_normals.data() : nullptr, combined_faces.data());
+            });
+
+            weld_vertices(combined_vertices.data(), total_vertices, num_threads, vertex_map, first_indexes);
+        }
+
+        vertices_array_t::shape_type verts_shape = {{first_indexes.size(), 3}};
+        vertices_array_t vertices(verts_shape);
+
+        normals_array_t::shape_type normals_shape = {{all_normals ? first_indexes.size() : 0, 3}};
+        normals_array_t normals(normals_shape);
+
+        faces_array_t::shape_type faces_shape = {{total_faces, 3}};
+        faces_array_t faces(faces_shape);
+
+        {
+            py::gil_scoped_release nogil;
+
+            size_t const block_size = 65536;
+            size_t num_vertex_blocks = (first_indexes.size() + block_size - 1) / block_size;
+            parallel_for(num_vertex_blocks, num_threads, [&](size_t block) {
+                size_t end = std::min((block + 1) * block_size, first_indexes.size());
+                for (size_t v = block * block_size; v < end; ++v)
+                {
+                    size_t source = first_indexes[v];
+                    std::copy_n(&combined_vertices[3*source], 3, vertices.data() + 3*v);
+                    if (all_normals)
+                    {
+                        std::copy_n(&combined_normals[3*source], 3, normals.data() + 3*v);
+                    }
+                }
+            });
+
+            size_t num_face_blocks = (3*total_faces + block_size - 1) / block_size;
+            parallel_for(num_face_blocks, num_threads, [&](size_t block) {
+                size_t end = std::min((block + 1) * block_size, 3*total_faces);
+                for (size_t j = block * block_size; j < end; ++j)
+                {
+                    faces.data()[j] = vertex_map[combined_faces[j]];
+                }
+            });
+        }
+
+        return std::make_tuple( std::move(vertices), std::move(normals), std::move(faces) );
+    }
+}
+
+#endif
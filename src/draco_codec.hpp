@@ -0,0 +1,155 @@
+#ifndef DVIDUTILS_DRACO_CODEC_HPP
+#define DVIDUTILS_DRACO_CODEC_HPP
+
+#include <mutex>
+#include <tuple>
+
+#include "pydraco.hpp"
+
+// A draco encoder/decoder with fixed settings, for encoding or decoding
+// many (typically small) meshes in a row.
+//
+// The draco::Encoder is configured once, at construction, and the output buffer and
+// the scratch space for packed/quantized inputs are kept between calls, so their storage
+// is only reallocated when a mesh is larger than any previous one.
+// (With return_buffer=True, each result gets a buffer of its own, which the DracoBuffer owns.)
+// (The draco::Mesh itself is still built anew for each call, since draco offers no way
+// to reset a mesh after its attributes and points have been deduplicated.)
+//
+// Each method releases the GIL while it works.  The reusable state belongs to the
+// instance, so the intended use is one instance per thread.  Calls on a shared
+// instance are serialized by an internal mutex, so they're safe, but not concurrent.
+class DracoCodec
+{
+public:
+    typedef std::tuple<vertices_array_t, normals_array_t, faces_array_t> mesh_tuple_t;
+
+    DracoCodec( int compression_level,
+                int position_quantization_bits,
+                int normal_quantization_bits,
+                int generic_quantization_bits,
+                bool compute_normals )
+    {
+        _settings.compression_level = compression_level;
+        _settings.position_quantization_bits = position_quantization_bits;
+        _settings.normal_quantization_bits = normal_quantization_bits;
+        _settings.generic_quantization_bits = generic_quantization_bits;
+        _settings.compute_normals = compute_normals;
+
+        configure_encoder(_encoder, _settings, false);
+        configure_encoder(_custom_encoder, _settings, true);
+    }
+
+    DracoEncoderSettings const & settings() const { return _settings; }
+
+    // Same as encode_faces_to_drc_bytes(), with this codec's settings.
+    py::object encode( vertices_array_t const & vertices,
+                       normals_array_t const & normals,
+                       faces_array_t const & faces,
+                       bool return_buffer,
+                       py::dict const & attributes )
+    {
+        return encode_with_lock(vertices, normals, faces, nullptr, _encoder, return_buffer, attributes);
+    }
+
+    // Same as encode_faces_to_custom_drc_bytes() (with do_custom=True),
+    // with this codec's settings.
+    py::object encode_custom( vertices_array_t const & vertices,
+                              normals_array_t const & normals,
+                              faces_array_t const & faces,
+                              coords_t const & fragment_shape,
+                              coords_t const & fragment_origin,
+                              bool return_buffer,
+                              py::dict const & attributes )
+    {
+        if (fragment_shape.size() != 3 || fragment_origin.size() != 3)
+        {
+            throw std::runtime_error("fragment_shape and fragment_origin must each have 3 elements");
+        }
+        Quantizer quantizer(fragment_shape, fragment_origin, _settings.position_quantization_bits);
+        return encode_with_lock(vertices, normals, faces, &quantizer, _custom_encoder, return_buffer, attributes);
+    }
+
+    // Same as decode_drc_bytes_to_faces().
+    py::object decode( py::bytes const & drc_bytes, bool deduplicate, bool return_attributes )
+    {
+        GenericAttributeArrays attributes;
+        auto mesh = decode_with_lock(drc_bytes, deduplicate, nullptr, return_attributes ? &attributes : nullptr);
+        return decoded_mesh_to_python(std::move(mesh), return_attributes ? &attributes : nullptr);
+    }
+
+    // Same as decode_custom_drc_bytes_to_faces(), with this codec's position_quantization_bits.
+    mesh_tuple_t decode_custom( py::bytes const & drc_bytes,
+                                coords_t const & fragment_shape,
+                                coords_t const & fragment_origin,
+                                bool deduplicate )
+    {
+        if (fragment_shape.size() != 3 || fragment_origin.size() != 3)
+        {
+            throw std::runtime_error("fragment_shape and fragment_origin must each have 3 elements");
+        }
+        Quantizer dequantizer(fragment_shape, fragment_origin, _settings.position_quantization_bits);
+        return decode_with_lock(drc_bytes, deduplicate, &dequantizer);
+    }
+
+private:
+    DracoEncoderSettings _settings;
+
+    draco::Encoder _encoder;
+    draco::Encoder _custom_encoder;
+    draco::Decoder _decoder;
+
+    draco::EncoderBuffer _buffer;
+    DracoEncoderScratch _scratch;
+
+    std::mutex _mutex;
+
+    py::object encode_with_lock( vertices_array_t const & vertices,
+                                 normals_array_t const & normals,
+                                 faces_array_t const & faces,
+                                 Quantizer const * quantizer,
+                                 draco::Encoder & encoder,
+                                 bool return_buffer,
+                                 py::dict const & attributes )
+    {
+        std::vector<py::array> attribute_arrays;
+        auto generic_attributes = generic_attributes_from_dict(attributes, vertices.shape()[0], attribute_arrays);
+
+        // A returned DracoBuffer owns its storage, so it can't reuse _buffer.
+        DracoBufferPtr result(return_buffer ? new DracoBuffer() : nullptr);
+
+        std::unique_lock<std::mutex> lock(_mutex, std::defer_lock);
+        {
+            py::gil_scoped_release nogil;
+            lock.lock();
+            draco::EncoderBuffer & buf = return_buffer ? result->buffer() : _buffer;
+            buf.Clear();
+            encode_mesh_to_buffer( vertices, normals, faces, quantizer, _settings,
+                                   buf, &_scratch, &encoder, &generic_attributes );
+        }
+
+        if (return_buffer)
+        {
+            return encoded_buffer_to_python(std::move(result), true);
+        }
+
+        // The mutex is still held, so _buffer can't change while we copy it.
+        return py::bytes(_buffer.data(), _buffer.size());
+    }
+
+    mesh_tuple_t decode_with_lock( py::bytes const & drc_bytes,
+                                   bool deduplicate,
+                                   Quantizer const * dequantizer,
+                                   GenericAttributeArrays * attributes = nullptr )
+    {
+        // Wait for the mutex without holding the GIL.
+        std::unique_lock<std::mutex> lock(_mutex, std::defer_lock);
+        {
+            py::gil_scoped_release nogil;
+            lock.lock();
+        }
+        return decode_drc_bytes_to_arrays(drc_bytes, deduplicate, dequantizer, &_decoder, attributes);
+    }
+};
+
+#endif
@@ -0,0 +1,450 @@
+#ifndef DVIDUTILS_DRACO_INFO_HPP
+#define DVIDUTILS_DRACO_INFO_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <array>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <limits>
+#include <algorithm>
+
+#include "draco/core/decoder_buffer.h"
+#include "draco/core/varint_decoding.h"
+#include "draco/core/quantization_utils.h"
+#include "draco/metadata/metadata_decoder.h"
+#include "draco/attributes/attribute_quantization_transform.h"
+#include "draco/compression/config/compression_shared.h"
+#include "draco/compression/decode.h"
+
+#include "pybind11/pybind11.h"
+#include "pybind11/stl.h"
+
+#include "pydraco.hpp"
+#include "parallel.hpp"
+
+namespace py = pybind11;
+using namespace pybind11::literals;
+
+// Summary of one attribute of a decoded draco geometry
+struct DracoAttributeInfo
+{
+    std::string type;                   // 'position', 'normal', 'color', 'tex_coord', or 'generic'
+    std::string data_type;              // numpy-style name, e.g. 'float32'
+    int num_components = 0;
+    size_t value_count = 0;             // number of unique attribute values
+
+    // Quantization parameters (positions only, and only if they were quantized)
+    int quantization_bits = 0;
+    std::vector<float> quantization_origin;
+    float quantization_range = 0.0f;
+};
+
+// Summary of a draco buffer, as produced by inspect_draco_buffer()
+struct DracoInfo
+{
+    bool empty = false;                 // An empty buffer (e.g. from encoding an empty mesh)
+
+    std::string geometry_type;          // 'triangular_mesh' or 'point_cloud'
+    std::string encoding_method;        // 'sequential', 'edgebreaker', or 'kd_tree'
+    int version_major = 0;
+    int version_minor = 0;
+    bool has_metadata = false;
+
+    size_t point_count = 0;
+    size_t face_count = 0;
+
+    // Only filled in if the attributes were inspected
+    bool has_attributes = false;
+    std::vector<DracoAttributeInfo> attributes;
+    bool has_bounds = false;
+    std::array<float, 3> bounds_min{{ 0.0f, 0.0f, 0.0f }};
+    std::array<float, 3> bounds_max{{ 0.0f, 0.0f, 0.0f }};
+};
+
+char const * draco_attribute_type_name( draco::GeometryAttribute::Type type )
+{
+    using namespace draco;
+    switch (type)
+    {
+        case GeometryAttribute::POSITION:  return "position";
+        case GeometryAttribute::NORMAL:    return "normal";
+        case GeometryAttribute::COLOR:     return "color";
+        case GeometryAttribute::TEX_COORD: return "tex_coord";
+        default:                           return "generic";
+    }
+}
+
+char const * draco_data_type_name( draco::DataType data_type )
+{
+    using namespace draco;
+    switch (data_type)
+    {
+        case DT_INT8:    return "int8";
+        case DT_UINT8:   return "uint8";
+        case DT_INT16:   return "int16";
+        case DT_UINT16:  return "uint16";
+        case DT_INT32:   return "int32";
+        case DT_UINT32:  return "uint32";
+        case DT_INT64:   return "int64";
+        case DT_UINT64:  return "uint64";
+        case DT_FLOAT32: return "float32";
+        case DT_FLOAT64: return "float64";
+        case DT_BOOL:    return "bool";
+        default:         return "invalid";
+    }
+}
+
+// Bitstream versions are compared as (major << 8) | minor
+uint16_t draco_bitstream_version( int major, int minor )
+{
+    return static_cast<uint16_t>((major << 8) | minor);
+}
+
+// Read a draco varint (or, for bitstreams older than 2.0, a plain uint32)
+bool decode_draco_count( draco::DecoderBuffer & buf, bool is_varint, uint32_t & count )
+{
+    if (is_varint)
+    {
+        return draco::DecodeVarint(&count, &buf);
+    }
+    return buf.Decode(&count);
+}
+
+// Read the header and the geometry counts of a draco buffer, without decoding the connectivity.
+//
+// The layout (see draco's PointCloudDecoder and MeshDecoder) is:
+//
+//   "DRACO", version_major: u8, version_minor: u8, encoder_type: u8, encoder_method: u8, flags: u16
+//   [metadata, if flags & 0x8000]
+//   mesh, sequential:       num_faces, num_points               (varints since 2.2, u32 before)
+//   mesh, edgebreaker:      traversal_type: u8, [num_new_vertices (2.0-2.1 only)],
+//                           num_encoded_vertices, num_faces     (varints since 2.0, u32 before)
+//   point cloud (either):   num_points: i32
+//
+// For edgebreaker meshes, point_count is the number of encoded vertices.
+// Meshes whose non-position attributes have seams decode to somewhat more points than that.
+void read_draco_header( char const * raw_buf, size_t bytes_length, DracoInfo & info )
+{
+    using namespace draco;
+
+    auto fail = [](char const * what) {
+        std::ostringstream ss;
+        ss << "Could not inspect draco buffer: " << what;
+        throw std::runtime_error(ss.str());
+    };
+
+    DecoderBuffer buf;
+    buf.Init(raw_buf, bytes_length);
+
+    char magic[5];
+    uint8_t version_major, version_minor, encoder_type, encoder_method;
+    uint16_t flags;
+    if ( !buf.Decode(magic, 5) || std::memcmp(magic, "DRACO", 5) != 0 )
+    {
+        fail("Not a draco buffer");
+    }
+    if ( !buf.Decode(&version_major) || !buf.Decode(&version_minor)
+         || !buf.Decode(&encoder_type) || !buf.Decode(&encoder_method)
+         || !buf.Decode(&flags) )
+    {
+        fail("Truncated header");
+    }
+
+    info.version_major = version_major;
+    info.version_minor = version_minor;
+    info.has_metadata = (flags & 0x8000) != 0;
+    uint16_t version = draco_bitstream_version(version_major, version_minor);
+    buf.set_bitstream_version(version);
+
+    if (info.has_metadata)
+    {
+        MetadataDecoder metadata_decoder;
+        GeometryMetadata metadata;
+        if (!metadata_decoder.DecodeGeometryMetadata(&buf, &metadata))
+        {
+            fail("Bad metadata");
+        }
+    }
+
+    if (encoder_type == POINT_CLOUD)
+    {
+        info.geometry_type = "point_cloud";
+        info.encoding_method = (encoder_method == POINT_CLOUD_SEQUENTIAL_ENCODING) ? "sequential" : "kd_tree";
+
+        int32_t num_points;
+        if (!buf.Decode(&num_points) || num_points < 0)
+        {
+            fail("Bad point count");
+        }
+        info.point_count = num_points;
+        return;
+    }
+
+    if (encoder_type != TRIANGULAR_MESH)
+    {
+        fail("Unknown geometry type");
+    }
+    info.geometry_type = "triangular_mesh";
+
+    uint32_t num_faces = 0;
+    uint32_t num_points = 0;
+    if (encoder_method == MESH_SEQUENTIAL_ENCODING)
+    {
+        info.encoding_method = "sequential";
+        bool is_varint = (version >= draco_bitstream_version(2, 2));
+        if ( !decode_draco_count(buf, is_varint, num_faces) || !decode_draco_count(buf, is_varint, num_points) )
+        {
+            fail("Truncated connectivity header");
+        }
+    }
+    else if (encoder_method == MESH_EDGEBREAKER_ENCODING)
+    {
+        info.encoding_method = "edgebreaker";
+        bool is_varint = (version >= draco_bitstream_version(2, 0));
+
+        uint8_t traversal_type;
+        uint32_t num_new_vertices = 0;
+        if (!buf.Decode(&traversal_type))
+        {
+            fail("Truncated connectivity header");
+        }
+        if ( version < draco_bitstream_version(2, 2)
+             && !decode_draco_count(buf, is_varint, num_new_vertices) )
+        {
+            fail("Truncated connectivity header");
+        }
+        if ( !decode_draco_count(buf, is_varint, num_points) || !decode_draco_count(buf, is_varint, num_faces) )
+        {
+            fail("Truncated connectivity header");
+        }
+        num_points += num_new_vertices;
+    }
+    else
+    {
+        fail("Unknown mesh encoding method");
+    }
+
+    info.point_count = num_points;
+    info.face_count = num_faces;
+}
+
+// Find the per-component min and max of a (non-empty) 3-component attribute's values.
+template <typename T>
+void scan_attribute_bounds( draco::PointAttribute const & att, std::array<T, 3> & bounds_min, std::array<T, 3> & bounds_max )
+{
+    bounds_min.fill(std::numeric_limits<T>::max());
+    bounds_max.fill(std::numeric_limits<T>::lowest());
+    std::array<T, 3> value;
+    for (draco::AttributeValueIndex i(0); i < att.size(); ++i)
+    {
+        att.ConvertValue<T, 3>(i, &value[0]);
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            bounds_min[axis] = std::min(bounds_min[axis], value[axis]);
+            bounds_max[axis] = std::max(bounds_max[axis], value[axis]);
+        }
+    }
+}
+
+// Fully decode a draco buffer to report its attributes and bounds.
+// Position dequantization is skipped, so the quantization parameters can be read back
+// from the attribute.  The bounds are found by scanning the position values: for quantized
+// positions, only the smallest and largest quantized values are dequantized, which gives
+// the same bounds as scanning the dequantized positions.
+void read_draco_attributes( char const * raw_buf, size_t bytes_length, DracoInfo & info )
+{
+    using namespace draco;
+
+    DecoderBuffer buf;
+    buf.Init(raw_buf, bytes_length);
+
+    Decoder decoder;
+    decoder.SetSkipAttributeTransform(GeometryAttribute::POSITION);
+
+    auto decoded = decoder.DecodePointCloudFromBuffer(&buf);
+    if (!decoded.status().ok())
+    {
+        std::ostringstream ss;
+        ss << "draco::Decoder::DecodePointCloudFromBuffer() returned bad status: " << decoded.status();
+        throw std::runtime_error(ss.str());
+    }
+    std::unique_ptr<PointCloud> pc = std::move(decoded).value();
+
+    // The full decode knows the exact point count (including any seam points).
+    info.point_count = pc->num_points();
+    info.has_attributes = true;
+
+    for (int a = 0; a < pc->num_attributes(); ++a)
+    {
+        PointAttribute const & att = *pc->attribute(a);
+
+        DracoAttributeInfo att_info;
+        att_info.type = draco_attribute_type_name(att.attribute_type());
+        att_info.data_type = draco_data_type_name(att.data_type());
+        att_info.num_components = att.num_components();
+        att_info.value_count = att.size();
+
+        AttributeQuantizationTransform quantization;
+        bool is_quantized = ( att.GetAttributeTransformData() != nullptr
+                              && att.GetAttributeTransformData()->transform_type() == ATTRIBUTE_QUANTIZATION_TRANSFORM
+                              && quantization.InitFromAttribute(att) );
+        if (is_quantized)
+        {
+            att_info.quantization_bits = quantization.quantization_bits();
+            att_info.quantization_origin = quantization.min_values();
+            att_info.quantization_range = quantization.range();
+        }
+
+        if ( att.attribute_type() == GeometryAttribute::POSITION && att.num_components() == 3
+             && att.size() > 0 && !info.has_bounds )
+        {
+            info.has_bounds = true;
+            if (is_quantized)
+            {
+                std::array<int32_t, 3> q_min, q_max;
+                scan_attribute_bounds(att, q_min, q_max);
+
+                // Same arithmetic as draco's AttributeQuantizationTransform::InverseTransformAttribute()
+                Dequantizer dequantizer;
+                dequantizer.Init(att_info.quantization_range, (1 << att_info.quantization_bits) - 1);
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    info.bounds_min[axis] = dequantizer.DequantizeFloat(q_min[axis]) + att_info.quantization_origin[axis];
+                    info.bounds_max[axis] = dequantizer.DequantizeFloat(q_max[axis]) + att_info.quantization_origin[axis];
+                }
+            }
+            else
+            {
+                scan_attribute_bounds(att, info.bounds_min, info.bounds_max);
+            }
+        }
+
+        info.attributes.push_back(std::move(att_info));
+    }
+}
+
+// Summarize a draco buffer (see read_draco_header() and read_draco_attributes()).
+// Attribute inspection requires a full decode, since draco stores the attribute headers after the connectivity.
+DracoInfo inspect_draco_buffer( char const * raw_buf, size_t bytes_length, bool inspect_attributes )
+{
+    DracoInfo info;
+    if (bytes_length == 0)
+    {
+        info.empty = true;
+        return info;
+    }
+
+    read_draco_header(raw_buf, bytes_length, info);
+    if (inspect_attributes)
+    {
+        read_draco_attributes(raw_buf, bytes_length, info);
+    }
+    return info;
+}
+
+// Convert a DracoInfo to a python dict (requires the GIL).
+py::dict draco_info_to_dict( DracoInfo const & info )
+{
+    py::dict result;
+    if (info.empty)
+    {
+        result["geometry_type"] = py::none();
+        result["point_count"] = 0;
+        result["face_count"] = 0;
+        return result;
+    }
+
+    result["geometry_type"] = info.geometry_type;
+    result["encoding_method"] = info.encoding_method;
+    result["version"] = py::make_tuple(info.version_major, info.version_minor);
+    result["has_metadata"] = info.has_metadata;
+    result["point_count"] = info.point_count;
+    result["face_count"] = info.face_count;
+
+    if (info.has_attributes)
+    {
+        py::list attributes;
+        for (auto const & att : info.attributes)
+        {
+            py::dict att_dict( "type"_a=att.type,
+                               "data_type"_a=att.data_type,
+                               "num_components"_a=att.num_components,
+                               "value_count"_a=att.value_count );
+            if (att.quantization_bits > 0)
+            {
+                att_dict["quantization_bits"] = att.quantization_bits;
+                att_dict["quantization_origin"] = att.quantization_origin;
+                att_dict["quantization_range"] = att.quantization_range;
+            }
+            attributes.append(att_dict);
+        }
+        result["attributes"] = attributes;
+
+        if (info.has_bounds)
+        {
+            result["bounds"] = py::make_tuple(info.bounds_min, info.bounds_max);
+        }
+        else
+        {
+            result["bounds"] = py::none();
+        }
+    }
+    return result;
+}
+
+// Inspect a draco buffer without decoding it.
+//
+// Returns a dict with the geometry_type, encoding_method, bitstream version,
+// has_metadata, point_count, and face_count, all read from the buffer's headers.
+//
+// If attributes is true, the buffer is decoded (without dequantizing positions),
+// and the dict also contains a list of 'attributes' (with each attribute's type, data type,
+// component count, number of unique values, and quantization parameters, if any),
+// and the position 'bounds' as a (min, max) tuple.
+//
+// Special case: An empty buffer (an encoded empty mesh) yields geometry_type None and zero counts.
+py::dict inspect_drc_bytes( py::bytes const & drc_bytes, bool attributes )
+{
+    char * raw_buf = nullptr;
+    Py_ssize_t bytes_length = 0;
+    PyBytes_AsStringAndSize(drc_bytes.ptr(), &raw_buf, &bytes_length);
+
+    DracoInfo info;
+    {
+        py::gil_scoped_release nogil;
+        info = inspect_draco_buffer(raw_buf, bytes_length, attributes);
+    }
+    return draco_info_to_dict(info);
+}
+
+// Inspect a list of draco buffers concurrently (see inspect_drc_bytes()),
+// in a pool of num_threads native threads (0 means "use all cores").
+py::list inspect_many_drc_bytes( std::vector<py::bytes> const & drc_bytes_list, bool attributes, int num_threads )
+{
+    size_t count = drc_bytes_list.size();
+    std::vector<char *> raw_bufs(count, nullptr);
+    std::vector<Py_ssize_t> bytes_lengths(count, 0);
+    for (size_t i = 0; i < count; ++i)
+    {
+        PyBytes_AsStringAndSize(drc_bytes_list[i].ptr(), &raw_bufs[i], &bytes_lengths[i]);
+    }
+
+    std::vector<DracoInfo> infos(count);
+    {
+        py::gil_scoped_release nogil;
+        dvidutils::parallel_for(count, num_threads, [&](size_t i) {
+            infos[i] = inspect_draco_buffer(raw_bufs[i], bytes_lengths[i], attributes);
+        });
+    }
+
+    py::list results;
+    for (auto const & info : infos)
+    {
+        results.append(draco_info_to_dict(info));
+    }
+    return results;
+}
+
+#endif
@@ -0,0 +1,312 @@
+#ifndef DVIDUTILS_DRACO_POINTS_HPP
+#define DVIDUTILS_DRACO_POINTS_HPP
+
+#include <tuple>
+#include <vector>
+
+#include "draco/point_cloud/point_cloud.h"
+
+#include "pybind11/pybind11.h"
+#include "pybind11/stl.h"
+
+#include "pydraco.hpp"
+
+typedef std::unique_ptr<draco::PointCloud> PointCloudPtr;
+
+// Build a draco::PointCloud from a packed row-major (N,3) buffer of positions
+// (plus any GENERIC attributes) and encode it into 'buf'.
+//
+// By default, draco may use its kd-tree encoding, which reorders the points
+// (their attributes are reordered with them).  If preserve_order is true,
+// the sequential encoding is used instead, so the decoded points are in the
+// same order as the input, at some cost in compression.
+//
+// Special case: If point_count is 0, 'buf' is left empty.
+void encode_points_to_buffer( float const * points,
+                              size_t point_count,
+                              std::vector<GenericAttribute> const & attributes,
+                              DracoEncoderSettings const & settings,
+                              bool preserve_order,
+                              draco::EncoderBuffer & buf )
+{
+    using namespace draco;
+    if (point_count == 0)
+    {
+        return;
+    }
+
+    PointCloud pc;
+    pc.set_num_points(point_count);
+    add_point_attribute(pc, GeometryAttribute::POSITION, DT_FLOAT32, 3, points, point_count);
+    add_generic_attributes(pc, attributes, point_count);
+
+    Encoder encoder;
+    configure_encoder(encoder, settings, false);
+    if (preserve_order)
+    {
+        encoder.SetEncodingMethod(POINT_CLOUD_SEQUENTIAL_ENCODING);
+    }
+
+    auto status = encoder.EncodePointCloudToBuffer(pc, &buf);
+    if (!status.ok())
+    {
+        std::ostringstream ss;
+        ss << "draco::Encoder::EncodePointCloudToBuffer() returned bad status: " << status;
+        throw std::runtime_error(ss.str());
+    }
+}
+
+// Decode a raw draco buffer into a draco::PointCloud.
+// Mesh buffers are accepted too (their faces are ignored).
+PointCloudPtr decode_buffer_to_point_cloud( char const * raw_buf, size_t bytes_length )
+{
+    using namespace draco;
+
+    DecoderBuffer buf;
+    buf.Init( raw_buf, bytes_length );
+
+    Decoder decoder;
+    StatusOr<PointCloudPtr> decoded = decoder.DecodePointCloudFromBuffer(&buf);
+    if (!decoded.status().ok())
+    {
+        std::ostringstream ss;
+        ss << "draco::Decoder::DecodePointCloudFromBuffer() returned bad status: " << decoded.status();
+        throw std::runtime_error(ss.str().c_str());
+    }
+
+    // See note in decode_buffer_to_mesh() about std::move
+    PointCloudPtr pPoints = std::move(decoded).value();
+    if (pPoints->GetNamedAttribute(GeometryAttribute::POSITION) == nullptr)
+    {
+        throw std::runtime_error("Draco point cloud appears to have no positions.");
+    }
+    return pPoints;
+}
+
+// The arrays for one decoded point cloud: the (N,3) positions,
+// and one array per GENERIC attribute.
+struct PointArrays
+{
+    vertices_array_t points;
+    GenericAttributeArrays attributes;
+};
+
+// Allocate the output arrays for a decoded point cloud (or empty arrays, if pPoints is null).
+// (Requires the GIL.)
+PointArrays allocate_point_arrays( draco::PointCloud const * pPoints )
+{
+    PointArrays arrays;
+    size_t point_count = pPoints ? pPoints->num_points() : 0;
+
+    vertices_array_t::shape_type points_shape = {{point_count, 3}};
+    arrays.points = vertices_array_t(points_shape);
+    if (!pPoints)
+    {
+        return arrays;
+    }
+
+    arrays.attributes.allocate(read_generic_attributes(*pPoints), point_count);
+    return arrays;
+}
+
+// Copy a decoded point cloud into its (pre-allocated) output arrays.
+void extract_points( draco::PointCloud const & pc, PointArrays & arrays )
+{
+    using namespace draco;
+    auto const & position_att = *pc.GetNamedAttribute(GeometryAttribute::POSITION);
+    extract_attribute_values(position_att, pc.num_points(), arrays.points.data(), "point");
+    arrays.attributes.extract(pc);
+}
+
+// Returns the (points, attributes) tuple for python,
+// where attributes is a dict of {name: array}.  (Requires the GIL.)
+py::tuple point_arrays_to_python( PointArrays & arrays )
+{
+    return py::make_tuple(std::move(arrays.points), arrays.attributes.to_dict());
+}
+
+// Encode an (N,3) array of points (e.g. synapse locations or skeleton nodes)
+// as a draco point cloud.
+//
+// 'attributes' is a dict of {name: array} of per-point values, each with N rows,
+// which are stored as GENERIC attributes.  Float attributes are quantized with
+// generic_quantization_bits (by default 0, meaning no quantization); integer attributes are lossless.
+// (See GENERIC_DTYPES in pydraco.hpp for the supported dtypes.)
+//
+// Positions are quantized with position_quantization_bits (0 means no quantization).
+// See encode_points_to_buffer() regarding preserve_order.
+//
+// Special case: If points is empty, an empty buffer is returned.
+//
+// If return_buffer is true, a DracoBuffer is returned instead of a bytes object.
+py::object encode_points_to_drc_bytes( vertices_array_t const & points,
+                                       py::dict const & attributes,
+                                       int compression_level,
+                                       int position_quantization_bits,
+                                       int generic_quantization_bits,
+                                       bool preserve_order,
+                                       bool return_buffer )
+{
+    DracoEncoderSettings settings;
+    settings.compression_level = compression_level;
+    settings.position_quantization_bits = position_quantization_bits;
+    settings.generic_quantization_bits = generic_quantization_bits;
+
+    check_rows(points, 3, "points");
+    size_t point_count = points.shape()[0];
+    std::vector<py::array> attribute_arrays;
+    auto generic_attributes = generic_attributes_from_dict(attributes, point_count, attribute_arrays);
+
+    DracoBufferPtr buf(new DracoBuffer());
+    {
+        py::gil_scoped_release nogil;
+        std::vector<float> points_scratch;
+        encode_points_to_buffer( packed_rows(points, points_scratch), point_count,
+                                 generic_attributes, settings, preserve_order, buf->buffer() );
+    }
+    return encoded_buffer_to_python(std::move(buf), return_buffer);
+}
+
+// Encode a list of point arrays (and optionally, a matching list of attribute dicts)
+// into a list of draco point-cloud buffers, in the same order.
+//
+// The point clouds are encoded concurrently in a pool of num_threads native threads
+// (0 means "use all cores"), with the GIL released for the whole batch.
+// Otherwise, the same as encode_points_to_drc_bytes().
+py::list encode_many_points_to_drc_bytes( std::vector<vertices_array_t> const & points_list,
+                                          std::vector<py::dict> const & attributes_list,
+                                          int num_threads,
+                                          int compression_level,
+                                          int position_quantization_bits,
+                                          int generic_quantization_bits,
+                                          bool preserve_order,
+                                          bool return_buffer )
+{
+    size_t count = points_list.size();
+    if (!attributes_list.empty() && attributes_list.size() != count)
+    {
+        throw std::runtime_error("attributes_list must be empty or have one dict per points array");
+    }
+
+    DracoEncoderSettings settings;
+    settings.compression_level = compression_level;
+    settings.position_quantization_bits = position_quantization_bits;
+    settings.generic_quantization_bits = generic_quantization_bits;
+
+    for (auto const & points : points_list)
+    {
+        check_rows(points, 3, "points");
+    }
+
+    std::vector<py::array> attribute_arrays;
+    std::vector<std::vector<GenericAttribute>> generic_attributes(count);
+    for (size_t i = 0; i < attributes_list.size(); ++i)
+    {
+        generic_attributes[i] = generic_attributes_from_dict( attributes_list[i], points_list[i].shape()[0],
+                                                              attribute_arrays );
+    }
+
+    std::vector<DracoBufferPtr> buffers(count);
+    for (auto & buf : buffers)
+    {
+        buf.reset(new DracoBuffer());
+    }
+
+    {
+        py::gil_scoped_release nogil;
+        dvidutils::parallel_for(count, num_threads, [&](size_t i) {
+            std::vector<float> points_scratch;
+            encode_points_to_buffer( packed_rows(points_list[i], points_scratch), points_list[i].shape()[0],
+                                     generic_attributes[i], settings, preserve_order, buffers[i]->buffer() );
+        });
+    }
+
+    py::list results;
+    for (auto & buf : buffers)
+    {
+        results.append(encoded_buffer_to_python(std::move(buf), return_buffer));
+    }
+    return results;
+}
+
+// Decode a draco point cloud (or the vertices of a draco mesh)
+// into a tuple of (points, attributes), where points is an (N,3) float32 array
+// and attributes is a dict of {name: array} for the GENERIC attributes.
+// Single-column attributes are returned as 1-D arrays.
+//
+// Special case: If drc_bytes is empty, returns empty points and no attributes.
+py::tuple decode_drc_bytes_to_points( py::bytes const & drc_bytes )
+{
+    char * raw_buf = nullptr;
+    Py_ssize_t bytes_length = 0;
+    PyBytes_AsStringAndSize(drc_bytes.ptr(), &raw_buf, &bytes_length);
+
+    PointCloudPtr pPoints;
+    if (bytes_length > 0)
+    {
+        py::gil_scoped_release nogil;
+        pPoints = decode_buffer_to_point_cloud(raw_buf, bytes_length);
+    }
+
+    PointArrays arrays = allocate_point_arrays(pPoints.get());
+    if (pPoints)
+    {
+        py::gil_scoped_release nogil;
+        extract_points(*pPoints, arrays);
+    }
+    return point_arrays_to_python(arrays);
+}
+
+// Decode a list of draco point-cloud buffers into a list of (points, attributes) tuples.
+//
+// As in decode_many_drc_bytes(), the buffers are decoded concurrently with the GIL
+// released, the output arrays are allocated in a single GIL section, and then filled
+// (in parallel) with the GIL released again.
+py::list decode_many_drc_bytes_to_points( std::vector<py::bytes> const & drc_bytes_list, int num_threads )
+{
+    size_t count = drc_bytes_list.size();
+    std::vector<char *> raw_bufs(count, nullptr);
+    std::vector<Py_ssize_t> bytes_lengths(count, 0);
+    for (size_t i = 0; i < count; ++i)
+    {
+        PyBytes_AsStringAndSize(drc_bytes_list[i].ptr(), &raw_bufs[i], &bytes_lengths[i]);
+    }
+
+    // Empty buffers are left as nullptr.
+    std::vector<PointCloudPtr> point_clouds(count);
+    {
+        py::gil_scoped_release nogil;
+        dvidutils::parallel_for(count, num_threads, [&](size_t i) {
+            if (bytes_lengths[i] > 0)
+            {
+                point_clouds[i] = decode_buffer_to_point_cloud(raw_bufs[i], bytes_lengths[i]);
+            }
+        });
+    }
+
+    std::vector<PointArrays> results;
+    results.reserve(count);
+    for (auto const & pPoints : point_clouds)
+    {
+        results.push_back(allocate_point_arrays(pPoints.get()));
+    }
+
+    {
+        py::gil_scoped_release nogil;
+        dvidutils::parallel_for(count, num_threads, [&](size_t i) {
+            if (point_clouds[i])
+            {
+                extract_points(*point_clouds[i], results[i]);
+            }
+        });
+    }
+
+    py::list result_list;
+    for (auto & arrays : results)
+    {
+        result_list.append(point_arrays_to_python(arrays));
+    }
+    return result_list;
+}
+
+#endif
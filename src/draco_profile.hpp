@@ -0,0 +1,378 @@
+#ifndef DVIDUTILS_DRACO_PROFILE_HPP
+#define DVIDUTILS_DRACO_PROFILE_HPP
+
+#include <cstdint>
+#include <cmath>
+#include <array>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <limits>
+#include <chrono>
+#include <algorithm>
+#include <unordered_map>
+
+#include <boost/functional/hash.hpp>
+
+#include "pybind11/pybind11.h"
+#include "pybind11/stl.h"
+
+#include "pydraco.hpp"
+
+namespace py = pybind11;
+using namespace pybind11::literals;
+
+// Measurements of one mesh encoded with one set of draco settings,
+// as produced by profile_draco_settings()
+struct DracoProfile
+{
+    DracoEncoderSettings settings;
+    size_t encoded_bytes = 0;
+    double encode_seconds = 0.0;    // Best of all repeats
+    double decode_seconds = 0.0;    // Best of all repeats (including extraction into arrays)
+    double max_error = 0.0;         // See max_nearest_distance()
+};
+
+namespace dvidutils {
+namespace detail
+{
+    // Returns the largest distance from any point in 'points' to its nearest point in 'targets'
+    // (i.e. the one-sided Hausdorff distance), using a hash grid with the given cell size.
+    //
+    // The search only visits the 27 cells around each point, so the cell size should be
+    // at least as large as the largest per-axis displacement expected between the point sets.
+    // If no target is found in those cells, all targets are searched.
+    double max_nearest_distance( float const * points, size_t point_count,
+                                 float const * targets, size_t target_count,
+                                 double cell_size )
+    {
+        if (point_count == 0)
+        {
+            return 0.0;
+        }
+        if (target_count == 0)
+        {
+            return std::numeric_limits<double>::infinity();
+        }
+
+        typedef std::array<int64_t, 3> cell_t;
+        auto cell_of = [&](float const * p) {
+            return cell_t{{ int64_t(std::floor(p[0] / cell_size)),
+                            int64_t(std::floor(p[1] / cell_size)),
+                            int64_t(std::floor(p[2] / cell_size)) }};
+        };
+        auto cell_hasher = [](cell_t const & c) {
+            size_t hash = 0;
+            boost::hash_combine(hash, c[0]);
+            boost::hash_combine(hash, c[1]);
+            boost::hash_combine(hash, c[2]);
+            return hash;
+        };
+
+        std::unordered_map<cell_t, std::vector<uint32_t>, decltype(cell_hasher)> grid(target_count, cell_hasher);
+        for (size_t t = 0; t < target_count; ++t)
+        {
+            grid[cell_of(targets + 3*t)].push_back(t);
+        }
+
+        auto distance2 = [&](float const * p, uint32_t t) {
+            double dx = double(p[0]) - targets[3*t + 0];
+            double dy = double(p[1]) - targets[3*t + 1];
+            double dz = double(p[2]) - targets[3*t + 2];
+            return dx*dx + dy*dy + dz*dz;
+        };
+
+        double max_d2 = 0.0;
+        for (size_t i = 0; i < point_count; ++i)
+        {
+            float const * p = points + 3*i;
+            cell_t center = cell_of(p);
+
+            double best_d2 = std::numeric_limits<double>::infinity();
+            for (int64_t dz = -1; dz <= 1; ++dz)
+            {
+                for (int64_t dy = -1; dy <= 1; ++dy)
+                {
+                    for (int64_t dx = -1; dx <= 1; ++dx)
+                    {
+                        auto it = grid.find(cell_t{{ center[0] + dz, center[1] + dy, center[2] + dx }});
+                        if (it == grid.end())
+                        {
+                            continue;
+                        }
+                        for (auto t : it->second)
+                        {
+                            best_d2 = std::min(best_d2, distance2(p, t));
+                        }
+                    }
+                }
+            }
+
+            if (best_d2 == std::numeric_limits<double>::infinity())
+            {
+                for (size_t t = 0; t < target_count; ++t)
+                {
+                    best_d2 = std::min(best_d2, distance2(p, t));
+                }
+            }
+            max_d2 = std::max(max_d2, best_d2);
+        }
+        return std::sqrt(max_d2);
+    }
+
+    // The largest per-axis rounding error draco's position quantization can introduce:
+    // half of one quantization step, where the quantization range is the
+    // largest extent of the vertices along any axis.
+    double draco_quantization_error( float const * vertices, size_t vertex_count, int quantization_bits )
+    {
+        if (vertex_count == 0)
+        {
+            return 0.0;
+        }
+
+        double extent = 0.0;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            float lo = std::numeric_limits<float>::max();
+            float hi = std::numeric_limits<float>::lowest();
+            for (size_t vi = 0; vi < vertex_count; ++vi)
+            {
+                lo = std::min(lo, vertices[3*vi + axis]);
+                hi = std::max(hi, vertices[3*vi + axis]);
+            }
+            extent = std::max(extent, double(hi) - double(lo));
+        }
+
+        int bits = std::max(1, std::min(quantization_bits, 31));
+        return 0.5 * extent / double((uint64_t(1) << bits) - 1);
+    }
+}
+}
+
+// Encode and decode the given (packed) mesh with the given settings,
+// and measure the encoded size, the encode and decode times (best of 'repeats'),
+// and the maximum positional error of the decoded mesh.
+//
+// The positional error is the largest distance from any input vertex
+// to the nearest decoded vertex.
+DracoProfile profile_draco_settings( float const * vertices, size_t vertex_count,
+                                     float const * normals, size_t normal_count,
+                                     uint32_t const * faces, size_t face_count,
+                                     DracoEncoderSettings const & settings,
+                                     int repeats )
+{
+    typedef std::chrono::steady_clock clock_t;
+    auto seconds_since = [](clock_t::time_point start) {
+        return std::chrono::duration<double>(clock_t::now() - start).count();
+    };
+
+    DracoProfile profile;
+    profile.settings = settings;
+    profile.encode_seconds = std::numeric_limits<double>::infinity();
+    profile.decode_seconds = std::numeric_limits<double>::infinity();
+
+    if (face_count == 0)
+    {
+        profile.encode_seconds = profile.decode_seconds = 0.0;
+        return profile;
+    }
+
+    draco::Encoder encoder;
+    configure_encoder(encoder, settings, false);
+
+    draco::EncoderBuffer buf;
+    for (int r = 0; r < std::max(repeats, 1); ++r)
+    {
+        buf.Clear();
+        auto start = clock_t::now();
+        encode_packed_mesh_to_buffer( draco::DT_FLOAT32, vertices, vertex_count,
+                                      normals, normal_count,
+                                      faces, face_count,
+                                      settings, buf, &encoder );
+        profile.encode_seconds = std::min(profile.encode_seconds, seconds_since(start));
+    }
+    profile.encoded_bytes = buf.size();
+
+    std::vector<float> decoded_vertices;
+    std::vector<float> decoded_normals;
+    std::vector<uint32_t> decoded_faces;
+    for (int r = 0; r < std::max(repeats, 1); ++r)
+    {
+        auto start = clock_t::now();
+        MeshPtr pMesh = decode_buffer_to_mesh(buf.data(), buf.size());
+        decoded_vertices.resize(3 * size_t(pMesh->num_points()));
+        decoded_normals.resize(3 * mesh_normal_count(*pMesh));
+        decoded_faces.resize(3 * size_t(pMesh->num_faces()));
+        extract_mesh(*pMesh, decoded_vertices.data(), decoded_normals.data(), decoded_faces.data());
+        profile.decode_seconds = std::min(profile.decode_seconds, seconds_since(start));
+    }
+
+    // A slightly enlarged cell guarantees that each vertex's
+    // quantized counterpart lies within the neighboring cells.
+    double cell_size = 1.01 * dvidutils::detail::draco_quantization_error(vertices, vertex_count, settings.position_quantization_bits);
+    cell_size = std::max(cell_size, 1e-6);
+    profile.max_error = dvidutils::detail::max_nearest_distance( vertices, vertex_count,
+                                                      decoded_vertices.data(), decoded_vertices.size() / 3,
+                                                      cell_size );
+    return profile;
+}
+
+// Read encoder settings from a python dict, with defaults for any missing keys.
+// (Requires the GIL.)
+DracoEncoderSettings draco_settings_from_dict( py::dict const & d )
+{
+    DracoEncoderSettings settings;
+    for (auto item : d)
+    {
+        std::string key = py::cast<std::string>(item.first);
+        int value = py::cast<int>(item.second);
+        if (key == "compression_level")
+        {
+            settings.compression_level = value;
+        }
+        else if (key == "position_quantization_bits")
+        {
+            settings.position_quantization_bits = value;
+        }
+        else if (key == "normal_quantization_bits")
+        {
+            settings.normal_quantization_bits = value;
+        }
+        else if (key == "generic_quantization_bits")
+        {
+            settings.generic_quantization_bits = value;
+        }
+        else
+        {
+            throw std::runtime_error("Unknown draco setting: " + key);
+        }
+    }
+    return settings;
+}
+
+// Convert a DracoProfile to a python dict (requires the GIL).
+py::dict draco_profile_to_dict( DracoProfile const & profile )
+{
+    return py::dict( "compression_level"_a=profile.settings.compression_level,
+                     "position_quantization_bits"_a=profile.settings.position_quantization_bits,
+                     "normal_quantization_bits"_a=profile.settings.normal_quantization_bits,
+                     "generic_quantization_bits"_a=profile.settings.generic_quantization_bits,
+                     "encoded_bytes"_a=profile.encoded_bytes,
+                     "encode_seconds"_a=profile.encode_seconds,
+                     "decode_seconds"_a=profile.decode_seconds,
+                     "max_error"_a=profile.max_error );
+}
+
+// Encode and decode a mesh under each of the given settings, to compare them.
+//
+// 'settings_grid' is a list of dicts, each of which may contain any of the keys
+// compression_level, position_quantization_bits, normal_quantization_bits,
+// and generic_quantization_bits (missing keys take the usual defaults).
+//
+// Returns a list of dicts (one per entry in settings_grid), each containing the
+// complete settings along with:
+//   - encoded_bytes: the size of the encoded buffer
+//   - encode_seconds, decode_seconds: the best time of 'repeats' runs
+//     (decoding includes deduplication and extraction into arrays, as in decode_drc_bytes_to_faces())
+//   - max_error: the largest distance from any input vertex to the nearest decoded vertex
+//
+// The settings are profiled one at a time, on a single thread,
+// so the timings aren't skewed by competing threads.
+py::list profile_drc_settings( vertices_array_t const & vertices,
+                               normals_array_t const & normals,
+                               faces_array_t const & faces,
+                               py::list const & settings_grid,
+                               int repeats )
+{
+    check_rows(vertices, 3, "vertices");
+    check_rows(normals, 3, "normals");
+    check_rows(faces, 3, "faces");
+
+    std::vector<DracoEncoderSettings> all_settings;
+    for (auto item : settings_grid)
+    {
+        all_settings.push_back(draco_settings_from_dict(py::cast<py::dict>(item)));
+    }
+
+    std::vector<DracoProfile> profiles;
+    {
+        py::gil_scoped_release nogil;
+
+        std::vector<float> vertices_scratch;
+        float const * vertices_data = packed_rows(vertices, vertices_scratch);
+
+        std::vector<float> normals_scratch;
+        size_t normal_count = normals.shape()[0];
+        float const * normals_data = (normal_count > 0) ? packed_rows(normals, normals_scratch) : nullptr;
+
+        std::vector<uint32_t> faces_scratch;
+        uint32_t const * faces_data = packed_rows(faces, faces_scratch);
+
+        for (auto const & settings : all_settings)
+        {
+            profiles.push_back(profile_draco_settings( vertices_data, vertices.shape()[0],
+                                                       normals_data, normal_count,
+                                                       faces_data, faces.shape()[0],
+                                                       settings, repeats ));
+        }
+    }
+
+    py::list results;
+    for (auto const & profile : profiles)
+    {
+        results.append(draco_profile_to_dict(profile));
+    }
+    return results;
+}
+
+// Pick the fastest of the profiles returned by profile_drc_settings()
+// among those whose encoded_bytes and max_error are within the given budgets.
+//
+// 'objective' selects which time to minimize: 'decode' (the default, for serving latency),
+// 'encode', or 'total' (encode + decode).  Ties are broken by encoded size.
+//
+// Returns the chosen profile dict, or None if no profile fits the budgets.
+py::object choose_drc_settings( py::list const & profiles,
+                                double max_bytes,
+                                double max_error,
+                                std::string const & objective )
+{
+    if (objective != "decode" && objective != "encode" && objective != "total")
+    {
+        throw std::runtime_error("objective must be 'decode', 'encode', or 'total', not '" + objective + "'");
+    }
+
+    py::object best = py::none();
+    double best_seconds = std::numeric_limits<double>::infinity();
+    double best_bytes = std::numeric_limits<double>::infinity();
+    for (auto item : profiles)
+    {
+        py::dict profile = py::cast<py::dict>(item);
+        double encoded_bytes = py::cast<double>(profile["encoded_bytes"]);
+        double error = py::cast<double>(profile["max_error"]);
+        if (encoded_bytes > max_bytes || error > max_error)
+        {
+            continue;
+        }
+
+        double seconds = 0.0;
+        if (objective != "decode")
+        {
+            seconds += py::cast<double>(profile["encode_seconds"]);
+        }
+        if (objective != "encode")
+        {
+            seconds += py::cast<double>(profile["decode_seconds"]);
+        }
+
+        if (seconds < best_seconds || (seconds == best_seconds && encoded_bytes < best_bytes))
+        {
+            best = profile;
+            best_seconds = seconds;
+            best_bytes = encoded_bytes;
+        }
+    }
+    return best;
+}
+
+#endif
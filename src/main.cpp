@@ -20,6 +20,20 @@
 #include "downsample_labels.hpp"
 #include "remap_duplicates.hpp"
 #include "pydraco.hpp"
+#include "multires.hpp"
+#include "partition_mesh.hpp"
+#include "simplify_mesh.hpp"
+#include "smooth_mesh.hpp"
+#include "mesh_components.hpp"
+#include "mesh_metrics.hpp"
+#include "marching_cubes.hpp"
+#include "normals.hpp"
+#include "concatenate_meshes.hpp"
+#include "draco_info.hpp"
+#include "mesh_io.hpp"
+#include "draco_codec.hpp"
+#include "draco_points.hpp"
+#include "draco_profile.hpp"
 #include "destripe.hpp"
 
 namespace py = pybind11;
@@ -175,6 +189,291 @@ namespace dvidutils
     }
 
 
+    // Copy flat row-major vertex and face buffers into new (N,3) Python arrays.
+    // Must be called with the GIL held.
+    std::tuple<vertices_array_t, faces_array_t> make_mesh_arrays( std::vector<float> const & vertices,
+                                                                  std::vector<uint32_t> const & faces )
+    {
+        vertices_array_t::shape_type verts_shape = {{vertices.size() / 3, 3}};
+        vertices_array_t vertices_array(verts_shape);
+        std::copy(vertices.begin(), vertices.end(), vertices_array.data());
+
+        faces_array_t::shape_type faces_shape = {{faces.size() / 3, 3}};
+        faces_array_t faces_array(faces_shape);
+        std::copy(faces.begin(), faces.end(), faces_array.data());
+
+        return std::make_tuple( std::move(vertices_array), std::move(faces_array) );
+    }
+
+    // Split a mesh into fragments along a regular grid (see partition_mesh_buffers()).
+    // Returns a list of (fragment_origin, vertices, faces) tuples, one per non-empty cell,
+    // where fragment_origin = origin + cell * cell_shape.
+    // Each fragment can be passed directly to encode_faces_to_custom_drc_bytes(),
+    // along with fragment_shape=cell_shape and its fragment_origin.
+    py::list py_partition_mesh( vertices_array_t const & vertices,
+                                faces_array_t const & faces,
+                                coords_t const & cell_shape,
+                                coords_t const & origin,
+                                bool split_faces,
+                                int num_threads )
+    {
+        if (cell_shape.size() != 3 || origin.size() != 3)
+        {
+            throw std::runtime_error("cell_shape and origin must each have 3 elements");
+        }
+        check_rows(vertices, 3, "vertices");
+        check_rows(faces, 3, "faces");
+
+        std::array<double, 3> cell_shape_double{{ double(cell_shape(0)), double(cell_shape(1)), double(cell_shape(2)) }};
+        std::array<double, 3> origin_double{{ double(origin(0)), double(origin(1)), double(origin(2)) }};
+
+        std::vector<MeshFragment> fragments;
+        {
+            py::gil_scoped_release nogil;
+
+            std::vector<float> vertices_scratch;
+            std::vector<uint32_t> faces_scratch;
+            fragments = partition_mesh_buffers( packed_rows(vertices, vertices_scratch), vertices.shape()[0],
+                                                packed_rows(faces, faces_scratch), faces.shape()[0],
+                                                cell_shape_double, origin_double,
+                                                split_faces, num_threads );
+        }
+
+        py::list results;
+        for (auto const & fragment : fragments)
+        {
+            coords_t fragment_origin = xt::zeros<int>({3});
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                fragment_origin(axis) = origin(axis) + fragment.cell[axis] * cell_shape(axis);
+            }
+
+            auto arrays = make_mesh_arrays(fragment.vertices, fragment.faces);
+            results.append(py::make_tuple( std::move(fragment_origin), std::move(std::get<0>(arrays)), std::move(std::get<1>(arrays)) ));
+        }
+        return results;
+    }
+
+    // Simplify a mesh with a sequence of decreasing target face fractions (see QuadricSimplifier),
+    // returning a (vertices, faces) tuple for each target.
+    // Each result continues from the previous one, so a whole LOD series costs about as much as the coarsest LOD alone.
+    std::vector<std::tuple<vertices_array_t, faces_array_t>>
+    py_simplify_mesh_lods( vertices_array_t const & vertices,
+                           faces_array_t const & faces,
+                           std::vector<double> const & target_fractions,
+                           bool preserve_boundary )
+    {
+        check_rows(vertices, 3, "vertices");
+        check_rows(faces, 3, "faces");
+
+        for (size_t i = 0; i < target_fractions.size(); ++i)
+        {
+            if (target_fractions[i] < 0.0 || target_fractions[i] > 1.0)
+            {
+                throw std::runtime_error("target fractions must be in the range [0.0, 1.0]");
+            }
+            if (i > 0 && target_fractions[i] > target_fractions[i-1])
+            {
+                throw std::runtime_error("target fractions must be in decreasing order");
+            }
+        }
+
+        std::vector<std::vector<float>> lod_vertices(target_fractions.size());
+        std::vector<std::vector<uint32_t>> lod_faces(target_fractions.size());
+        {
+            py::gil_scoped_release nogil;
+
+            std::vector<float> vertices_scratch;
+            std::vector<uint32_t> faces_scratch;
+            size_t face_count = faces.shape()[0];
+            QuadricSimplifier simplifier( packed_rows(vertices, vertices_scratch), vertices.shape()[0],
+                                          packed_rows(faces, faces_scratch), face_count,
+                                          preserve_boundary );
+
+            for (size_t i = 0; i < target_fractions.size(); ++i)
+            {
+                simplifier.simplify_to(static_cast<size_t>(std::round(target_fractions[i] * face_count)));
+                simplifier.extract(lod_vertices[i], lod_faces[i]);
+            }
+        }
+
+        std::vector<std::tuple<vertices_array_t, faces_array_t>> results;
+        for (size_t i = 0; i < target_fractions.size(); ++i)
+        {
+            results.push_back(make_mesh_arrays(lod_vertices[i], lod_faces[i]));
+        }
+        return results;
+    }
+
+    std::tuple<vertices_array_t, faces_array_t> py_simplify_mesh( vertices_array_t const & vertices,
+                                                                  faces_array_t const & faces,
+                                                                  double target_fraction,
+                                                                  bool preserve_boundary )
+    {
+        auto results = py_simplify_mesh_lods(vertices, faces, {target_fraction}, preserve_boundary);
+        return std::move(results[0]);
+    }
+
+
+    // Compute unit vertex normals for a mesh (see compute_vertex_normals()).
+    // weighting is 'area' or 'angle'.
+    normals_array_t py_compute_vertex_normals( vertices_array_t const & vertices,
+                                               faces_array_t const & faces,
+                                               std::string const & weighting,
+                                               int num_threads )
+    {
+        NormalWeighting weighting_mode = parse_normal_weighting(weighting);
+        check_rows(vertices, 3, "vertices");
+        check_rows(faces, 3, "faces");
+
+        size_t vertex_count = vertices.shape()[0];
+        size_t face_count = faces.shape()[0];
+
+        std::vector<float> normals(3 * vertex_count);
+        {
+            py::gil_scoped_release nogil;
+
+            std::vector<float> vertices_scratch;
+            std::vector<uint32_t> faces_scratch;
+            uint32_t const * faces_data = packed_rows(faces, faces_scratch);
+            if (face_count > 0 && *std::max_element(faces_data, faces_data + 3*face_count) >= vertex_count)
+            {
+                throw std::runtime_error("Face indexes exceed vertices length");
+            }
+
+            compute_vertex_normals( packed_rows(vertices, vertices_scratch), vertex_count,
+                                    faces_data, face_count,
+                                    weighting_mode, num_threads, normals.data() );
+        }
+
+        normals_array_t::shape_type shape = {{vertex_count, 3}};
+        normals_array_t normals_array(shape);
+        std::copy(normals.begin(), normals.end(), normals_array.data());
+        return normals_array;
+    }
+
+    // Smooth a mesh with Taubin's lambda/mu algorithm (see smooth_vertices()),
+    // and return the smoothed vertices.  (The faces are unchanged.)
+    vertices_array_t py_smooth_mesh( vertices_array_t const & vertices,
+                                     faces_array_t const & faces,
+                                     int iterations,
+                                     float lambda,
+                                     float mu,
+                                     bool fix_boundary,
+                                     int num_threads )
+    {
+        check_rows(vertices, 3, "vertices");
+        check_rows(faces, 3, "faces");
+
+        size_t vertex_count = vertices.shape()[0];
+        vertices_array_t::shape_type shape = {{vertex_count, 3}};
+        vertices_array_t smoothed(shape);
+
+        {
+            py::gil_scoped_release nogil;
+
+            std::vector<uint32_t> faces_scratch;
+            uint32_t const * faces_data = packed_rows(faces, faces_scratch);
+            VertexAdjacency adjacency = vertex_adjacency(faces_data, faces.shape()[0], vertex_count, num_threads);
+
+            std::vector<float> vertices_scratch;
+            float const * vertices_data = packed_rows(vertices, vertices_scratch);
+            std::copy(vertices_data, vertices_data + 3*vertex_count, smoothed.data());
+
+            smooth_vertices( smoothed.data(), vertex_count, adjacency,
+                             iterations, lambda, mu, fix_boundary, num_threads );
+        }
+        return smoothed;
+    }
+
+    // Label the connected components of a mesh (see mesh_components()).
+    // If vertex_count is negative, it is inferred from the largest face index.
+    // Returns (vertex_labels, face_labels).
+    std::tuple<xt::pytensor<uint32_t, 1>, xt::pytensor<uint32_t, 1>> py_mesh_components( faces_array_t const & faces,
+                                                                                         int64_t vertex_count,
+                                                                                         int num_threads )
+    {
+        check_rows(faces, 3, "faces");
+
+        size_t face_count = faces.shape()[0];
+        std::vector<uint32_t> vertex_labels;
+        std::vector<uint32_t> face_labels;
+        {
+            py::gil_scoped_release nogil;
+
+            std::vector<uint32_t> faces_scratch;
+            uint32_t const * faces_data = packed_rows(faces, faces_scratch);
+            if (vertex_count < 0)
+            {
+                vertex_count = (face_count == 0) ? 0 : int64_t(*std::max_element(faces_data, faces_data + 3*face_count)) + 1;
+            }
+            mesh_components(faces_data, face_count, vertex_count, num_threads, vertex_labels, face_labels);
+        }
+
+        xt::pytensor<uint32_t, 1>::shape_type vertex_shape = {{vertex_labels.size()}};
+        xt::pytensor<uint32_t, 1> vertex_labels_array(vertex_shape);
+        std::copy(vertex_labels.begin(), vertex_labels.end(), vertex_labels_array.data());
+
+        xt::pytensor<uint32_t, 1>::shape_type face_shape = {{face_labels.size()}};
+        xt::pytensor<uint32_t, 1> face_labels_array(face_shape);
+        std::copy(face_labels.begin(), face_labels.end(), face_labels_array.data());
+
+        return std::make_tuple( std::move(vertex_labels_array), std::move(face_labels_array) );
+    }
+
+    // Remove the connected components with fewer than min_faces faces (see remove_small_components()).
+    // Returns the compacted (vertices, faces).
+    std::tuple<vertices_array_t, faces_array_t> py_remove_small_components( vertices_array_t const & vertices,
+                                                                            faces_array_t const & faces,
+                                                                            size_t min_faces,
+                                                                            int num_threads )
+    {
+        check_rows(vertices, 3, "vertices");
+        check_rows(faces, 3, "faces");
+
+        std::vector<float> out_vertices;
+        std::vector<uint32_t> out_faces;
+        {
+            py::gil_scoped_release nogil;
+
+            std::vector<float> vertices_scratch;
+            std::vector<uint32_t> faces_scratch;
+            remove_small_components( packed_rows(vertices, vertices_scratch), vertices.shape()[0],
+                                     packed_rows(faces, faces_scratch), faces.shape()[0],
+                                     min_faces, num_threads, out_vertices, out_faces );
+        }
+        return make_mesh_arrays(out_vertices, out_faces);
+    }
+
+    // Generate meshes for the given labels with marching cubes (see meshes_from_label_buffer()).
+    // Returns a dict of {label: (vertices, faces)}.
+    // If label_ids is empty, every nonzero label in the volume is meshed.
+    // axis_order is 'xyz' (the default) or 'zyx', and applies to spacing and offset, too.
+    py::dict py_meshes_from_labels( xt::pytensor<uint64_t, 3> const & labels,
+                                    std::vector<uint64_t> label_ids,
+                                    std::array<double, 3> const & spacing,
+                                    std::array<double, 3> const & offset,
+                                    std::string const & axis_order,
+                                    int num_threads )
+    {
+        AxisOrder order = parse_axis_order(axis_order);
+        std::vector<LabelMesh> meshes;
+        {
+            py::gil_scoped_release nogil;
+
+            std::array<size_t, 3> shape{{ labels.shape()[0], labels.shape()[1], labels.shape()[2] }};
+            std::array<ptrdiff_t, 3> strides{{ labels.strides()[0], labels.strides()[1], labels.strides()[2] }};
+            meshes = meshes_from_label_buffer( labels.data(), shape, strides, label_ids, spacing, offset, order, num_threads );
+        }
+
+        py::dict results;
+        for (size_t i = 0; i < label_ids.size(); ++i)
+        {
+            results[py::int_(label_ids[i])] = make_mesh_arrays(meshes[i].vertices, meshes[i].faces);
+        }
+        return results;
+    }
+
     PYBIND11_MODULE(_dvidutils, m) // note: PYBIND11_MODULE requires pybind11 >= 2.2.0
     {
         xt::import_numpy();
@@ -206,6 +505,18 @@ namespace dvidutils
 
         m.def("remap_duplicates", &remap_duplicates<xt::pytensor<float, 2>, xt::pytensor<uint32_t, 2>>, "vertices"_a, py::call_guard<py::gil_scoped_release>());
         
+        // Exposes the encoded bytes via the buffer protocol, without copying them.
+        py::class_<DracoBuffer> draco_buffer(m, "DracoBuffer", py::buffer_protocol());
+        draco_buffer
+            .def("__len__", &DracoBuffer::size)
+            .def("tobytes", [](DracoBuffer const & buf) { return py::bytes(buf.data(), buf.size()); });
+
+        // Instead of def_buffer() (whose buffers are always writable),
+        // install our own read-only slot (see draco_buffer_getbuffer()).
+        auto draco_buffer_type = reinterpret_cast<PyHeapTypeObject *>(draco_buffer.ptr());
+        draco_buffer_type->as_buffer.bf_getbuffer = &draco_buffer_getbuffer;
+        draco_buffer_type->as_buffer.bf_releasebuffer = nullptr;
+
         m.def("encode_faces_to_custom_drc_bytes",
               &encode_faces_to_custom_drc_bytes, // <-- Wow, that's an important '&' character.  If omitted, it causes segfaults during DECODE???
               "vertices"_a,
@@ -217,7 +528,9 @@ namespace dvidutils
               "position_quantization_bits"_a=DEFAULT_POSITION_QUANTIZATION_BITS,
               "normal_quantization_bits"_a=DEFAULT_NORMAL_QUANTIZATION_BITS,
               "generic_quantization_bits"_a=DEFAULT_GENERIC_QUANTIZATION_BITS,
-              "do_custom"_a=DEFAULT_DO_CUSTOM);
+              "do_custom"_a=DEFAULT_DO_CUSTOM,
+              "return_buffer"_a=false,
+              "attributes"_a=py::dict());
               
         m.def("encode_faces_to_drc_bytes",
               &encode_faces_to_drc_bytes, // <-- Wow, that's an important '&' character.  If omitted, it causes segfaults during DECODE???
@@ -227,9 +540,282 @@ namespace dvidutils
               "compression_level"_a=DEFAULT_COMPRESSION_LEVEL,
               "position_quantization_bits"_a=DEFAULT_POSITION_QUANTIZATION_BITS,
               "normal_quantization_bits"_a=DEFAULT_NORMAL_QUANTIZATION_BITS,
-              "generic_quantization_bits"_a=DEFAULT_GENERIC_QUANTIZATION_BITS);
+              "generic_quantization_bits"_a=DEFAULT_GENERIC_QUANTIZATION_BITS,
+              "compute_normals"_a=DEFAULT_COMPUTE_NORMALS,
+              "return_buffer"_a=false,
+              "attributes"_a=py::dict());
     
-        m.def("decode_drc_bytes_to_faces", &decode_drc_bytes_to_faces, "drc_bytes"_a);
+        m.def("encode_lattice_faces_to_custom_drc_bytes",
+              &encode_lattice_faces_to_custom_drc_bytes<uint32_t>,
+              "vertices"_a,
+              "faces"_a,
+              "lattice_scale"_a,
+              "lattice_origin"_a,
+              "compression_level"_a=DEFAULT_COMPRESSION_LEVEL,
+              "position_quantization_bits"_a=DEFAULT_POSITION_QUANTIZATION_BITS,
+              "generic_quantization_bits"_a=DEFAULT_GENERIC_QUANTIZATION_BITS,
+              "return_buffer"_a=false,
+              "attributes"_a=py::dict());
+
+        m.def("encode_lattice_faces_to_custom_drc_bytes",
+              &encode_lattice_faces_to_custom_drc_bytes<uint16_t>,
+              "vertices"_a,
+              "faces"_a,
+              "lattice_scale"_a,
+              "lattice_origin"_a,
+              "compression_level"_a=DEFAULT_COMPRESSION_LEVEL,
+              "position_quantization_bits"_a=DEFAULT_POSITION_QUANTIZATION_BITS,
+              "generic_quantization_bits"_a=DEFAULT_GENERIC_QUANTIZATION_BITS,
+              "return_buffer"_a=false,
+              "attributes"_a=py::dict());
+
+        m.def("encode_many_to_drc_bytes",
+              &encode_many_to_drc_bytes,
+              "meshes"_a,
+              "num_threads"_a=DEFAULT_NUM_THREADS,
+              "compression_level"_a=DEFAULT_COMPRESSION_LEVEL,
+              "position_quantization_bits"_a=DEFAULT_POSITION_QUANTIZATION_BITS,
+              "normal_quantization_bits"_a=DEFAULT_NORMAL_QUANTIZATION_BITS,
+              "generic_quantization_bits"_a=DEFAULT_GENERIC_QUANTIZATION_BITS,
+              "compute_normals"_a=DEFAULT_COMPUTE_NORMALS,
+              "return_buffer"_a=false,
+              "attributes_list"_a=std::vector<py::dict>());
+
+        m.def("decode_drc_bytes_to_faces",
+              &decode_drc_bytes_to_faces,
+              "drc_bytes"_a,
+              "deduplicate"_a=true,
+              "return_attributes"_a=false);
+
+        m.def("decode_custom_drc_bytes_to_faces",
+              &decode_custom_drc_bytes_to_faces,
+              "drc_bytes"_a,
+              "fragment_shape"_a,
+              "fragment_origin"_a,
+              "position_quantization_bits"_a=DEFAULT_POSITION_QUANTIZATION_BITS,
+              "deduplicate"_a=true);
+
+        m.def("decode_many_drc_bytes",
+              &decode_many_drc_bytes,
+              "drc_bytes_list"_a,
+              "num_threads"_a=DEFAULT_NUM_THREADS,
+              "concatenate"_a=false,
+              "deduplicate"_a=true,
+              "return_attributes"_a=false);
+
+        // The output arrays are not converted, since writes to a converted copy would be lost.
+        m.def("decode_drc_bytes_into",
+              &decode_drc_bytes_into,
+              "drc_bytes"_a,
+              py::arg("vertices").noconvert(),
+              py::arg("normals").noconvert(),
+              py::arg("faces").noconvert(),
+              "vertex_offset"_a=0,
+              "face_offset"_a=0,
+              "face_index_offset"_a=-1,
+              "deduplicate"_a=true);
+
+        m.def("decode_many_drc_bytes_into",
+              &decode_many_drc_bytes_into,
+              "drc_bytes_list"_a,
+              py::arg("vertices").noconvert(),
+              py::arg("normals").noconvert(),
+              py::arg("faces").noconvert(),
+              "vertex_offset"_a=0,
+              "face_offset"_a=0,
+              "face_index_offset"_a=-1,
+              "num_threads"_a=DEFAULT_NUM_THREADS,
+              "deduplicate"_a=true);
+
+        m.def("encode_points_to_drc_bytes",
+              &encode_points_to_drc_bytes,
+              "points"_a,
+              "attributes"_a=py::dict(),
+              "compression_level"_a=DEFAULT_COMPRESSION_LEVEL,
+              "position_quantization_bits"_a=DEFAULT_POSITION_QUANTIZATION_BITS,
+              "generic_quantization_bits"_a=DEFAULT_GENERIC_QUANTIZATION_BITS,
+              "preserve_order"_a=false,
+              "return_buffer"_a=false);
+
+        m.def("encode_many_points_to_drc_bytes",
+              &encode_many_points_to_drc_bytes,
+              "points_list"_a,
+              "attributes_list"_a=std::vector<py::dict>(),
+              "num_threads"_a=DEFAULT_NUM_THREADS,
+              "compression_level"_a=DEFAULT_COMPRESSION_LEVEL,
+              "position_quantization_bits"_a=DEFAULT_POSITION_QUANTIZATION_BITS,
+              "generic_quantization_bits"_a=DEFAULT_GENERIC_QUANTIZATION_BITS,
+              "preserve_order"_a=false,
+              "return_buffer"_a=false);
+
+        m.def("decode_drc_bytes_to_points", &decode_drc_bytes_to_points, "drc_bytes"_a);
+
+        m.def("decode_many_drc_bytes_to_points",
+              &decode_many_drc_bytes_to_points,
+              "drc_bytes_list"_a,
+              "num_threads"_a=DEFAULT_NUM_THREADS);
+
+        py::class_<DracoCodec>(m, "DracoCodec")
+            .def(py::init<int, int, int, int, bool>(),
+                 "compression_level"_a=DEFAULT_COMPRESSION_LEVEL,
+                 "position_quantization_bits"_a=DEFAULT_POSITION_QUANTIZATION_BITS,
+                 "normal_quantization_bits"_a=DEFAULT_NORMAL_QUANTIZATION_BITS,
+                 "generic_quantization_bits"_a=DEFAULT_GENERIC_QUANTIZATION_BITS,
+                 "compute_normals"_a=DEFAULT_COMPUTE_NORMALS)
+            .def_property_readonly("compression_level", [](DracoCodec const & c) { return c.settings().compression_level; })
+            .def_property_readonly("position_quantization_bits", [](DracoCodec const & c) { return c.settings().position_quantization_bits; })
+            .def_property_readonly("normal_quantization_bits", [](DracoCodec const & c) { return c.settings().normal_quantization_bits; })
+            .def_property_readonly("generic_quantization_bits", [](DracoCodec const & c) { return c.settings().generic_quantization_bits; })
+            .def_property_readonly("compute_normals", [](DracoCodec const & c) { return c.settings().compute_normals; })
+            .def("encode", &DracoCodec::encode,
+                 "vertices"_a, "normals"_a, "faces"_a, "return_buffer"_a=false, "attributes"_a=py::dict())
+            .def("encode_custom", &DracoCodec::encode_custom,
+                 "vertices"_a, "normals"_a, "faces"_a, "fragment_shape"_a, "fragment_origin"_a,
+                 "return_buffer"_a=false, "attributes"_a=py::dict())
+            .def("decode", &DracoCodec::decode, "drc_bytes"_a, "deduplicate"_a=true, "return_attributes"_a=false)
+            .def("decode_custom", &DracoCodec::decode_custom,
+                 "drc_bytes"_a, "fragment_shape"_a, "fragment_origin"_a, "deduplicate"_a=true);
+
+        m.def("concatenate_meshes",
+              &concatenate_meshes,
+              "meshes"_a,
+              "deduplicate"_a=true,
+              "num_threads"_a=DEFAULT_NUM_THREADS);
+
+        m.def("inspect_drc_bytes", &inspect_drc_bytes, "drc_bytes"_a, "attributes"_a=false);
+
+        m.def("inspect_many_drc_bytes",
+              &inspect_many_drc_bytes,
+              "drc_bytes_list"_a,
+              "attributes"_a=false,
+              "num_threads"_a=DEFAULT_NUM_THREADS);
+
+        m.def("profile_drc_settings",
+              &profile_drc_settings,
+              "vertices"_a,
+              "normals"_a,
+              "faces"_a,
+              "settings_grid"_a,
+              "repeats"_a=3);
+
+        m.def("choose_drc_settings",
+              &choose_drc_settings,
+              "profiles"_a,
+              "max_bytes"_a=std::numeric_limits<double>::infinity(),
+              "max_error"_a=std::numeric_limits<double>::infinity(),
+              "objective"_a="decode");
+
+        m.def("encode_faces_to_ngmesh_bytes", &encode_faces_to_ngmesh_bytes, "vertices"_a, "normals"_a, "faces"_a);
+        m.def("decode_ngmesh_bytes", &decode_ngmesh_bytes, "ngmesh_bytes"_a);
+
+        m.def("encode_faces_to_ply_bytes", &encode_faces_to_ply_bytes, "vertices"_a, "normals"_a, "faces"_a);
+        m.def("decode_ply_bytes", &decode_ply_bytes, "ply_bytes"_a);
+
+        m.def("encode_faces_to_obj_bytes",
+              &encode_faces_to_obj_bytes,
+              "vertices"_a,
+              "normals"_a,
+              "faces"_a,
+              "num_threads"_a=DEFAULT_NUM_THREADS);
+
+        m.def("decode_obj_bytes", &decode_obj_bytes, "obj_bytes"_a, "num_threads"_a=DEFAULT_NUM_THREADS);
+
+        m.def("write_multires_mesh",
+              &write_multires_mesh,
+              "lod_meshes"_a,
+              "chunk_shape"_a,
+              "grid_origin"_a,
+              "lod_scales"_a=std::vector<double>(),
+              "vertex_offsets"_a=std::vector<std::array<double, 3>>(),
+              "vertex_quantization_bits"_a=DEFAULT_MULTIRES_QUANTIZATION_BITS,
+              "compression_level"_a=DEFAULT_COMPRESSION_LEVEL,
+              "num_threads"_a=DEFAULT_NUM_THREADS);
+
+        m.def("read_multires_mesh",
+              &read_multires_mesh,
+              "manifest"_a,
+              "data"_a,
+              "lod"_a=0,
+              "bounding_box"_a=std::vector<std::array<double, 3>>(),
+              "vertex_quantization_bits"_a=DEFAULT_MULTIRES_QUANTIZATION_BITS,
+              "deduplicate"_a=true,
+              "num_threads"_a=DEFAULT_NUM_THREADS);
+
+        m.def("partition_mesh",
+              &py_partition_mesh,
+              "vertices"_a,
+              "faces"_a,
+              "cell_shape"_a,
+              "origin"_a,
+              "split_faces"_a=false,
+              "num_threads"_a=DEFAULT_NUM_THREADS);
+
+        m.def("simplify_mesh",
+              &py_simplify_mesh,
+              "vertices"_a,
+              "faces"_a,
+              "target_fraction"_a,
+              "preserve_boundary"_a=false);
+
+        m.def("simplify_mesh_lods",
+              &py_simplify_mesh_lods,
+              "vertices"_a,
+              "faces"_a,
+              "target_fractions"_a,
+              "preserve_boundary"_a=false);
+
+        m.def("mesh_components",
+              &py_mesh_components,
+              "faces"_a,
+              "vertex_count"_a=-1,
+              "num_threads"_a=DEFAULT_NUM_THREADS);
+
+        m.def("remove_small_components",
+              &py_remove_small_components,
+              "vertices"_a,
+              "faces"_a,
+              "min_faces"_a,
+              "num_threads"_a=DEFAULT_NUM_THREADS);
+
+        m.def("mesh_metrics", &mesh_metrics, "vertices"_a, "faces"_a);
+
+        m.def("mesh_metrics_many",
+              &mesh_metrics_many,
+              "meshes"_a,
+              "num_threads"_a=DEFAULT_NUM_THREADS);
+
+        m.def("drc_mesh_metrics",
+              &drc_mesh_metrics,
+              "drc_bytes_list"_a,
+              "deduplicate"_a=true,
+              "num_threads"_a=DEFAULT_NUM_THREADS);
+
+        // Note: 'lambda' is a python keyword, hence 'lambda_'.
+        m.def("smooth_mesh",
+              &py_smooth_mesh,
+              "vertices"_a,
+              "faces"_a,
+              "iterations"_a=10,
+              "lambda_"_a=0.5f,
+              "mu"_a=-0.53f,
+              "fix_boundary"_a=false,
+              "num_threads"_a=DEFAULT_NUM_THREADS);
+
+        m.def("compute_vertex_normals",
+              &py_compute_vertex_normals,
+              "vertices"_a,
+              "faces"_a,
+              "weighting"_a="area",
+              "num_threads"_a=DEFAULT_NUM_THREADS);
+
+        m.def("meshes_from_labels",
+              &py_meshes_from_labels,
+              "labels"_a,
+              "label_ids"_a=std::vector<uint64_t>(),
+              "spacing"_a=std::array<double, 3>{{ 1.0, 1.0, 1.0 }},
+              "offset"_a=std::array<double, 3>{{ 0.0, 0.0, 0.0 }},
+              "axis_order"_a="xyz",
+              "num_threads"_a=DEFAULT_NUM_THREADS);
 
         m.def("destripe", &py_destripe, "image"_a, "seams"_a);
     }
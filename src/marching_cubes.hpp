@@ -0,0 +1,430 @@
+#ifndef DVIDUTILS_MARCHING_CUBES_HPP
+#define DVIDUTILS_MARCHING_CUBES_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+
+#include "parallel.hpp"
+
+using std::size_t;
+using std::ptrdiff_t;
+using std::uint8_t;
+using std::uint32_t;
+using std::uint64_t;
+
+namespace dvidutils
+{
+    // The column order of the generated vertices
+    enum class AxisOrder
+    {
+        XYZ,    // reversed from the volume's axis order (the usual convention for meshes)
+        ZYX     // the volume's own axis order
+    };
+
+    AxisOrder parse_axis_order(std::string const & axis_order)
+    {
+        if (axis_order == "xyz")
+        {
+            return AxisOrder::XYZ;
+        }
+        if (axis_order == "zyx")
+        {
+            return AxisOrder::ZYX;
+        }
+        throw std::runtime_error("axis_order must be 'xyz' or 'zyx', not '" + axis_order + "'");
+    }
+
+    // The surface mesh of a single label
+    struct LabelMesh
+    {
+        std::vector<float> vertices;   // row-major (N,3)
+        std::vector<uint32_t> faces;   // row-major (M,3), indexes into 'vertices'
+    };
+
+    namespace detail
+    {
+        // Cube corners are numbered by their offsets: corner = dx | (dy << 1) | (dz << 2),
+        // where z, y, x are the volume's axes in array order (i.e. z is axis 0).
+        // Each of the 12 cube edges is identified by its lower corner and its (array) axis.
+        struct cube_edge_t
+        {
+            int corner;
+            int axis;
+        };
+
+        std::array<cube_edge_t, 12> const & cube_edges()
+        {
+            static std::array<cube_edge_t, 12> const edges = []() {
+                std::array<cube_edge_t, 12> edges;
+                int e = 0;
+                for (int corner = 0; corner < 8; ++corner)
+                {
+                    for (int bit = 0; bit < 3; ++bit)
+                    {
+                        if ((corner & (1 << bit)) == 0)
+                        {
+                            edges[e++] = cube_edge_t{ corner, 2 - bit };
+                        }
+                    }
+                }
+                return edges;
+            }();
+            return edges;
+        }
+
+        // The position of a corner in array order (z, y, x)
+        std::array<int, 3> corner_position(int corner)
+        {
+            return {{ (corner >> 2) & 1, (corner >> 1) & 1, corner & 1 }};
+        }
+
+        int find_cube_edge(int corner_a, int corner_b)
+        {
+            int lower = std::min(corner_a, corner_b);
+            int bit = (corner_a ^ corner_b) == 1 ? 0 : ((corner_a ^ corner_b) == 2 ? 1 : 2);
+            auto const & edges = cube_edges();
+            for (int e = 0; e < 12; ++e)
+            {
+                if (edges[e].corner == lower && edges[e].axis == 2 - bit)
+                {
+                    return e;
+                }
+            }
+            throw std::logic_error("Not a cube edge");
+        }
+
+        typedef std::array<uint8_t, 3> cube_triangle_t;
+
+        // The marching cubes triangle table: for each of the 256 inside/outside corner configurations,
+        // the triangles to emit, as triples of cube edge indexes.
+        //
+        // Rather than hard-coding the classic table, it is derived on first use:
+        // On each cube face, the isoline separates every run of (cyclically) adjacent inside corners
+        // from the rest, so diagonal inside corners on an ambiguous face are never joined.
+        // That decision depends only on the face's own corners, so neighboring cubes always agree
+        // and the surface has no cracks. The face segments are then chained into closed loops,
+        // which are fanned into triangles.
+        //
+        // Triangles are wound counter-clockwise when viewed from outside, in (z, y, x) coordinates,
+        // i.e. their right-hand normals point away from the inside corners.
+        std::array<std::vector<cube_triangle_t>, 256> const & marching_cubes_table()
+        {
+            static std::array<std::vector<cube_triangle_t>, 256> const table = []() {
+                // The corners of each cube face, in counter-clockwise order when viewed from outside the cube.
+                std::vector<std::array<int, 4>> cube_faces;
+                for (int bit = 0; bit < 3; ++bit)
+                {
+                    int b1 = (bit + 1) % 3;
+                    int b2 = (bit + 2) % 3;
+                    for (int side = 0; side < 2; ++side)
+                    {
+                        int base = side << bit;
+                        std::array<int, 4> face{{ base, base | (1 << b1), base | (1 << b1) | (1 << b2), base | (1 << b2) }};
+
+                        // Check the winding against the face's outward direction.
+                        auto p0 = corner_position(face[0]);
+                        auto p1 = corner_position(face[1]);
+                        auto p2 = corner_position(face[2]);
+                        std::array<int, 3> u{{ p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] }};
+                        std::array<int, 3> v{{ p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] }};
+                        std::array<int, 3> normal{{ u[1]*v[2] - u[2]*v[1], u[2]*v[0] - u[0]*v[2], u[0]*v[1] - u[1]*v[0] }};
+                        int outward = (side == 0) ? -1 : 1;
+                        if (normal[2 - bit] * outward < 0)
+                        {
+                            std::reverse(face.begin(), face.end());
+                        }
+                        cube_faces.push_back(face);
+                    }
+                }
+
+                std::array<std::vector<cube_triangle_t>, 256> table;
+                for (int config = 0; config < 256; ++config)
+                {
+                    auto inside = [config](int corner) { return (config >> corner) & 1; };
+
+                    // Collect the isoline segments on each face.
+                    // Walking a face counter-clockwise, each run of inside corners is entered through
+                    // one crossed edge and left through another. The segment runs from the entry to the exit,
+                    // so that every crossed cube edge starts exactly one segment and ends exactly one.
+                    std::array<int, 12> next_edge;
+                    next_edge.fill(-1);
+                    for (auto const & face : cube_faces)
+                    {
+                        for (int k = 0; k < 4; ++k)
+                        {
+                            int a = face[k];
+                            int b = face[(k+1) % 4];
+                            if (!inside(a) || inside(b))
+                            {
+                                continue;
+                            }
+
+                            // (a, b) is the exit from a run of inside corners; find that run's entry.
+                            int j = k;
+                            while (inside(face[(j+3) % 4]))
+                            {
+                                j = (j+3) % 4;
+                            }
+                            int exit_edge = find_cube_edge(a, b);
+                            int entry_edge = find_cube_edge(face[(j+3) % 4], face[j]);
+                            next_edge[entry_edge] = exit_edge;
+                        }
+                    }
+
+                    // Chain the segments into loops and triangulate each loop as a fan.
+                    std::array<bool, 12> visited{};
+                    for (int start = 0; start < 12; ++start)
+                    {
+                        if (next_edge[start] == -1 || visited[start])
+                        {
+                            continue;
+                        }
+                        std::vector<int> loop;
+                        for (int e = start; !visited[e]; e = next_edge[e])
+                        {
+                            visited[e] = true;
+                            loop.push_back(e);
+                        }
+                        for (size_t i = 1; i + 1 < loop.size(); ++i)
+                        {
+                            table[config].push_back(cube_triangle_t{{ uint8_t(loop[0]), uint8_t(loop[i]), uint8_t(loop[i+1]) }});
+                        }
+                    }
+                }
+                return table;
+            }();
+            return table;
+        }
+
+        // The partial mesh of one label within one slab.
+        // Vertices are identified by the (global) id of the voxel edge they lie on,
+        // so that slabs can be stitched back together afterwards.
+        struct SlabMesh
+        {
+            std::vector<uint64_t> vertex_edges;
+            std::vector<uint32_t> faces;
+            std::unordered_map<uint64_t, uint32_t> edge_vertices;
+
+            uint32_t vertex(uint64_t edge_id)
+            {
+                auto result = edge_vertices.emplace(edge_id, uint32_t(vertex_edges.size()));
+                if (result.second)
+                {
+                    vertex_edges.push_back(edge_id);
+                }
+                return result.first->second;
+            }
+        };
+    }
+
+    // Generate a surface mesh for each of the given labels in a single marching cubes sweep.
+    //
+    // The volume is given by a pointer, its shape and its strides (in elements, not bytes),
+    // so non-contiguous arrays can be read in place.
+    // Voxels outside the volume are treated as background, so every mesh is closed.
+    // Label 0 is background and cannot be meshed.
+    //
+    // Vertices lie at the midpoints between voxel centers.
+    // With AxisOrder::XYZ, the volume's axes are taken to be (z, y, x), and the vertex columns
+    // are (x, y, z); with AxisOrder::ZYX, the vertex columns follow the volume's own axis order.
+    // Either way, spacing and offset are given in the same order as the vertex columns,
+    // and a voxel center is positioned at (index * spacing + offset).
+    // Vertices are shared between neighboring cubes, and faces are wound counter-clockwise
+    // when viewed from outside the label, in the output coordinates.
+    //
+    // If label_ids is empty, it is filled with every nonzero label in the volume (sorted).
+    // Returns one mesh per label id (possibly empty, if the label is absent).
+    //
+    // The volume is split into slabs along its first axis, which are processed in parallel.
+    std::vector<LabelMesh> meshes_from_label_buffer( uint64_t const * labels,
+                                                     std::array<size_t, 3> const & shape,
+                                                     std::array<ptrdiff_t, 3> const & strides,
+                                                     std::vector<uint64_t> & label_ids,
+                                                     std::array<double, 3> const & spacing,
+                                                     std::array<double, 3> const & offset,
+                                                     AxisOrder axis_order,
+                                                     int num_threads )
+    {
+        auto label_at = [&](ptrdiff_t z, ptrdiff_t y, ptrdiff_t x) -> uint64_t {
+            if ( z < 0 || y < 0 || x < 0 ||
+                 z >= ptrdiff_t(shape[0]) || y >= ptrdiff_t(shape[1]) || x >= ptrdiff_t(shape[2]) )
+            {
+                return 0;
+            }
+            return labels[z*strides[0] + y*strides[1] + x*strides[2]];
+        };
+
+        if (label_ids.empty())
+        {
+            std::unordered_set<uint64_t> present;
+            for (size_t z = 0; z < shape[0]; ++z)
+            {
+                for (size_t y = 0; y < shape[1]; ++y)
+                {
+                    for (size_t x = 0; x < shape[2]; ++x)
+                    {
+                        present.insert(label_at(z, y, x));
+                    }
+                }
+            }
+            present.erase(0);
+            label_ids.assign(present.begin(), present.end());
+            std::sort(label_ids.begin(), label_ids.end());
+        }
+
+        std::unordered_map<uint64_t, size_t> label_indexes;
+        for (size_t i = 0; i < label_ids.size(); ++i)
+        {
+            if (label_ids[i] == 0)
+            {
+                throw std::runtime_error("Label 0 is background and cannot be meshed");
+            }
+            if (!label_indexes.emplace(label_ids[i], i).second)
+            {
+                throw std::runtime_error("label_ids must not contain duplicates");
+            }
+        }
+
+        auto const & table = detail::marching_cubes_table();
+        auto const & edges = detail::cube_edges();
+
+        // Cubes span the padded volume: cube (z,y,x) has its lower corner at voxel (z-1, y-1, x-1).
+        // Voxel edges are identified by their lower padded corner and axis.
+        std::array<uint64_t, 3> padded_shape{{ shape[0] + 2, shape[1] + 2, shape[2] + 2 }};
+        auto edge_id = [&](ptrdiff_t pz, ptrdiff_t py, ptrdiff_t px, int axis) -> uint64_t {
+            return ((uint64_t(pz) * padded_shape[1] + py) * padded_shape[2] + px) * 3 + axis;
+        };
+
+        size_t num_cube_planes = shape[0] + 1;
+        size_t num_slabs = std::min(num_cube_planes, 4 * resolve_num_threads(num_threads, num_cube_planes));
+        std::vector<std::unordered_map<size_t, detail::SlabMesh>> slab_meshes(num_slabs);
+
+        parallel_for(num_slabs, num_threads, [&](size_t slab) {
+            auto & meshes = slab_meshes[slab];
+            ptrdiff_t z_begin = ptrdiff_t(slab * num_cube_planes / num_slabs);
+            ptrdiff_t z_end = ptrdiff_t((slab + 1) * num_cube_planes / num_slabs);
+
+            std::array<uint64_t, 8> corners;
+            for (ptrdiff_t cz = z_begin; cz < z_end; ++cz)
+            {
+                for (ptrdiff_t cy = 0; cy <= ptrdiff_t(shape[1]); ++cy)
+                {
+                    for (ptrdiff_t cx = 0; cx <= ptrdiff_t(shape[2]); ++cx)
+                    {
+                        bool uniform = true;
+                        for (int c = 0; c < 8; ++c)
+                        {
+                            corners[c] = label_at(cz - 1 + ((c >> 2) & 1), cy - 1 + ((c >> 1) & 1), cx - 1 + (c & 1));
+                            uniform = uniform && (corners[c] == corners[0]);
+                        }
+                        if (uniform)
+                        {
+                            continue;
+                        }
+
+                        // Emit the triangles of each distinct label among the corners.
+                        for (int c = 0; c < 8; ++c)
+                        {
+                            uint64_t label = corners[c];
+                            if (label == 0 || std::find(corners.begin(), corners.begin() + c, label) != corners.begin() + c)
+                            {
+                                continue;
+                            }
+                            auto label_index = label_indexes.find(label);
+                            if (label_index == label_indexes.end())
+                            {
+                                continue;
+                            }
+
+                            int config = 0;
+                            for (int k = c; k < 8; ++k)
+                            {
+                                config |= int(corners[k] == label) << k;
+                            }
+
+                            auto & mesh = meshes[label_index->second];
+                            for (auto const & triangle : table[config])
+                            {
+                                for (uint8_t e : triangle)
+                                {
+                                    int corner = edges[e].corner;
+                                    uint64_t id = edge_id( cz + ((corner >> 2) & 1),
+                                                           cy + ((corner >> 1) & 1),
+                                                           cx + (corner & 1),
+                                                           edges[e].axis );
+                                    mesh.faces.push_back(mesh.vertex(id));
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        });
+
+        // Stitch each label's slabs together, merging the vertices they share.
+        // The table winds faces in array order, so for XYZ output (which reverses the axes)
+        // each face's winding is reversed, too.
+        bool xyz = (axis_order == AxisOrder::XYZ);
+        std::vector<LabelMesh> results(label_ids.size());
+        parallel_for(label_ids.size(), num_threads, [&](size_t label_index) {
+            auto & result = results[label_index];
+            std::unordered_map<uint64_t, uint32_t> edge_vertices;
+            std::vector<uint32_t> slab_to_label;
+            for (auto & meshes : slab_meshes)
+            {
+                auto slab_mesh = meshes.find(label_index);
+                if (slab_mesh == meshes.end())
+                {
+                    continue;
+                }
+
+                auto const & vertex_edges = slab_mesh->second.vertex_edges;
+                slab_to_label.resize(vertex_edges.size());
+                for (size_t v = 0; v < vertex_edges.size(); ++v)
+                {
+                    uint64_t id = vertex_edges[v];
+                    auto found = edge_vertices.emplace(id, uint32_t(result.vertices.size() / 3));
+                    slab_to_label[v] = found.first->second;
+                    if (!found.second)
+                    {
+                        continue;
+                    }
+
+                    int axis = id % 3;
+                    uint64_t corner = id / 3;
+                    std::array<double, 3> position{{ double(corner / (padded_shape[1] * padded_shape[2])) - 1.0,
+                                                     double((corner / padded_shape[2]) % padded_shape[1]) - 1.0,
+                                                     double(corner % padded_shape[2]) - 1.0 }};
+                    position[axis] += 0.5;
+                    if (xyz)
+                    {
+                        std::reverse(position.begin(), position.end());
+                    }
+                    for (int i = 0; i < 3; ++i)
+                    {
+                        result.vertices.push_back(static_cast<float>(position[i] * spacing[i] + offset[i]));
+                    }
+                }
+
+                auto const & faces = slab_mesh->second.faces;
+                for (size_t f = 0; f < faces.size(); f += 3)
+                {
+                    result.faces.push_back(slab_to_label[faces[f]]);
+                    result.faces.push_back(slab_to_label[faces[f + (xyz ? 2 : 1)]]);
+                    result.faces.push_back(slab_to_label[faces[f + (xyz ? 1 : 2)]]);
+                }
+            }
+        });
+
+        return results;
+    }
+}
+
+#endif
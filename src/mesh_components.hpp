@@ -0,0 +1,214 @@
+#ifndef DVIDUTILS_MESH_COMPONENTS_HPP
+#define DVIDUTILS_MESH_COMPONENTS_HPP
+
+#include <cstdint>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#include "parallel.hpp"
+
+using std::size_t;
+using std::uint32_t;
+
+namespace dvidutils
+{
+    namespace detail
+    {
+        // A union-find forest that can be updated concurrently from multiple threads.
+        //
+        // Roots are always linked beneath the smaller of the two roots (with a compare-and-swap,
+        // retried if another thread got there first), so each set's final root is its smallest
+        // element, regardless of the order in which the unions were made.
+        class ConcurrentUnionFind
+        {
+        public:
+            ConcurrentUnionFind(size_t size)
+            : _parents(size)
+            {
+                for (size_t i = 0; i < size; ++i)
+                {
+                    _parents[i].store(uint32_t(i), std::memory_order_relaxed);
+                }
+            }
+
+            // Find the root of x, halving the path along the way.
+            uint32_t find(uint32_t x)
+            {
+                uint32_t parent = _parents[x].load();
+                while (parent != x)
+                {
+                    uint32_t grandparent = _parents[parent].load();
+                    _parents[x].compare_exchange_weak(parent, grandparent);
+                    x = parent;
+                    parent = _parents[x].load();
+                }
+                return x;
+            }
+
+            void unite(uint32_t a, uint32_t b)
+            {
+                while (true)
+                {
+                    a = find(a);
+                    b = find(b);
+                    if (a == b)
+                    {
+                        return;
+                    }
+                    if (a < b)
+                    {
+                        std::swap(a, b);
+                    }
+
+                    // Link a beneath b, unless a is no longer a root.
+                    uint32_t expected = a;
+                    if (_parents[a].compare_exchange_strong(expected, b))
+                    {
+                        return;
+                    }
+                }
+            }
+
+        private:
+            std::vector<std::atomic<uint32_t>> _parents;
+        };
+    }
+
+    // Find the connected components of a mesh, where two vertices are connected if they share a face.
+    //
+    // On return, vertex_labels[v] is the component of vertex v, and face_labels[f] is the component of face f.
+    // Components are numbered consecutively, in order of their smallest vertex index,
+    // so the labels are the same for any number of threads.
+    // (Vertices that aren't used by any face are each a component of their own.)
+    //
+    // Returns the number of components.
+    size_t mesh_components( uint32_t const * faces,
+                            size_t face_count,
+                            size_t vertex_count,
+                            int num_threads,
+                            std::vector<uint32_t> & vertex_labels,
+                            std::vector<uint32_t> & face_labels )
+    {
+        for (size_t j = 0; j < 3*face_count; ++j)
+        {
+            if (faces[j] >= vertex_count)
+            {
+                throw std::runtime_error("Face indexes exceed vertices length");
+            }
+        }
+
+        size_t const block_size = 65536;
+        size_t num_face_blocks = (face_count + block_size - 1) / block_size;
+        size_t num_vertex_blocks = (vertex_count + block_size - 1) / block_size;
+
+        detail::ConcurrentUnionFind sets(vertex_count);
+        parallel_for(num_face_blocks, num_threads, [&](size_t block) {
+            size_t end = std::min((block + 1) * block_size, face_count);
+            for (size_t f = block * block_size; f < end; ++f)
+            {
+                sets.unite(faces[3*f + 0], faces[3*f + 1]);
+                sets.unite(faces[3*f + 0], faces[3*f + 2]);
+            }
+        });
+
+        std::vector<uint32_t> roots(vertex_count);
+        parallel_for(num_vertex_blocks, num_threads, [&](size_t block) {
+            size_t end = std::min((block + 1) * block_size, vertex_count);
+            for (size_t v = block * block_size; v < end; ++v)
+            {
+                roots[v] = sets.find(uint32_t(v));
+            }
+        });
+
+        // Number the roots in order.  (Each root is the smallest vertex in its component.)
+        std::vector<uint32_t> root_labels(vertex_count, 0);
+        size_t num_components = 0;
+        for (size_t v = 0; v < vertex_count; ++v)
+        {
+            if (roots[v] == v)
+            {
+                root_labels[v] = uint32_t(num_components++);
+            }
+        }
+
+        vertex_labels.resize(vertex_count);
+        parallel_for(num_vertex_blocks, num_threads, [&](size_t block) {
+            size_t end = std::min((block + 1) * block_size, vertex_count);
+            for (size_t v = block * block_size; v < end; ++v)
+            {
+                vertex_labels[v] = root_labels[roots[v]];
+            }
+        });
+
+        face_labels.resize(face_count);
+        parallel_for(num_face_blocks, num_threads, [&](size_t block) {
+            size_t end = std::min((block + 1) * block_size, face_count);
+            for (size_t f = block * block_size; f < end; ++f)
+            {
+                face_labels[f] = vertex_labels[faces[3*f]];
+            }
+        });
+
+        return num_components;
+    }
+
+    // Remove the connected components with fewer than min_faces faces from a mesh,
+    // along with any vertices that are no longer used by any face.
+    //
+    // The surviving vertices and faces keep their relative order, and the faces are remapped
+    // to refer to the compacted vertices.  The results are written to out_vertices and out_faces.
+    void remove_small_components( float const * vertices,
+                                  size_t vertex_count,
+                                  uint32_t const * faces,
+                                  size_t face_count,
+                                  size_t min_faces,
+                                  int num_threads,
+                                  std::vector<float> & out_vertices,
+                                  std::vector<uint32_t> & out_faces )
+    {
+        std::vector<uint32_t> vertex_labels;
+        std::vector<uint32_t> face_labels;
+        size_t num_components = mesh_components(faces, face_count, vertex_count, num_threads, vertex_labels, face_labels);
+
+        std::vector<size_t> component_sizes(num_components, 0);
+        for (auto label : face_labels)
+        {
+            component_sizes[label] += 1;
+        }
+
+        // Keep the vertices of the kept faces (and no others)
+        std::vector<uint32_t> vertex_map(vertex_count, 0);
+        out_faces.clear();
+        for (size_t f = 0; f < face_count; ++f)
+        {
+            if (component_sizes[face_labels[f]] >= min_faces)
+            {
+                for (int corner = 0; corner < 3; ++corner)
+                {
+                    vertex_map[faces[3*f + corner]] = 1;
+                }
+                out_faces.insert(out_faces.end(), faces + 3*f, faces + 3*f + 3);
+            }
+        }
+
+        out_vertices.clear();
+        uint32_t kept_count = 0;
+        for (size_t v = 0; v < vertex_count; ++v)
+        {
+            if (vertex_map[v])
+            {
+                vertex_map[v] = kept_count++;
+                out_vertices.insert(out_vertices.end(), vertices + 3*v, vertices + 3*v + 3);
+            }
+        }
+
+        for (auto & index : out_faces)
+        {
+            index = vertex_map[index];
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,962 @@
+#ifndef DVIDUTILS_MESH_IO_HPP
+#define DVIDUTILS_MESH_IO_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <array>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <tuple>
+#include <limits>
+#include <algorithm>
+
+#include "pybind11/pybind11.h"
+
+#include "pydraco.hpp"
+#include "parallel.hpp"
+
+using std::size_t;
+using std::uint8_t;
+using std::uint32_t;
+using std::int64_t;
+
+// Readers and writers for the plain (non-draco) mesh formats we exchange with other tools:
+//
+//   - ngmesh: neuroglancer's legacy mesh format:
+//             uint32 vertex count, float32[N,3] vertices, uint32[M,3] faces (all little-endian)
+//   - PLY:    binary PLY (written as binary_little_endian, either endianness is read)
+//   - OBJ:    Wavefront OBJ (v, vn, and f lines only)
+//
+// Like the draco codecs, the Python-facing functions take and return (vertices, normals, faces),
+// and release the GIL while encoding or decoding.
+// An empty normals array means "no normals".
+//
+// Note: The binary formats are read and written with memcpy, which assumes a little-endian host.
+
+namespace dvidutils
+{
+    namespace detail
+    {
+        // Check that all face indexes refer to existing vertices
+        void check_face_indexes( uint32_t const * faces, size_t face_count, size_t vertex_count )
+        {
+            if (face_count > 0 && *std::max_element(faces, faces + 3*face_count) >= vertex_count)
+            {
+                throw std::runtime_error("Face indexes exceed vertices length");
+            }
+        }
+
+        template <typename T>
+        void append_binary(std::string & buf, T const * values, size_t count)
+        {
+            buf.append(reinterpret_cast<char const *>(values), count * sizeof(T));
+        }
+    }
+
+    //
+    // ngmesh
+    //
+
+    std::string write_ngmesh( float const * vertices, size_t vertex_count,
+                              uint32_t const * faces, size_t face_count )
+    {
+        detail::check_face_indexes(faces, face_count, vertex_count);
+
+        std::string buf;
+        buf.reserve(4 + 12*vertex_count + 12*face_count);
+        uint32_t count = vertex_count;
+        detail::append_binary(buf, &count, 1);
+        detail::append_binary(buf, vertices, 3*vertex_count);
+        detail::append_binary(buf, faces, 3*face_count);
+        return buf;
+    }
+
+    void read_ngmesh( char const * buf, size_t length,
+                      std::vector<float> & vertices,
+                      std::vector<uint32_t> & faces )
+    {
+        uint32_t vertex_count;
+        if (length < 4)
+        {
+            throw std::runtime_error("ngmesh buffer is too short");
+        }
+        std::memcpy(&vertex_count, buf, 4);
+
+        size_t vertex_bytes = 12 * size_t(vertex_count);
+        if (length < 4 + vertex_bytes || (length - 4 - vertex_bytes) % 12 != 0)
+        {
+            throw std::runtime_error("ngmesh buffer size does not match its vertex count");
+        }
+        size_t face_count = (length - 4 - vertex_bytes) / 12;
+
+        vertices.resize(3 * size_t(vertex_count));
+        faces.resize(3 * face_count);
+        std::memcpy(vertices.data(), buf + 4, vertex_bytes);
+        std::memcpy(faces.data(), buf + 4 + vertex_bytes, 12 * face_count);
+        detail::check_face_indexes(faces.data(), face_count, vertex_count);
+    }
+
+    //
+    // PLY
+    //
+
+    std::string write_ply( float const * vertices, size_t vertex_count,
+                           float const * normals, size_t normal_count,
+                           uint32_t const * faces, size_t face_count )
+    {
+        detail::check_face_indexes(faces, face_count, vertex_count);
+        if (normal_count > 0 && normal_count != vertex_count)
+        {
+            throw std::runtime_error("normals array size does not correspond to vertices array size");
+        }
+
+        std::ostringstream header;
+        header << "ply\n"
+               << "format binary_little_endian 1.0\n"
+               << "element vertex " << vertex_count << "\n"
+               << "property float x\n"
+               << "property float y\n"
+               << "property float z\n";
+        if (normal_count > 0)
+        {
+            header << "property float nx\n"
+                   << "property float ny\n"
+                   << "property float nz\n";
+        }
+        header << "element face " << face_count << "\n"
+               << "property list uchar uint vertex_indices\n"
+               << "end_header\n";
+
+        std::string buf = header.str();
+        size_t vertex_stride = (normal_count > 0) ? 24 : 12;
+        size_t header_size = buf.size();
+        buf.resize(header_size + vertex_stride * vertex_count + 13 * face_count);
+
+        char * out = &buf[header_size];
+        if (normal_count == 0)
+        {
+            std::memcpy(out, vertices, 12 * vertex_count);
+            out += 12 * vertex_count;
+        }
+        else
+        {
+            for (size_t v = 0; v < vertex_count; ++v)
+            {
+                std::memcpy(out, vertices + 3*v, 12);
+                std::memcpy(out + 12, normals + 3*v, 12);
+                out += 24;
+            }
+        }
+
+        for (size_t f = 0; f < face_count; ++f)
+        {
+            *out = 3;
+            std::memcpy(out + 1, faces + 3*f, 12);
+            out += 13;
+        }
+        return buf;
+    }
+
+    namespace detail
+    {
+        enum class PlyType { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64 };
+
+        PlyType parse_ply_type(std::string const & name)
+        {
+            if (name == "char"   || name == "int8")    { return PlyType::Int8; }
+            if (name == "uchar"  || name == "uint8")   { return PlyType::UInt8; }
+            if (name == "short"  || name == "int16")   { return PlyType::Int16; }
+            if (name == "ushort" || name == "uint16")  { return PlyType::UInt16; }
+            if (name == "int"    || name == "int32")   { return PlyType::Int32; }
+            if (name == "uint"   || name == "uint32")  { return PlyType::UInt32; }
+            if (name == "float"  || name == "float32") { return PlyType::Float32; }
+            if (name == "double" || name == "float64") { return PlyType::Float64; }
+            throw std::runtime_error("Unknown PLY property type: " + name);
+        }
+
+        size_t ply_type_size(PlyType type)
+        {
+            switch (type)
+            {
+                case PlyType::Int8:
+                case PlyType::UInt8:   return 1;
+                case PlyType::Int16:
+                case PlyType::UInt16:  return 2;
+                case PlyType::Int32:
+                case PlyType::UInt32:
+                case PlyType::Float32: return 4;
+                default:               return 8;
+            }
+        }
+
+        struct PlyProperty
+        {
+            std::string name;
+            PlyType type;
+            bool is_list = false;
+            PlyType count_type = PlyType::UInt8;
+        };
+
+        struct PlyElement
+        {
+            std::string name;
+            size_t count = 0;
+            std::vector<PlyProperty> properties;
+        };
+
+        // Reads binary PLY values, with bounds checking and optional byte-swapping.
+        class PlyReader
+        {
+        public:
+            PlyReader(char const * begin, char const * end, bool swap)
+            : _pos(begin), _end(end), _swap(swap)
+            {}
+
+            double read(PlyType type)
+            {
+                size_t size = ply_type_size(type);
+                if (size_t(_end - _pos) < size)
+                {
+                    throw std::runtime_error("PLY data is truncated");
+                }
+
+                char bytes[8];
+                std::memcpy(bytes, _pos, size);
+                _pos += size;
+                if (_swap)
+                {
+                    std::reverse(bytes, bytes + size);
+                }
+
+                switch (type)
+                {
+                    case PlyType::Int8:    return value<int8_t>(bytes);
+                    case PlyType::UInt8:   return value<uint8_t>(bytes);
+                    case PlyType::Int16:   return value<int16_t>(bytes);
+                    case PlyType::UInt16:  return value<uint16_t>(bytes);
+                    case PlyType::Int32:   return value<int32_t>(bytes);
+                    case PlyType::UInt32:  return value<uint32_t>(bytes);
+                    case PlyType::Float32: return value<float>(bytes);
+                    default:               return value<double>(bytes);
+                }
+            }
+
+        private:
+            template <typename T>
+            static double value(char const * bytes)
+            {
+                T v;
+                std::memcpy(&v, bytes, sizeof(T));
+                return double(v);
+            }
+
+            char const * _pos;
+            char const * _end;
+            bool _swap;
+        };
+
+        // Convert a PLY list entry to a vertex index
+        uint32_t ply_vertex_index(double value)
+        {
+            if (value < 0 || value > std::numeric_limits<uint32_t>::max())
+            {
+                throw std::runtime_error("PLY face has an invalid vertex index");
+            }
+            return uint32_t(value);
+        }
+    }
+
+    // Read a binary PLY mesh.
+    // Vertex positions come from the x/y/z properties of the 'vertex' element, and
+    // normals (if present) from nx/ny/nz. Faces come from the 'vertex_indices' (or 'vertex_index')
+    // list of the 'face' element; polygons with more than three vertices are split into triangle fans.
+    // Any other elements and properties are skipped.
+    void read_ply( char const * buf, size_t length,
+                   std::vector<float> & vertices,
+                   std::vector<float> & normals,
+                   std::vector<uint32_t> & faces )
+    {
+        using namespace detail;
+
+        // Parse the header
+        std::string const end_marker = "end_header";
+        char const * header_end = std::search(buf, buf + length, end_marker.begin(), end_marker.end());
+        char const * data_begin = (header_end == buf + length) ? nullptr
+                                : static_cast<char const *>(std::memchr(header_end, '\n', buf + length - header_end));
+        if (length < 4 || std::strncmp(buf, "ply", 3) != 0 || data_begin == nullptr)
+        {
+            throw std::runtime_error("Not a PLY buffer");
+        }
+        ++data_begin;
+
+        std::istringstream header(std::string(buf, header_end));
+        std::string line;
+        std::vector<PlyElement> elements;
+        bool swap = false;
+        while (std::getline(header, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+
+            std::istringstream words(line);
+            std::string keyword;
+            words >> keyword;
+            if (keyword == "format")
+            {
+                std::string format;
+                words >> format;
+                if (format == "binary_big_endian")
+                {
+                    swap = true;
+                }
+                else if (format != "binary_little_endian")
+                {
+                    throw std::runtime_error("Unsupported PLY format: " + format + " (only binary PLY is supported)");
+                }
+            }
+            else if (keyword == "element")
+            {
+                PlyElement element;
+                words >> element.name >> element.count;
+                elements.push_back(element);
+            }
+            else if (keyword == "property")
+            {
+                if (elements.empty())
+                {
+                    throw std::runtime_error("PLY property declared before any element");
+                }
+                PlyProperty property;
+                std::string type;
+                words >> type;
+                if (type == "list")
+                {
+                    std::string count_type, item_type;
+                    words >> count_type >> item_type;
+                    property.is_list = true;
+                    property.count_type = parse_ply_type(count_type);
+                    type = item_type;
+                }
+                property.type = parse_ply_type(type);
+                words >> property.name;
+                elements.back().properties.push_back(property);
+            }
+        }
+
+        // Read the data
+        PlyReader reader(data_begin, buf + length, swap);
+        std::vector<double> values;
+        for (auto const & element : elements)
+        {
+            bool is_vertex = (element.name == "vertex");
+            bool is_face = (element.name == "face");
+
+            // Column of each of x, y, z, nx, ny, nz (or -1)
+            std::array<int, 6> columns;
+            columns.fill(-1);
+            char const * column_names[6] = { "x", "y", "z", "nx", "ny", "nz" };
+            int index_list = -1;
+            for (size_t p = 0; p < element.properties.size(); ++p)
+            {
+                auto const & property = element.properties[p];
+                for (int c = 0; c < 6; ++c)
+                {
+                    if (!property.is_list && property.name == column_names[c])
+                    {
+                        columns[c] = p;
+                    }
+                }
+                if (property.is_list && (property.name == "vertex_indices" || property.name == "vertex_index"))
+                {
+                    index_list = p;
+                }
+            }
+            if (is_vertex && (columns[0] < 0 || columns[1] < 0 || columns[2] < 0))
+            {
+                throw std::runtime_error("PLY vertex element lacks x, y, or z");
+            }
+            bool has_normals = is_vertex && columns[3] >= 0 && columns[4] >= 0 && columns[5] >= 0;
+
+            if (is_vertex)
+            {
+                vertices.reserve(3 * element.count);
+                if (has_normals)
+                {
+                    normals.reserve(3 * element.count);
+                }
+            }
+            if (is_face)
+            {
+                faces.reserve(3 * element.count);
+            }
+
+            values.resize(element.properties.size());
+            std::vector<uint32_t> polygon;
+            for (size_t i = 0; i < element.count; ++i)
+            {
+                for (size_t p = 0; p < element.properties.size(); ++p)
+                {
+                    auto const & property = element.properties[p];
+                    if (!property.is_list)
+                    {
+                        values[p] = reader.read(property.type);
+                        continue;
+                    }
+
+                    double count = reader.read(property.count_type);
+                    if (count < 0)
+                    {
+                        throw std::runtime_error("PLY list has a negative length");
+                    }
+                    polygon.clear();
+                    for (size_t k = 0; k < size_t(count); ++k)
+                    {
+                        double item = reader.read(property.type);
+                        if (is_face && int(p) == index_list)
+                        {
+                            polygon.push_back(ply_vertex_index(item));
+                        }
+                    }
+                    for (size_t k = 1; k + 1 < polygon.size(); ++k)
+                    {
+                        faces.insert(faces.end(), { polygon[0], polygon[k], polygon[k+1] });
+                    }
+                }
+
+                if (is_vertex)
+                {
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        vertices.push_back(float(values[columns[c]]));
+                    }
+                    if (has_normals)
+                    {
+                        for (int c = 3; c < 6; ++c)
+                        {
+                            normals.push_back(float(values[columns[c]]));
+                        }
+                    }
+                }
+            }
+        }
+
+        check_face_indexes(faces.data(), faces.size() / 3, vertices.size() / 3);
+    }
+
+    //
+    // OBJ
+    //
+
+    // Write an OBJ mesh. Vertices and normals are written with 9 significant digits,
+    // which is enough for float32 values to survive the round-trip exactly.
+    // If normals are given, each face corner refers to the normal of the same index as its vertex.
+    //
+    // Formatting text is slow, so the vertices and faces are split into chunks,
+    // which are formatted in parallel and then concatenated.
+    std::string write_obj( float const * vertices, size_t vertex_count,
+                           float const * normals, size_t normal_count,
+                           uint32_t const * faces, size_t face_count,
+                           int num_threads )
+    {
+        detail::check_face_indexes(faces, face_count, vertex_count);
+        if (normal_count > 0 && normal_count != vertex_count)
+        {
+            throw std::runtime_error("normals array size does not correspond to vertices array size");
+        }
+
+        size_t const chunk_size = 16384;
+        size_t vertex_chunks = (vertex_count + chunk_size - 1) / chunk_size;
+        size_t face_chunks = (face_count + chunk_size - 1) / chunk_size;
+        std::vector<std::string> chunks(vertex_chunks + face_chunks);
+
+        parallel_for(chunks.size(), num_threads, [&](size_t c) {
+            std::string & out = chunks[c];
+            char line[128];
+            if (c < vertex_chunks)
+            {
+                size_t end = std::min((c + 1) * chunk_size, vertex_count);
+                for (size_t v = c * chunk_size; v < end; ++v)
+                {
+                    float const * p = vertices + 3*v;
+                    int n = std::snprintf(line, sizeof(line), "v %.9g %.9g %.9g\n", p[0], p[1], p[2]);
+                    out.append(line, n);
+                    if (normal_count > 0)
+                    {
+                        float const * q = normals + 3*v;
+                        n = std::snprintf(line, sizeof(line), "vn %.9g %.9g %.9g\n", q[0], q[1], q[2]);
+                        out.append(line, n);
+                    }
+                }
+                return;
+            }
+
+            size_t face_chunk = c - vertex_chunks;
+            size_t end = std::min((face_chunk + 1) * chunk_size, face_count);
+            for (size_t f = face_chunk * chunk_size; f < end; ++f)
+            {
+                // OBJ indexes start at 1
+                unsigned long a = faces[3*f + 0] + 1ul;
+                unsigned long b = faces[3*f + 1] + 1ul;
+                unsigned long d = faces[3*f + 2] + 1ul;
+                int n;
+                if (normal_count > 0)
+                {
+                    n = std::snprintf(line, sizeof(line), "f %lu//%lu %lu//%lu %lu//%lu\n", a, a, b, b, d, d);
+                }
+                else
+                {
+                    n = std::snprintf(line, sizeof(line), "f %lu %lu %lu\n", a, b, d);
+                }
+                out.append(line, n);
+            }
+        });
+
+        size_t total_size = 0;
+        for (auto const & chunk : chunks)
+        {
+            total_size += chunk.size();
+        }
+        std::string buf;
+        buf.reserve(total_size);
+        for (auto const & chunk : chunks)
+        {
+            buf.append(chunk);
+        }
+        return buf;
+    }
+
+    namespace detail
+    {
+        // Face corner references within an OBJ chunk are stored as non-negative global indexes
+        // (from positive OBJ indexes), or, for (negative) relative OBJ indexes, as their chunk-local index
+        // minus obj_relative_offset, which is resolved once the sizes of the preceding chunks are known.
+        // (Relative indexes may point into preceding chunks, so the local index itself may be negative.)
+        int64_t const obj_relative_offset = int64_t(1) << 40;
+        int64_t const obj_no_reference = std::numeric_limits<int64_t>::min();
+
+        // The contents of one chunk of an OBJ file.
+        struct ObjChunk
+        {
+            std::vector<float> vertices;
+            std::vector<float> normals;
+            std::vector<int64_t> corner_vertices;
+            std::vector<int64_t> corner_normals;   // obj_no_reference if the corner has no normal
+        };
+
+        class ObjLineParser
+        {
+        public:
+            ObjLineParser(char const * begin, char const * end)
+            : _pos(begin), _end(end)
+            {}
+
+            bool at_end()
+            {
+                while (_pos < _end && (*_pos == ' ' || *_pos == '\t' || *_pos == '\r'))
+                {
+                    ++_pos;
+                }
+                return _pos == _end;
+            }
+
+            // Return the next whitespace-delimited token
+            std::pair<char const *, char const *> token()
+            {
+                at_end();
+                char const * start = _pos;
+                while (_pos < _end && *_pos != ' ' && *_pos != '\t' && *_pos != '\r')
+                {
+                    ++_pos;
+                }
+                return std::make_pair(start, _pos);
+            }
+
+            float parse_float()
+            {
+                auto t = token();
+                size_t length = t.second - t.first;
+                char text[64];
+                if (length == 0 || length >= sizeof(text))
+                {
+                    throw std::runtime_error("Bad number in OBJ data");
+                }
+                std::memcpy(text, t.first, length);
+                text[length] = '\0';
+
+                char * parsed_end;
+                float value = std::strtof(text, &parsed_end);
+                if (parsed_end != text + length)
+                {
+                    throw std::runtime_error("Bad number in OBJ data: " + std::string(text));
+                }
+                return value;
+            }
+
+        private:
+            char const * _pos;
+            char const * _end;
+        };
+
+        // Parse an integer from [begin, end), advancing begin past it.
+        // Indexes beyond obj_relative_offset are rejected as soon as they're seen,
+        // so a long run of digits can't overflow the accumulator.
+        int64_t parse_obj_index(char const * & begin, char const * end)
+        {
+            bool negative = (begin < end && *begin == '-');
+            if (negative)
+            {
+                ++begin;
+            }
+            if (begin == end || *begin < '0' || *begin > '9')
+            {
+                throw std::runtime_error("Bad face index in OBJ data");
+            }
+            int64_t value = 0;
+            while (begin < end && *begin >= '0' && *begin <= '9')
+            {
+                value = 10*value + (*begin - '0');
+                ++begin;
+                if (value > obj_relative_offset)
+                {
+                    throw std::runtime_error("Bad face index in OBJ data");
+                }
+            }
+            return negative ? -value : value;
+        }
+
+        // Convert an OBJ index to a chunk reference (see obj_relative_offset)
+        int64_t obj_reference(int64_t index, size_t local_count)
+        {
+            if (index == 0 || index >= obj_relative_offset || -index >= obj_relative_offset)
+            {
+                throw std::runtime_error("Bad face index in OBJ data");
+            }
+            if (index > 0)
+            {
+                return index - 1;
+            }
+            return int64_t(local_count) + index - obj_relative_offset;
+        }
+
+        void parse_obj_chunk(char const * begin, char const * end, ObjChunk & chunk)
+        {
+            std::vector<int64_t> polygon_vertices;
+            std::vector<int64_t> polygon_normals;
+
+            char const * line_begin = begin;
+            while (line_begin < end)
+            {
+                char const * line_end = static_cast<char const *>(std::memchr(line_begin, '\n', end - line_begin));
+                if (line_end == nullptr)
+                {
+                    line_end = end;
+                }
+
+                ObjLineParser parser(line_begin, line_end);
+                line_begin = line_end + 1;
+                if (parser.at_end())
+                {
+                    continue;
+                }
+
+                auto keyword = parser.token();
+                size_t keyword_length = keyword.second - keyword.first;
+                if (keyword_length == 1 && keyword.first[0] == 'v')
+                {
+                    for (int i = 0; i < 3; ++i)
+                    {
+                        chunk.vertices.push_back(parser.parse_float());
+                    }
+                }
+                else if (keyword_length == 2 && keyword.first[0] == 'v' && keyword.first[1] == 'n')
+                {
+                    for (int i = 0; i < 3; ++i)
+                    {
+                        chunk.normals.push_back(parser.parse_float());
+                    }
+                }
+                else if (keyword_length == 1 && keyword.first[0] == 'f')
+                {
+                    polygon_vertices.clear();
+                    polygon_normals.clear();
+                    while (!parser.at_end())
+                    {
+                        // v, v/vt, v//vn, or v/vt/vn
+                        auto t = parser.token();
+                        char const * p = t.first;
+                        polygon_vertices.push_back(obj_reference(parse_obj_index(p, t.second), chunk.vertices.size() / 3));
+
+                        int64_t normal = obj_no_reference;
+                        if (p < t.second && *p == '/')
+                        {
+                            ++p;
+                            if (p < t.second && *p != '/')
+                            {
+                                parse_obj_index(p, t.second); // texture coordinate (ignored)
+                            }
+                            if (p < t.second && *p == '/')
+                            {
+                                ++p;
+                                normal = obj_reference(parse_obj_index(p, t.second), chunk.normals.size() / 3);
+                            }
+                        }
+                        polygon_normals.push_back(normal);
+                    }
+
+                    for (size_t k = 1; k + 1 < polygon_vertices.size(); ++k)
+                    {
+                        for (size_t corner : { size_t(0), k, k+1 })
+                        {
+                            chunk.corner_vertices.push_back(polygon_vertices[corner]);
+                            chunk.corner_normals.push_back(polygon_normals[corner]);
+                        }
+                    }
+                }
+                // Everything else (vt, g, o, s, usemtl, comments, ...) is ignored.
+            }
+        }
+
+        // Resolve a chunk reference (see obj_relative_offset), given the number of items in the preceding chunks
+        uint32_t resolve_obj_reference(int64_t reference, size_t base, size_t total)
+        {
+            int64_t index = reference;
+            if (reference < 0)
+            {
+                index = int64_t(base) + reference + obj_relative_offset;
+            }
+            if (index < 0 || index >= int64_t(total))
+            {
+                throw std::runtime_error("OBJ face index out of range");
+            }
+            return uint32_t(index);
+        }
+    }
+
+    // Read an OBJ mesh.
+    // Polygons are split into triangle fans, and texture coordinates are ignored.
+    //
+    // Normals are returned per vertex: If the faces refer to normals (v//vn or v/vt/vn),
+    // each vertex gets the normal its corners refer to. Otherwise, if there are exactly
+    // as many normals as vertices, they are paired up in order. Otherwise, no normals are returned.
+    //
+    // The buffer is split into chunks of whole lines, which are parsed in parallel.
+    void read_obj( char const * buf, size_t length,
+                   std::vector<float> & vertices,
+                   std::vector<float> & normals,
+                   std::vector<uint32_t> & faces,
+                   int num_threads )
+    {
+        using namespace detail;
+
+        // Choose chunk boundaries, each just after a newline.
+        size_t const min_chunk_size = 1 << 20;
+        size_t num_chunks = resolve_num_threads(num_threads, length / min_chunk_size) * 4;
+        std::vector<size_t> boundaries = { 0 };
+        for (size_t c = 1; c < num_chunks; ++c)
+        {
+            size_t pos = std::max(boundaries.back(), c * length / num_chunks);
+            char const * newline = static_cast<char const *>(std::memchr(buf + pos, '\n', length - pos));
+            if (newline == nullptr)
+            {
+                break;
+            }
+            boundaries.push_back(newline + 1 - buf);
+        }
+        boundaries.push_back(length);
+        num_chunks = boundaries.size() - 1;
+
+        std::vector<ObjChunk> chunks(num_chunks);
+        parallel_for(num_chunks, num_threads, [&](size_t c) {
+            parse_obj_chunk(buf + boundaries[c], buf + boundaries[c+1], chunks[c]);
+        });
+
+        std::vector<size_t> vertex_bases(num_chunks + 1, 0);
+        std::vector<size_t> normal_bases(num_chunks + 1, 0);
+        std::vector<size_t> corner_bases(num_chunks + 1, 0);
+        bool has_normal_references = false;
+        for (size_t c = 0; c < num_chunks; ++c)
+        {
+            vertex_bases[c+1] = vertex_bases[c] + chunks[c].vertices.size() / 3;
+            normal_bases[c+1] = normal_bases[c] + chunks[c].normals.size() / 3;
+            corner_bases[c+1] = corner_bases[c] + chunks[c].corner_vertices.size();
+            for (int64_t reference : chunks[c].corner_normals)
+            {
+                has_normal_references = has_normal_references || (reference != obj_no_reference);
+            }
+        }
+
+        size_t vertex_count = vertex_bases[num_chunks];
+        size_t normal_count = normal_bases[num_chunks];
+        if (vertex_count > std::numeric_limits<uint32_t>::max())
+        {
+            throw std::runtime_error("OBJ mesh has too many vertices for uint32 face indexes");
+        }
+
+        vertices.resize(3 * vertex_count);
+        faces.resize(corner_bases[num_chunks]);
+
+        std::vector<float> all_normals(3 * normal_count);
+        parallel_for(num_chunks, num_threads, [&](size_t c) {
+            auto const & chunk = chunks[c];
+            std::copy(chunk.vertices.begin(), chunk.vertices.end(), vertices.begin() + 3*vertex_bases[c]);
+            std::copy(chunk.normals.begin(), chunk.normals.end(), all_normals.begin() + 3*normal_bases[c]);
+            for (size_t i = 0; i < chunk.corner_vertices.size(); ++i)
+            {
+                faces[corner_bases[c] + i] = resolve_obj_reference(chunk.corner_vertices[i], vertex_bases[c], vertex_count);
+            }
+        });
+
+        normals.clear();
+        if (has_normal_references)
+        {
+            // Serial, so that if corners disagree, the last reference wins deterministically.
+            normals.resize(3 * vertex_count, 0.0f);
+            for (size_t c = 0; c < num_chunks; ++c)
+            {
+                auto const & chunk = chunks[c];
+                for (size_t i = 0; i < chunk.corner_normals.size(); ++i)
+                {
+                    if (chunk.corner_normals[i] != obj_no_reference)
+                    {
+                        uint32_t n = resolve_obj_reference(chunk.corner_normals[i], normal_bases[c], normal_count);
+                        uint32_t v = faces[corner_bases[c] + i];
+                        std::copy_n(&all_normals[3*n], 3, &normals[3*v]);
+                    }
+                }
+            }
+        }
+        else if (normal_count == vertex_count)
+        {
+            normals.swap(all_normals);
+        }
+    }
+
+    //
+    // Python wrappers
+    //
+
+    namespace detail
+    {
+        // Pack the given arrays and pass their buffers to write(vertices, vertex_count, normals, normal_count, faces, face_count),
+        // with the GIL released. Returns the result as a bytes object.
+        template <typename write_func_t>
+        py::bytes write_mesh_bytes( vertices_array_t const & vertices,
+                                    normals_array_t const & normals,
+                                    faces_array_t const & faces,
+                                    write_func_t write )
+        {
+            check_rows(vertices, 3, "vertices");
+            check_rows(normals, 3, "normals");
+            check_rows(faces, 3, "faces");
+
+            std::string buf;
+            {
+                py::gil_scoped_release nogil;
+
+                std::vector<float> vertices_scratch;
+                std::vector<float> normals_scratch;
+                std::vector<uint32_t> faces_scratch;
+                size_t normal_count = normals.shape()[0];
+                buf = write( packed_rows(vertices, vertices_scratch), vertices.shape()[0],
+                             (normal_count > 0) ? packed_rows(normals, normals_scratch) : nullptr, normal_count,
+                             packed_rows(faces, faces_scratch), faces.shape()[0] );
+            }
+            return py::bytes(buf);
+        }
+
+        // Call read(buf, length, vertices, normals, faces) with the GIL released,
+        // and return the results as (vertices, normals, faces) arrays.
+        template <typename read_func_t>
+        std::tuple<vertices_array_t, normals_array_t, faces_array_t>
+        read_mesh_bytes( py::bytes const & mesh_bytes, read_func_t read )
+        {
+            char * raw_buf = nullptr;
+            Py_ssize_t length = 0;
+            PyBytes_AsStringAndSize(mesh_bytes.ptr(), &raw_buf, &length);
+
+            std::vector<float> vertices;
+            std::vector<float> normals;
+            std::vector<uint32_t> faces;
+            {
+                py::gil_scoped_release nogil;
+                read(raw_buf, size_t(length), vertices, normals, faces);
+            }
+
+            vertices_array_t::shape_type verts_shape = {{vertices.size() / 3, 3}};
+            vertices_array_t vertices_array(verts_shape);
+            std::copy(vertices.begin(), vertices.end(), vertices_array.data());
+
+            normals_array_t::shape_type normals_shape = {{normals.size() / 3, 3}};
+            normals_array_t normals_array(normals_shape);
+            std::copy(normals.begin(), normals.end(), normals_array.data());
+
+            faces_array_t::shape_type faces_shape = {{faces.size() / 3, 3}};
+            faces_array_t faces_array(faces_shape);
+            std::copy(faces.begin(), faces.end(), faces_array.data());
+
+            return std::make_tuple( std::move(vertices_array), std::move(normals_array), std::move(faces_array) );
+        }
+    }
+
+    // Encode a mesh in neuroglancer's legacy format.
+    // That format has no normals, so the normals are ignored.
+    py::bytes encode_faces_to_ngmesh_bytes( vertices_array_t const & vertices,
+                                            normals_array_t const & normals,
+                                            faces_array_t const & faces )
+    {
+        return detail::write_mesh_bytes(vertices, normals, faces,
+            [](float const * v, size_t nv, float const *, size_t, uint32_t const * f, size_t nf) {
+                return write_ngmesh(v, nv, f, nf);
+            });
+    }
+
+    // Decode a neuroglancer legacy mesh. The returned normals array is always empty.
+    std::tuple<vertices_array_t, normals_array_t, faces_array_t>
+    decode_ngmesh_bytes( py::bytes const & ngmesh_bytes )
+    {
+        return detail::read_mesh_bytes(ngmesh_bytes,
+            [](char const * buf, size_t length, std::vector<float> & v, std::vector<float> &, std::vector<uint32_t> & f) {
+                read_ngmesh(buf, length, v, f);
+            });
+    }
+
+    py::bytes encode_faces_to_ply_bytes( vertices_array_t const & vertices,
+                                         normals_array_t const & normals,
+                                         faces_array_t const & faces )
+    {
+        return detail::write_mesh_bytes(vertices, normals, faces, write_ply);
+    }
+
+    std::tuple<vertices_array_t, normals_array_t, faces_array_t>
+    decode_ply_bytes( py::bytes const & ply_bytes )
+    {
+        return detail::read_mesh_bytes(ply_bytes, read_ply);
+    }
+
+    py::bytes encode_faces_to_obj_bytes( vertices_array_t const & vertices,
+                                         normals_array_t const & normals,
+                                         faces_array_t const & faces,
+                                         int num_threads )
+    {
+        return detail::write_mesh_bytes(vertices, normals, faces,
+            [num_threads](float const * v, size_t nv, float const * n, size_t nn, uint32_t const * f, size_t nf) {
+                return write_obj(v, nv, n, nn, f, nf, num_threads);
+            });
+    }
+
+    std::tuple<vertices_array_t, normals_array_t, faces_array_t>
+    decode_obj_bytes( py::bytes const & obj_bytes, int num_threads )
+    {
+        return detail::read_mesh_bytes(obj_bytes,
+            [num_threads](char const * buf, size_t length, std::vector<float> & v, std::vector<float> & n, std::vector<uint32_t> & f) {
+                read_obj(buf, length, v, n, f, num_threads);
+            });
+    }
+}
+
+#endif
@@ -0,0 +1,273 @@
+#ifndef DVIDUTILS_MESH_METRICS_HPP
+#define DVIDUTILS_MESH_METRICS_HPP
+
+#include <cstdint>
+#include <cmath>
+#include <array>
+#include <vector>
+#include <tuple>
+#include <mutex>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+
+#include "pybind11/pybind11.h"
+#include "pybind11/stl.h"
+
+#include "pydraco.hpp"
+#include "parallel.hpp"
+
+namespace py = pybind11;
+using namespace pybind11::literals;
+
+using std::size_t;
+using std::uint32_t;
+
+namespace dvidutils
+{
+    // Summary measurements of a triangle mesh, as computed by compute_mesh_metrics()
+    struct MeshMetrics
+    {
+        size_t vertex_count = 0;
+        size_t face_count = 0;
+        double surface_area = 0.0;
+        double volume = 0.0;
+        std::array<double, 3> centroid{{ 0.0, 0.0, 0.0 }};
+        std::array<float, 3> bounds_min{{ 0.0f, 0.0f, 0.0f }};
+        std::array<float, 3> bounds_max{{ 0.0f, 0.0f, 0.0f }};
+    };
+
+    // Measure a mesh, given as row-major (N,3) buffers, in one pass over its faces
+    // (and one over its vertices, for the bounds).
+    //
+    // - surface_area: the total area of the faces
+    // - volume: the signed volume enclosed by the faces (positive for outward-facing triangles),
+    //   which is only meaningful for closed meshes
+    // - centroid: the center of mass of the enclosed volume,
+    //   or the mean of the vertices if the volume is zero (e.g. for an empty or flat mesh)
+    // - bounds_min, bounds_max: the bounding box of the vertices (including any unused vertices)
+    //
+    // Sums are accumulated in double precision, relative to the first vertex,
+    // so meshes far from the origin don't lose precision.
+    MeshMetrics compute_mesh_metrics( float const * vertices, size_t vertex_count,
+                                      uint32_t const * faces, size_t face_count )
+    {
+        MeshMetrics metrics;
+        metrics.vertex_count = vertex_count;
+        metrics.face_count = face_count;
+        if (vertex_count == 0)
+        {
+            if (face_count > 0)
+            {
+                throw std::runtime_error("Face indexes exceed vertices length");
+            }
+            return metrics;
+        }
+
+        std::array<double, 3> vertex_sum{{ 0.0, 0.0, 0.0 }};
+        metrics.bounds_min = {{ vertices[0], vertices[1], vertices[2] }};
+        metrics.bounds_max = metrics.bounds_min;
+        for (size_t v = 0; v < vertex_count; ++v)
+        {
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                float x = vertices[3*v + axis];
+                metrics.bounds_min[axis] = std::min(metrics.bounds_min[axis], x);
+                metrics.bounds_max[axis] = std::max(metrics.bounds_max[axis], x);
+                vertex_sum[axis] += x;
+            }
+        }
+
+        std::array<double, 3> const origin{{ vertices[0], vertices[1], vertices[2] }};
+        double area2 = 0.0;             // twice the area
+        double volume6 = 0.0;           // six times the volume
+        std::array<double, 3> moment{{ 0.0, 0.0, 0.0 }};   // 24 * volume * centroid (relative to origin)
+
+        for (size_t f = 0; f < face_count; ++f)
+        {
+            std::array<std::array<double, 3>, 3> corners;
+            for (int corner = 0; corner < 3; ++corner)
+            {
+                uint32_t v = faces[3*f + corner];
+                if (v >= vertex_count)
+                {
+                    throw std::runtime_error("Face indexes exceed vertices length");
+                }
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    corners[corner][axis] = vertices[3*v + axis] - origin[axis];
+                }
+            }
+            auto const & a = corners[0];
+            auto const & b = corners[1];
+            auto const & c = corners[2];
+
+            // Area, from the cross product of two edges
+            double ux = b[0] - a[0], uy = b[1] - a[1], uz = b[2] - a[2];
+            double wx = c[0] - a[0], wy = c[1] - a[1], wz = c[2] - a[2];
+            double nx = uy*wz - uz*wy;
+            double ny = uz*wx - ux*wz;
+            double nz = ux*wy - uy*wx;
+            area2 += std::sqrt(nx*nx + ny*ny + nz*nz);
+
+            // Volume and moment of the tetrahedron (origin, a, b, c)
+            double det = a[0] * (b[1]*c[2] - b[2]*c[1])
+                       - a[1] * (b[0]*c[2] - b[2]*c[0])
+                       + a[2] * (b[0]*c[1] - b[1]*c[0]);
+            volume6 += det;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                moment[axis] += det * (a[axis] + b[axis] + c[axis]);
+            }
+        }
+
+        metrics.surface_area = area2 / 2.0;
+        metrics.volume = volume6 / 6.0;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            if (volume6 != 0.0)
+            {
+                metrics.centroid[axis] = origin[axis] + moment[axis] / (4.0 * volume6);
+            }
+            else
+            {
+                metrics.centroid[axis] = vertex_sum[axis] / vertex_count;
+            }
+        }
+        return metrics;
+    }
+
+    // Convert a MeshMetrics to a python dict (requires the GIL).
+    // An empty mesh has bounds None.
+    py::dict mesh_metrics_to_dict( MeshMetrics const & metrics )
+    {
+        py::dict result( "vertex_count"_a=metrics.vertex_count,
+                         "face_count"_a=metrics.face_count,
+                         "surface_area"_a=metrics.surface_area,
+                         "volume"_a=metrics.volume,
+                         "centroid"_a=metrics.centroid );
+        if (metrics.vertex_count > 0)
+        {
+            result["bounds"] = py::make_tuple(metrics.bounds_min, metrics.bounds_max);
+        }
+        else
+        {
+            result["bounds"] = py::none();
+        }
+        return result;
+    }
+
+    // Measure a mesh (see compute_mesh_metrics()), and return the results as a dict.
+    py::dict mesh_metrics( vertices_array_t const & vertices, faces_array_t const & faces )
+    {
+        check_rows(vertices, 3, "vertices");
+        check_rows(faces, 3, "faces");
+
+        MeshMetrics metrics;
+        {
+            py::gil_scoped_release nogil;
+            std::vector<float> vertices_scratch;
+            std::vector<uint32_t> faces_scratch;
+            metrics = compute_mesh_metrics( packed_rows(vertices, vertices_scratch), vertices.shape()[0],
+                                            packed_rows(faces, faces_scratch), faces.shape()[0] );
+        }
+        return mesh_metrics_to_dict(metrics);
+    }
+
+    // Measure a list of (vertices, faces) meshes concurrently, in a pool of
+    // num_threads native threads (0 means "use all cores"), with the GIL released.
+    // Returns a list of dicts, as mesh_metrics() would.
+    py::list mesh_metrics_many( std::vector<std::tuple<vertices_array_t, faces_array_t>> const & meshes, int num_threads )
+    {
+        for (auto const & mesh : meshes)
+        {
+            check_rows(std::get<0>(mesh), 3, "vertices");
+            check_rows(std::get<1>(mesh), 3, "faces");
+        }
+
+        std::vector<MeshMetrics> all_metrics(meshes.size());
+        {
+            py::gil_scoped_release nogil;
+            parallel_for(meshes.size(), num_threads, [&](size_t i) {
+                auto const & vertices = std::get<0>(meshes[i]);
+                auto const & faces = std::get<1>(meshes[i]);
+                std::vector<float> vertices_scratch;
+                std::vector<uint32_t> faces_scratch;
+                all_metrics[i] = compute_mesh_metrics( packed_rows(vertices, vertices_scratch), vertices.shape()[0],
+                                                       packed_rows(faces, faces_scratch), faces.shape()[0] );
+            });
+        }
+
+        py::list results;
+        for (auto const & metrics : all_metrics)
+        {
+            results.append(mesh_metrics_to_dict(metrics));
+        }
+        return results;
+    }
+
+    // Decode a list of draco-encoded buffers and measure each mesh, without
+    // creating any python arrays for them.  Each worker thread decodes into its
+    // own scratch buffers, which are reused from one mesh to the next.
+    //
+    // Empty buffers yield the metrics of an empty mesh.
+    // As in decode_many_drc_bytes(), deduplicate=false skips the post-decode
+    // deduplication, which leaves the area, volume and bounds unchanged,
+    // but reports the duplicated vertex_count.
+    py::list drc_mesh_metrics( std::vector<py::bytes> const & drc_bytes_list, bool deduplicate, int num_threads )
+    {
+        size_t count = drc_bytes_list.size();
+        std::vector<char *> raw_bufs(count, nullptr);
+        std::vector<Py_ssize_t> bytes_lengths(count, 0);
+        for (size_t i = 0; i < count; ++i)
+        {
+            PyBytes_AsStringAndSize(drc_bytes_list[i].ptr(), &raw_bufs[i], &bytes_lengths[i]);
+        }
+
+        std::vector<MeshMetrics> all_metrics(count);
+        {
+            py::gil_scoped_release nogil;
+
+            // Scratch buffers, one pair per worker.
+            // (parallel_for() doesn't say which worker runs an item, so they're checked out from a pool.)
+            std::mutex pool_mutex;
+            std::vector<std::pair<std::vector<float>, std::vector<uint32_t>>> pool;
+
+            parallel_for(count, num_threads, [&](size_t i) {
+                if (bytes_lengths[i] == 0)
+                {
+                    return;
+                }
+                MeshPtr pMesh = decode_buffer_to_mesh(raw_bufs[i], bytes_lengths[i], deduplicate);
+
+                std::pair<std::vector<float>, std::vector<uint32_t>> scratch;
+                {
+                    std::lock_guard<std::mutex> lock(pool_mutex);
+                    if (!pool.empty())
+                    {
+                        scratch = std::move(pool.back());
+                        pool.pop_back();
+                    }
+                }
+
+                scratch.first.resize(3 * size_t(pMesh->num_points()));
+                scratch.second.resize(3 * size_t(pMesh->num_faces()));
+                extract_mesh(*pMesh, scratch.first.data(), nullptr, scratch.second.data());
+                all_metrics[i] = compute_mesh_metrics( scratch.first.data(), pMesh->num_points(),
+                                                       scratch.second.data(), pMesh->num_faces() );
+
+                std::lock_guard<std::mutex> lock(pool_mutex);
+                pool.push_back(std::move(scratch));
+            });
+        }
+
+        py::list results;
+        for (auto const & metrics : all_metrics)
+        {
+            results.append(mesh_metrics_to_dict(metrics));
+        }
+        return results;
+    }
+}
+
+#endif
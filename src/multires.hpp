@@ -0,0 +1,567 @@
+#ifndef DVIDUTILS_MULTIRES_HPP
+#define DVIDUTILS_MULTIRES_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <array>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <tuple>
+#include <map>
+#include <algorithm>
+
+#include "pybind11/pybind11.h"
+#include "pybind11/stl.h"
+
+#include "pydraco.hpp"
+#include "partition_mesh.hpp"
+#include "concatenate_meshes.hpp"
+#include "parallel.hpp"
+
+// Neuroglancer only supports these two values for vertex_quantization_bits
+int DEFAULT_MULTIRES_QUANTIZATION_BITS = 16;
+
+namespace dvidutils
+{
+    // The position of a fragment within its LOD's grid
+    typedef std::array<uint32_t, 3> fragment_position_t;
+
+    // Interleave the bits of a fragment position to produce its Z-curve (Morton) code,
+    // with x in the least-significant position.
+    // Neuroglancer requires the fragments of each LOD to be listed in this order.
+    uint64_t morton_code(fragment_position_t const & position)
+    {
+        uint64_t code = 0;
+        for (int bit = 0; bit < 21; ++bit)
+        {
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                code |= uint64_t((position[axis] >> bit) & 1) << (3*bit + axis);
+            }
+        }
+        return code;
+    }
+
+    // The contents of a neuroglancer multi-resolution mesh manifest (the '.index' file).
+    // See neuroglancer's precomputed mesh format documentation ('neuroglancer_multilod_draco').
+    struct MultiresManifest
+    {
+        std::array<float, 3> chunk_shape;
+        std::array<float, 3> grid_origin;
+        std::vector<float> lod_scales;
+        std::vector<std::array<float, 3>> vertex_offsets;
+
+        // Per LOD: fragment positions (in Z-curve order) and their encoded sizes in bytes.
+        std::vector<std::vector<fragment_position_t>> fragment_positions;
+        std::vector<std::vector<uint32_t>> fragment_sizes;
+
+        size_t num_lods() const { return lod_scales.size(); }
+
+        // Serialize in the manifest's binary (little-endian) layout:
+        //
+        //   chunk_shape: float32[3]
+        //   grid_origin: float32[3]
+        //   num_lods: uint32
+        //   lod_scales: float32[num_lods]
+        //   vertex_offsets: float32[num_lods, 3]
+        //   num_fragments_per_lod: uint32[num_lods]
+        //   for each lod:
+        //     fragment_positions: uint32[3, num_fragments]  (all x, then all y, then all z)
+        //     fragment_offsets: uint32[num_fragments]       (i.e. the size of each fragment)
+        //
+        std::string serialize() const
+        {
+            std::string buf;
+            for (float x : chunk_shape) { append(buf, x); }
+            for (float x : grid_origin) { append(buf, x); }
+            append(buf, uint32_t(num_lods()));
+            for (float x : lod_scales) { append(buf, x); }
+            for (auto const & offset : vertex_offsets)
+            {
+                for (float x : offset) { append(buf, x); }
+            }
+            for (auto const & positions : fragment_positions)
+            {
+                append(buf, uint32_t(positions.size()));
+            }
+            for (size_t lod = 0; lod < num_lods(); ++lod)
+            {
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    for (auto const & position : fragment_positions[lod])
+                    {
+                        append(buf, position[axis]);
+                    }
+                }
+                for (uint32_t size : fragment_sizes[lod])
+                {
+                    append(buf, size);
+                }
+            }
+            return buf;
+        }
+
+        // Parse a manifest from its binary layout (see serialize()).
+        static MultiresManifest deserialize(char const * buf, size_t size)
+        {
+            MultiresManifest manifest;
+            size_t pos = 0;
+            for (float & x : manifest.chunk_shape) { x = read<float>(buf, size, pos); }
+            for (float & x : manifest.grid_origin) { x = read<float>(buf, size, pos); }
+
+            uint32_t num_lods = read<uint32_t>(buf, size, pos);
+            if (size_t(num_lods) * 20 > size - pos)
+            {
+                throw std::runtime_error("Invalid multires manifest: too many LODs for its size");
+            }
+            manifest.lod_scales.resize(num_lods);
+            manifest.vertex_offsets.resize(num_lods);
+            manifest.fragment_positions.resize(num_lods);
+            manifest.fragment_sizes.resize(num_lods);
+
+            for (float & x : manifest.lod_scales) { x = read<float>(buf, size, pos); }
+            for (auto & offset : manifest.vertex_offsets)
+            {
+                for (float & x : offset) { x = read<float>(buf, size, pos); }
+            }
+
+            std::vector<uint32_t> num_fragments(num_lods);
+            for (uint32_t & n : num_fragments) { n = read<uint32_t>(buf, size, pos); }
+
+            for (size_t lod = 0; lod < num_lods; ++lod)
+            {
+                if (size_t(num_fragments[lod]) * 16 > size - pos)
+                {
+                    throw std::runtime_error("Invalid multires manifest: too many fragments for its size");
+                }
+                manifest.fragment_positions[lod].resize(num_fragments[lod]);
+                manifest.fragment_sizes[lod].resize(num_fragments[lod]);
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    for (auto & position : manifest.fragment_positions[lod])
+                    {
+                        position[axis] = read<uint32_t>(buf, size, pos);
+                    }
+                }
+                for (uint32_t & fragment_size : manifest.fragment_sizes[lod])
+                {
+                    fragment_size = read<uint32_t>(buf, size, pos);
+                }
+            }
+
+            if (pos != size)
+            {
+                throw std::runtime_error("Invalid multires manifest: unexpected trailing bytes");
+            }
+            return manifest;
+        }
+
+    private:
+        // Read a little-endian 4-byte value at 'pos', and advance 'pos'.
+        template <typename T>
+        static T read(char const * buf, size_t size, size_t & pos)
+        {
+            static_assert(sizeof(T) == 4, "Manifest fields are all 4 bytes wide");
+            if (size - pos < 4)
+            {
+                throw std::runtime_error("Invalid multires manifest: unexpected end of data");
+            }
+            uint32_t bits = 0;
+            for (int i = 0; i < 4; ++i)
+            {
+                bits |= uint32_t(static_cast<unsigned char>(buf[pos + i])) << (8*i);
+            }
+            pos += 4;
+
+            T value;
+            std::memcpy(&value, &bits, 4);
+            return value;
+        }
+
+        // Append the little-endian representation of a 4-byte value
+        template <typename T>
+        static void append(std::string & buf, T value)
+        {
+            static_assert(sizeof(T) == 4, "Manifest fields are all 4 bytes wide");
+            uint32_t bits;
+            std::memcpy(&bits, &value, 4);
+            for (int i = 0; i < 4; ++i)
+            {
+                buf.push_back(static_cast<char>((bits >> (8*i)) & 0xFF));
+            }
+        }
+    };
+
+    // Produce a neuroglancer multi-resolution ('neuroglancer_multilod_draco') mesh
+    // from a list of meshes, one per LOD, from finest (LOD 0) to coarsest.
+    //
+    // The mesh for LOD L is split into fragments along a grid of cells of size
+    // chunk_shape * 2**L, starting at grid_origin + vertex_offsets[L].
+    // Faces that cross cell boundaries are clipped, so each fragment lies within its own cell.
+    // Each fragment is encoded in the 'custom' draco format (see encode_faces_to_custom_drc_bytes()),
+    // with its vertices quantized relative to its cell using vertex_quantization_bits (10 or 16).
+    //
+    // Neuroglancer walks the LODs as an octree, starting from the coarsest LOD,
+    // so every fragment must have a parent in the next coarser LOD.
+    // Where the coarser mesh has no faces in a parent cell, an empty fragment is listed.
+    //
+    // If lod_scales is empty, it defaults to [1, 2, 4, ...].
+    // If vertex_offsets is empty, it defaults to all zeros.
+    //
+    // Returns (manifest, data), the contents of the '<segment>.index' file and the fragment data file.
+    // Fragments are partitioned and encoded in parallel, with the GIL released.
+    std::tuple<py::bytes, py::bytes> write_multires_mesh( std::vector<std::tuple<vertices_array_t, faces_array_t>> const & lod_meshes,
+                                                          std::array<double, 3> const & chunk_shape,
+                                                          std::array<double, 3> const & grid_origin,
+                                                          std::vector<double> const & lod_scales,
+                                                          std::vector<std::array<double, 3>> const & vertex_offsets,
+                                                          int vertex_quantization_bits,
+                                                          int compression_level,
+                                                          int num_threads )
+    {
+        size_t num_lods = lod_meshes.size();
+        if (num_lods == 0)
+        {
+            throw std::runtime_error("At least one LOD mesh is required");
+        }
+        if (vertex_quantization_bits != 10 && vertex_quantization_bits != 16)
+        {
+            throw std::runtime_error("vertex_quantization_bits must be 10 or 16");
+        }
+        if (!lod_scales.empty() && lod_scales.size() != num_lods)
+        {
+            throw std::runtime_error("lod_scales must have one entry per LOD");
+        }
+        if (!vertex_offsets.empty() && vertex_offsets.size() != num_lods)
+        {
+            throw std::runtime_error("vertex_offsets must have one entry per LOD");
+        }
+
+        for (auto const & mesh : lod_meshes)
+        {
+            check_rows(std::get<0>(mesh), 3, "vertices");
+            check_rows(std::get<1>(mesh), 3, "faces");
+        }
+
+        MultiresManifest manifest;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            manifest.chunk_shape[axis] = chunk_shape[axis];
+            manifest.grid_origin[axis] = grid_origin[axis];
+        }
+        for (size_t lod = 0; lod < num_lods; ++lod)
+        {
+            manifest.lod_scales.push_back(lod_scales.empty() ? double(1 << lod) : lod_scales[lod]);
+            std::array<float, 3> offset{{ 0.0f, 0.0f, 0.0f }};
+            if (!vertex_offsets.empty())
+            {
+                offset = {{ float(vertex_offsets[lod][0]), float(vertex_offsets[lod][1]), float(vertex_offsets[lod][2]) }};
+            }
+            manifest.vertex_offsets.push_back(offset);
+        }
+
+        DracoEncoderSettings settings;
+        settings.compression_level = compression_level;
+        settings.position_quantization_bits = vertex_quantization_bits;
+
+        std::string data;
+
+        {
+            py::gil_scoped_release nogil;
+
+            // Partition each LOD into its grid.
+            std::vector<std::vector<MeshFragment>> lod_fragments(num_lods);
+            std::vector<std::array<double, 3>> lod_cell_shapes(num_lods);
+            std::vector<std::array<double, 3>> lod_origins(num_lods);
+            for (size_t lod = 0; lod < num_lods; ++lod)
+            {
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    lod_cell_shapes[lod][axis] = chunk_shape[axis] * double(uint64_t(1) << lod);
+                    lod_origins[lod][axis] = grid_origin[axis] + manifest.vertex_offsets[lod][axis];
+                }
+
+                auto const & vertices = std::get<0>(lod_meshes[lod]);
+                auto const & faces = std::get<1>(lod_meshes[lod]);
+
+                std::vector<float> vertices_scratch;
+                std::vector<uint32_t> faces_scratch;
+                lod_fragments[lod] = partition_mesh_buffers( packed_rows(vertices, vertices_scratch), vertices.shape()[0],
+                                                             packed_rows(faces, faces_scratch), faces.shape()[0],
+                                                             lod_cell_shapes[lod], lod_origins[lod],
+                                                             true, num_threads );
+            }
+
+            // Determine the fragment positions for each LOD,
+            // adding (empty) parents for any fragments that lack one.
+            // Map from position -> fragment (or nullptr for empty fragments)
+            std::vector<std::map<fragment_position_t, MeshFragment const *>> lod_positions(num_lods);
+            for (size_t lod = 0; lod < num_lods; ++lod)
+            {
+                for (auto const & fragment : lod_fragments[lod])
+                {
+                    if (*std::min_element(fragment.cell.begin(), fragment.cell.end()) < 0)
+                    {
+                        std::ostringstream ss;
+                        ss << "LOD " << lod << " mesh extends below the grid origin";
+                        throw std::runtime_error(ss.str());
+                    }
+                    fragment_position_t position{{ uint32_t(fragment.cell[0]), uint32_t(fragment.cell[1]), uint32_t(fragment.cell[2]) }};
+                    lod_positions[lod][position] = &fragment;
+                }
+                if (lod > 0)
+                {
+                    for (auto const & child : lod_positions[lod-1])
+                    {
+                        fragment_position_t parent{{ child.first[0] >> 1, child.first[1] >> 1, child.first[2] >> 1 }};
+                        lod_positions[lod].emplace(parent, nullptr); // no-op if the parent already exists
+                    }
+                }
+            }
+
+            // Put each LOD's fragments in Z-curve order
+            std::vector<std::vector<std::pair<fragment_position_t, MeshFragment const *>>> ordered(num_lods);
+            for (size_t lod = 0; lod < num_lods; ++lod)
+            {
+                ordered[lod].assign(lod_positions[lod].begin(), lod_positions[lod].end());
+                std::sort( ordered[lod].begin(), ordered[lod].end(), [](auto const & a, auto const & b) {
+                    return morton_code(a.first) < morton_code(b.first);
+                });
+            }
+
+            // Encode all fragments (of all LODs) in parallel
+            std::vector<std::tuple<size_t, size_t>> jobs;
+            for (size_t lod = 0; lod < num_lods; ++lod)
+            {
+                for (size_t i = 0; i < ordered[lod].size(); ++i)
+                {
+                    jobs.emplace_back(lod, i);
+                }
+            }
+
+            std::vector<draco::EncoderBuffer> buffers(jobs.size());
+            parallel_for(jobs.size(), num_threads, [&](size_t j) {
+                size_t lod = std::get<0>(jobs[j]);
+                auto const & entry = ordered[lod][std::get<1>(jobs[j])];
+                MeshFragment const * fragment = entry.second;
+                if (fragment == nullptr)
+                {
+                    return;
+                }
+
+                std::array<double, 3> fragment_origin;
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    fragment_origin[axis] = lod_origins[lod][axis] + entry.first[axis] * lod_cell_shapes[lod][axis];
+                }
+
+                Quantizer quantizer(lod_cell_shapes[lod], fragment_origin, vertex_quantization_bits);
+                size_t vertex_count = fragment->vertices.size() / 3;
+                std::vector<uint32_t> quantized(3 * vertex_count);
+                quantizer.quantize(fragment->vertices.data(), vertex_count, quantized.data());
+
+                encode_packed_mesh_to_buffer( draco::DT_UINT32, quantized.data(), vertex_count,
+                                              nullptr, 0,
+                                              fragment->faces.data(), fragment->faces.size() / 3,
+                                              settings, buffers[j] );
+            });
+
+            // Assemble the manifest and the data
+            manifest.fragment_positions.resize(num_lods);
+            manifest.fragment_sizes.resize(num_lods);
+            size_t total_size = 0;
+            for (auto const & buf : buffers)
+            {
+                total_size += buf.size();
+            }
+            data.reserve(total_size);
+
+            for (size_t j = 0; j < jobs.size(); ++j)
+            {
+                size_t lod = std::get<0>(jobs[j]);
+                manifest.fragment_positions[lod].push_back(ordered[lod][std::get<1>(jobs[j])].first);
+                manifest.fragment_sizes[lod].push_back(buffers[j].size());
+                data.append(buffers[j].data(), buffers[j].size());
+            }
+        }
+
+        std::string manifest_buf = manifest.serialize();
+        return std::make_tuple( py::bytes(manifest_buf), py::bytes(data) );
+    }
+
+    // Read one LOD of a neuroglancer multi-resolution mesh (as written by write_multires_mesh())
+    // from its manifest ('.index' file) and fragment data, and return it as a single mesh.
+    //
+    // If bounding_box is given, as [(x0,y0,z0), (x1,y1,z1)] (in the same coordinates as
+    // the vertices), only the fragments whose cells intersect it are read.
+    // (Faces are not clipped, so the mesh may extend up to one cell beyond the box.)
+    //
+    // The selected fragments are decoded in parallel, and their vertices are dequantized
+    // (relative to their cells, using vertex_quantization_bits) as they are extracted.
+    // If deduplicate is true, the vertices shared by neighboring fragments
+    // (along the cell boundaries) are welded together (see concatenate_meshes()).
+    //
+    // Returns (vertices, faces).
+    std::tuple<vertices_array_t, faces_array_t> read_multires_mesh( py::bytes const & manifest_bytes,
+                                                                    py::bytes const & data_bytes,
+                                                                    int lod,
+                                                                    std::vector<std::array<double, 3>> const & bounding_box,
+                                                                    int vertex_quantization_bits,
+                                                                    bool deduplicate,
+                                                                    int num_threads )
+    {
+        if (!bounding_box.empty() && bounding_box.size() != 2)
+        {
+            throw std::runtime_error("bounding_box must be given as [(x0,y0,z0), (x1,y1,z1)]");
+        }
+        if (vertex_quantization_bits < 1 || vertex_quantization_bits > 32)
+        {
+            throw std::runtime_error("vertex_quantization_bits must be in the range [1, 32]");
+        }
+
+        char * manifest_buf = nullptr;
+        Py_ssize_t manifest_size = 0;
+        PyBytes_AsStringAndSize(manifest_bytes.ptr(), &manifest_buf, &manifest_size);
+
+        char * data = nullptr;
+        Py_ssize_t data_size = 0;
+        PyBytes_AsStringAndSize(data_bytes.ptr(), &data, &data_size);
+
+        std::vector<float> vertices_buf;
+        std::vector<uint32_t> faces_buf;
+        std::vector<uint32_t> first_indexes;
+
+        {
+            py::gil_scoped_release nogil;
+
+            MultiresManifest manifest = MultiresManifest::deserialize(manifest_buf, manifest_size);
+            if (lod < 0 || size_t(lod) >= manifest.num_lods())
+            {
+                std::ostringstream ss;
+                ss << "LOD " << lod << " is out of range (the mesh has " << manifest.num_lods() << " LODs)";
+                throw std::runtime_error(ss.str());
+            }
+
+            // The fragments of all LODs are stored consecutively, starting with LOD 0.
+            size_t data_offset = 0;
+            for (int l = 0; l < lod; ++l)
+            {
+                for (uint32_t fragment_size : manifest.fragment_sizes[l])
+                {
+                    data_offset += fragment_size;
+                }
+            }
+
+            std::array<double, 3> cell_shape;
+            std::array<double, 3> lod_origin;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                cell_shape[axis] = manifest.chunk_shape[axis] * double(uint64_t(1) << lod);
+                lod_origin[axis] = manifest.grid_origin[axis] + manifest.vertex_offsets[lod][axis];
+            }
+
+            // Select the (non-empty) fragments within the bounding box
+            struct SelectedFragment
+            {
+                size_t offset;
+                size_t size;
+                std::array<double, 3> origin;
+            };
+            std::vector<SelectedFragment> selected;
+            auto const & positions = manifest.fragment_positions[lod];
+            auto const & sizes = manifest.fragment_sizes[lod];
+            for (size_t i = 0; i < positions.size(); ++i)
+            {
+                SelectedFragment fragment{ data_offset, sizes[i], {{ 0.0, 0.0, 0.0 }} };
+                data_offset += sizes[i];
+
+                bool intersects = true;
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    fragment.origin[axis] = lod_origin[axis] + positions[i][axis] * cell_shape[axis];
+                    if (!bounding_box.empty())
+                    {
+                        intersects = intersects && fragment.origin[axis] < bounding_box[1][axis]
+                                                && fragment.origin[axis] + cell_shape[axis] > bounding_box[0][axis];
+                    }
+                }
+                if (fragment.size > 0 && intersects)
+                {
+                    selected.push_back(fragment);
+                }
+            }
+            if (data_offset > size_t(data_size))
+            {
+                throw std::runtime_error("The multires fragment data is smaller than its manifest requires");
+            }
+
+            std::vector<MeshPtr> meshes(selected.size());
+            parallel_for(selected.size(), num_threads, [&](size_t i) {
+                meshes[i] = decode_buffer_to_mesh(data + selected[i].offset, selected[i].size);
+            });
+
+            std::vector<size_t> vertex_offsets(selected.size() + 1, 0);
+            std::vector<size_t> face_offsets(selected.size() + 1, 0);
+            for (size_t i = 0; i < selected.size(); ++i)
+            {
+                vertex_offsets[i+1] = vertex_offsets[i] + meshes[i]->num_points();
+                face_offsets[i+1] = face_offsets[i] + meshes[i]->num_faces();
+            }
+            if (vertex_offsets.back() > std::numeric_limits<uint32_t>::max())
+            {
+                throw std::runtime_error("Multires mesh has too many vertices for uint32 face indexes");
+            }
+
+            vertices_buf.resize(3 * vertex_offsets.back());
+            faces_buf.resize(3 * face_offsets.back());
+            parallel_for(selected.size(), num_threads, [&](size_t i) {
+                Quantizer dequantizer(cell_shape, selected[i].origin, vertex_quantization_bits);
+                extract_mesh( *meshes[i],
+                              vertices_buf.data() + 3*vertex_offsets[i],
+                              nullptr,
+                              faces_buf.data() + 3*face_offsets[i],
+                              uint32_t(vertex_offsets[i]),
+                              &dequantizer );
+                meshes[i].reset();
+            });
+
+            if (deduplicate)
+            {
+                std::vector<uint32_t> vertex_map;
+                weld_vertices(vertices_buf.data(), vertex_offsets.back(), num_threads, vertex_map, first_indexes);
+                for (auto & index : faces_buf)
+                {
+                    index = vertex_map[index];
+                }
+            }
+        }
+
+        size_t vertex_count = deduplicate ? first_indexes.size() : vertices_buf.size() / 3;
+        vertices_array_t::shape_type verts_shape = {{vertex_count, 3}};
+        vertices_array_t vertices(verts_shape);
+
+        faces_array_t::shape_type faces_shape = {{faces_buf.size() / 3, 3}};
+        faces_array_t faces(faces_shape);
+
+        {
+            py::gil_scoped_release nogil;
+            if (deduplicate)
+            {
+                for (size_t i = 0; i < vertex_count; ++i)
+                {
+                    std::copy_n(&vertices_buf[3*first_indexes[i]], 3, vertices.data() + 3*i);
+                }
+            }
+            else
+            {
+                std::copy(vertices_buf.begin(), vertices_buf.end(), vertices.data());
+            }
+            std::copy(faces_buf.begin(), faces_buf.end(), faces.data());
+        }
+
+        return std::make_tuple( std::move(vertices), std::move(faces) );
+    }
+}
+
+#endif
@@ -0,0 +1,183 @@
+#ifndef DVIDUTILS_NORMALS_HPP
+#define DVIDUTILS_NORMALS_HPP
+
+#include <cstdint>
+#include <cmath>
+#include <array>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+
+#include "parallel.hpp"
+
+using std::size_t;
+using std::uint32_t;
+
+namespace dvidutils
+{
+    // How each face's normal is weighted when it is accumulated into its vertices
+    enum class NormalWeighting
+    {
+        Area,   // by the face's area
+        Angle   // by the face's interior angle at the vertex
+    };
+
+    NormalWeighting parse_normal_weighting(std::string const & weighting)
+    {
+        if (weighting == "area")
+        {
+            return NormalWeighting::Area;
+        }
+        if (weighting == "angle")
+        {
+            return NormalWeighting::Angle;
+        }
+        throw std::runtime_error("weighting must be 'area' or 'angle', not '" + weighting + "'");
+    }
+
+    namespace detail
+    {
+        // Add the weighted normals of faces [begin, end) into 'sums' (row-major (N,3)).
+        void accumulate_face_normals( float const * vertices,
+                                      uint32_t const * faces,
+                                      size_t begin,
+                                      size_t end,
+                                      NormalWeighting weighting,
+                                      float * sums )
+        {
+            for (size_t f = begin; f < end; ++f)
+            {
+                uint32_t const * face = faces + 3*f;
+                float const * p[3] = { vertices + 3*face[0], vertices + 3*face[1], vertices + 3*face[2] };
+
+                std::array<float, 3> e01{{ p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] }};
+                std::array<float, 3> e02{{ p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] }};
+
+                // The cross product's length is twice the face area, which is exactly the area weighting.
+                std::array<float, 3> n{{ e01[1]*e02[2] - e01[2]*e02[1],
+                                         e01[2]*e02[0] - e01[0]*e02[2],
+                                         e01[0]*e02[1] - e01[1]*e02[0] }};
+
+                if (weighting == NormalWeighting::Area)
+                {
+                    for (int corner = 0; corner < 3; ++corner)
+                    {
+                        float * sum = sums + 3*face[corner];
+                        sum[0] += n[0];
+                        sum[1] += n[1];
+                        sum[2] += n[2];
+                    }
+                    continue;
+                }
+
+                float length = std::sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+                if (length == 0.0f)
+                {
+                    continue;
+                }
+                n = {{ n[0] / length, n[1] / length, n[2] / length }};
+
+                for (int corner = 0; corner < 3; ++corner)
+                {
+                    float const * a = p[corner];
+                    float const * b = p[(corner + 1) % 3];
+                    float const * c = p[(corner + 2) % 3];
+                    std::array<float, 3> ab{{ b[0] - a[0], b[1] - a[1], b[2] - a[2] }};
+                    std::array<float, 3> ac{{ c[0] - a[0], c[1] - a[1], c[2] - a[2] }};
+                    float ab_length = std::sqrt(ab[0]*ab[0] + ab[1]*ab[1] + ab[2]*ab[2]);
+                    float ac_length = std::sqrt(ac[0]*ac[0] + ac[1]*ac[1] + ac[2]*ac[2]);
+                    if (ab_length == 0.0f || ac_length == 0.0f)
+                    {
+                        continue;
+                    }
+                    float cosine = (ab[0]*ac[0] + ab[1]*ac[1] + ab[2]*ac[2]) / (ab_length * ac_length);
+                    float angle = std::acos(std::max(-1.0f, std::min(1.0f, cosine)));
+
+                    float * sum = sums + 3*face[corner];
+                    sum[0] += angle * n[0];
+                    sum[1] += angle * n[1];
+                    sum[2] += angle * n[2];
+                }
+            }
+        }
+
+        // Normalize the rows [begin, end) of a row-major (N,3) buffer in place.
+        // Zero-length rows are left as zeros.
+        // (Written as a plain loop over contiguous floats, so the compiler can vectorize it.)
+        void normalize_rows(float * rows, size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                float * row = rows + 3*i;
+                float length_squared = row[0]*row[0] + row[1]*row[1] + row[2]*row[2];
+                float scale = (length_squared > 0.0f) ? 1.0f / std::sqrt(length_squared) : 0.0f;
+                row[0] *= scale;
+                row[1] *= scale;
+                row[2] *= scale;
+            }
+        }
+    }
+
+    // Compute unit vertex normals for a mesh, by summing the (weighted) normals of each vertex's faces.
+    // Vertices with no faces (or only degenerate ones) get a normal of (0,0,0).
+    //
+    // All buffers are row-major (N,3). 'normals' must have room for vertex_count rows.
+    // The face indexes are assumed to be in bounds.
+    //
+    // The faces are split into one chunk per thread, each accumulated into its own buffer
+    // (so no atomics or locks are needed), and the buffers are then summed and normalized in parallel.
+    // Each extra buffer is a full (N,3) copy, so for very large meshes the number of chunks
+    // is capped to keep their total size under max_scratch_bytes.
+    void compute_vertex_normals( float const * vertices,
+                                 size_t vertex_count,
+                                 uint32_t const * faces,
+                                 size_t face_count,
+                                 NormalWeighting weighting,
+                                 int num_threads,
+                                 float * normals )
+    {
+        // Not worth spreading small meshes across threads
+        size_t const min_faces_per_chunk = 10000;
+        size_t num_chunks = resolve_num_threads(num_threads, std::max<size_t>(face_count / min_faces_per_chunk, 1));
+
+        // The first chunk accumulates directly into 'normals'; the others need their own buffers.
+        size_t const max_scratch_bytes = size_t(256) << 20;
+        size_t chunk_bytes = std::max<size_t>(3 * vertex_count * sizeof(float), 1);
+        num_chunks = std::min(num_chunks, 1 + max_scratch_bytes / chunk_bytes);
+
+        std::fill(normals, normals + 3*vertex_count, 0.0f);
+        std::vector<std::vector<float>> chunk_sums(num_chunks - 1);
+
+        parallel_for(num_chunks, num_threads, [&](size_t chunk) {
+            float * sums = normals;
+            if (chunk > 0)
+            {
+                chunk_sums[chunk-1].resize(3*vertex_count, 0.0f);
+                sums = chunk_sums[chunk-1].data();
+            }
+            detail::accumulate_face_normals( vertices, faces,
+                                             chunk * face_count / num_chunks,
+                                             (chunk + 1) * face_count / num_chunks,
+                                             weighting, sums );
+        });
+
+        // Reduce and normalize, in blocks of vertices.
+        size_t const block_size = 65536;
+        size_t num_blocks = (vertex_count + block_size - 1) / block_size;
+        parallel_for(num_blocks, num_threads, [&](size_t block) {
+            size_t begin = block * block_size;
+            size_t end = std::min(begin + block_size, vertex_count);
+            for (auto const & sums : chunk_sums)
+            {
+                for (size_t i = 3*begin; i < 3*end; ++i)
+                {
+                    normals[i] += sums[i];
+                }
+            }
+            detail::normalize_rows(normals, begin, end);
+        });
+    }
+}
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef DVIDUTILS_PARALLEL_HPP
+#define DVIDUTILS_PARALLEL_HPP
+
+#include <cstddef>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <vector>
+#include <exception>
+#include <system_error>
+#include <algorithm>
+
+using std::size_t;
+
+namespace dvidutils
+{
+    // Translate a user-supplied thread count into the number of workers to launch.
+    // A num_threads of 0 (or less) means "use all hardware threads".
+    // There's never any point in launching more workers than there are items.
+    size_t resolve_num_threads(int num_threads, size_t num_items)
+    {
+        size_t n = (num_threads > 0) ? num_threads : std::thread::hardware_concurrency();
+        n = std::max<size_t>(n, 1);
+        return std::min(n, std::max<size_t>(num_items, 1));
+    }
+
+    // Call func(i) for every i in [0, num_items), spread across a pool of worker threads.
+    //
+    // Items are handed out one at a time from a shared atomic counter,
+    // so uneven item costs (e.g. meshes of very different sizes) balance out naturally.
+    //
+    // If func throws, the remaining items are abandoned and the first
+    // exception is re-thrown in the calling thread once all workers have stopped.
+    //
+    // The GIL contract:
+    // The python bindings release the GIL (py::gil_scoped_release) before calling parallel_for(),
+    // so func must not create, destroy, or call into any Python objects.  It may read and write the
+    // data of arrays that were created (and are kept alive) while the GIL was held, and call any of the
+    // native helpers (e.g. encode_mesh_to_buffer(), decode_buffer_to_mesh(), compute_vertex_normals()),
+    // none of which touch Python objects.  The few helpers that do are marked "(Requires the GIL.)",
+    // and are called only after the GIL is re-acquired.
+    template <typename func_t>
+    void parallel_for(size_t num_items, int num_threads, func_t func)
+    {
+        size_t worker_count = resolve_num_threads(num_threads, num_items);
+        if (worker_count <= 1)
+        {
+            for (size_t i = 0; i < num_items; ++i)
+            {
+                func(i);
+            }
+            return;
+        }
+
+        std::atomic<size_t> next_item(0);
+        std::atomic<bool> failed(false);
+        std::exception_ptr first_error;
+        std::mutex error_mutex;
+
+        auto worker = [&]() {
+            while (!failed)
+            {
+                size_t i = next_item++;
+                if (i >= num_items)
+                {
+                    return;
+                }
+
+                try
+                {
+                    func(i);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    if (!first_error)
+                    {
+                        first_error = std::current_exception();
+                    }
+                    failed = true;
+                }
+            }
+        };
+
+        // The calling thread does its share of the work, too.
+        // If a thread can't be started (e.g. the process is out of threads),
+        // we make do with the workers we have: the calling thread's worker()
+        // picks up whatever the others don't, so every item still gets done.
+        // (Otherwise, the already-running threads would never be joined.)
+        std::vector<std::thread> threads;
+        threads.reserve(worker_count - 1);
+        for (size_t t = 0; t < worker_count - 1; ++t)
+        {
+            try
+            {
+                threads.emplace_back(worker);
+            }
+            catch (std::system_error const &)
+            {
+                break;
+            }
+        }
+        worker();
+
+        for (auto & thread : threads)
+        {
+            thread.join();
+        }
+
+        if (first_error)
+        {
+            std::rethrow_exception(first_error);
+        }
+    }
+}
+
+#endif
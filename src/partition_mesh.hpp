@@ -0,0 +1,386 @@
+#ifndef DVIDUTILS_PARTITION_MESH_HPP
+#define DVIDUTILS_PARTITION_MESH_HPP
+
+#include <cstdint>
+#include <cmath>
+#include <array>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+#include <boost/functional/hash.hpp>
+
+#include "parallel.hpp"
+
+using std::size_t;
+using std::int32_t;
+using std::int64_t;
+using std::uint32_t;
+
+namespace dvidutils
+{
+    // The integer coordinates of a grid cell
+    typedef std::array<int32_t, 3> cell_t;
+
+    struct cell_hasher
+    {
+        size_t operator()(cell_t const & cell) const
+        {
+            size_t hash = 0;
+            boost::hash_combine(hash, cell[0]);
+            boost::hash_combine(hash, cell[1]);
+            boost::hash_combine(hash, cell[2]);
+            return hash;
+        }
+    };
+
+    // The portion of a mesh that falls within a single grid cell,
+    // with its own (compacted) vertex list.
+    struct MeshFragment
+    {
+        cell_t cell;
+        std::vector<float> vertices;   // row-major (N,3)
+        std::vector<uint32_t> faces;   // row-major (M,3), indexes into 'vertices'
+    };
+
+    namespace detail
+    {
+        // A polygon vertex produced while clipping a triangle.
+        // 'source' is the index of the original mesh vertex,
+        // or -1 for points that were created by the clipping itself.
+        struct clip_point_t
+        {
+            std::array<float, 3> pos;
+            int64_t source;
+        };
+
+        // Intersect the segment (p, q) with the plane pos[axis] == plane.
+        // The endpoints are put in a canonical order first, so the result is bit-identical
+        // no matter which triangle (or which cell) the shared edge is being clipped for.
+        // That keeps the cut points of neighboring triangles and fragments exactly aligned.
+        clip_point_t intersect(clip_point_t const & p, clip_point_t const & q, int axis, float plane)
+        {
+            auto const & a = std::min(p.pos, q.pos);
+            auto const & b = std::max(p.pos, q.pos);
+
+            double t = (double(plane) - a[axis]) / (double(b[axis]) - a[axis]);
+            clip_point_t result;
+            for (int i = 0; i < 3; ++i)
+            {
+                result.pos[i] = static_cast<float>(a[i] + t * (double(b[i]) - a[i]));
+            }
+            result.pos[axis] = plane;
+            result.source = -1;
+            return result;
+        }
+
+        // Sutherland-Hodgman clipping of a convex polygon against a single axis-aligned plane.
+        // If keep_above is true, the half-space pos[axis] >= plane is kept, otherwise pos[axis] <= plane.
+        void clip_polygon( std::vector<clip_point_t> const & polygon,
+                           int axis, float plane, bool keep_above,
+                           std::vector<clip_point_t> & result )
+        {
+            result.clear();
+            auto inside = [&](clip_point_t const & p) {
+                return keep_above ? (p.pos[axis] >= plane) : (p.pos[axis] <= plane);
+            };
+
+            for (size_t i = 0; i < polygon.size(); ++i)
+            {
+                auto const & prev = polygon[(i + polygon.size() - 1) % polygon.size()];
+                auto const & cur = polygon[i];
+                if (inside(cur))
+                {
+                    if (!inside(prev))
+                    {
+                        result.push_back(intersect(prev, cur, axis, plane));
+                    }
+                    result.push_back(cur);
+                }
+                else if (inside(prev))
+                {
+                    result.push_back(intersect(prev, cur, axis, plane));
+                }
+            }
+
+            // Drop consecutive duplicates (e.g. a cut point that coincides with a vertex on the plane),
+            // preferring original vertices over cut points.
+            std::vector<clip_point_t> deduped;
+            for (auto const & p : result)
+            {
+                if (!deduped.empty() && deduped.back().pos == p.pos)
+                {
+                    if (deduped.back().source < 0)
+                    {
+                        deduped.back() = p;
+                    }
+                    continue;
+                }
+                deduped.push_back(p);
+            }
+            while (deduped.size() > 1 && deduped.front().pos == deduped.back().pos)
+            {
+                if (deduped.front().source < 0)
+                {
+                    deduped.front() = deduped.back();
+                }
+                deduped.pop_back();
+            }
+            result.swap(deduped);
+        }
+
+        // Returns true if the triangle has (numerically) zero area.
+        bool is_degenerate( std::array<float, 3> const & a,
+                            std::array<float, 3> const & b,
+                            std::array<float, 3> const & c )
+        {
+            std::array<double, 3> u{{ double(b[0]) - a[0], double(b[1]) - a[1], double(b[2]) - a[2] }};
+            std::array<double, 3> v{{ double(c[0]) - a[0], double(c[1]) - a[1], double(c[2]) - a[2] }};
+            double x = u[1]*v[2] - u[2]*v[1];
+            double y = u[2]*v[0] - u[0]*v[2];
+            double z = u[0]*v[1] - u[1]*v[0];
+            return (x == 0.0 && y == 0.0 && z == 0.0);
+        }
+
+        struct position_hasher
+        {
+            size_t operator()(std::array<float, 3> const & pos) const
+            {
+                size_t hash = 0;
+                boost::hash_combine(hash, pos[0]);
+                boost::hash_combine(hash, pos[1]);
+                boost::hash_combine(hash, pos[2]);
+                return hash;
+            }
+        };
+
+        // Accumulates the vertices and faces of a single fragment,
+        // assigning compact local indexes to vertices the first time they are used.
+        class FragmentBuilder
+        {
+        public:
+            FragmentBuilder(MeshFragment & fragment, float const * vertices)
+            : _fragment(fragment)
+            , _vertices(vertices)
+            {
+            }
+
+            void add_face(clip_point_t const & a, clip_point_t const & b, clip_point_t const & c)
+            {
+                _fragment.faces.push_back(local_index(a));
+                _fragment.faces.push_back(local_index(b));
+                _fragment.faces.push_back(local_index(c));
+            }
+
+            void add_face(uint32_t a, uint32_t b, uint32_t c)
+            {
+                _fragment.faces.push_back(local_index(a));
+                _fragment.faces.push_back(local_index(b));
+                _fragment.faces.push_back(local_index(c));
+            }
+
+        private:
+            uint32_t local_index(uint32_t source)
+            {
+                auto iter = _source_indexes.find(source);
+                if (iter != _source_indexes.end())
+                {
+                    return iter->second;
+                }
+                uint32_t index = push_vertex(_vertices + 3*size_t(source));
+                _source_indexes[source] = index;
+                return index;
+            }
+
+            uint32_t local_index(clip_point_t const & p)
+            {
+                if (p.source >= 0)
+                {
+                    return local_index(static_cast<uint32_t>(p.source));
+                }
+
+                auto iter = _cut_indexes.find(p.pos);
+                if (iter != _cut_indexes.end())
+                {
+                    return iter->second;
+                }
+                uint32_t index = push_vertex(p.pos.data());
+                _cut_indexes[p.pos] = index;
+                return index;
+            }
+
+            uint32_t push_vertex(float const * pos)
+            {
+                uint32_t index = _fragment.vertices.size() / 3;
+                _fragment.vertices.insert(_fragment.vertices.end(), pos, pos + 3);
+                return index;
+            }
+
+            MeshFragment & _fragment;
+            float const * _vertices;
+            std::unordered_map<uint32_t, uint32_t> _source_indexes;
+            std::unordered_map<std::array<float, 3>, uint32_t, position_hasher> _cut_indexes;
+        };
+    }
+
+    // Split a mesh into fragments along a regular 3D grid of cells,
+    // whose cell (i,j,k) spans [origin + (i,j,k) * cell_shape, origin + (i+1,j+1,k+1) * cell_shape].
+    //
+    // If split_faces is false, each face is assigned (whole) to the cell containing its centroid,
+    // so a fragment's vertices may extend slightly beyond its cell.
+    //
+    // If split_faces is true, faces that cross cell boundaries are clipped against each cell
+    // they overlap, so every fragment's vertices lie within its own cell.  Cut points are computed
+    // identically on both sides of a boundary, so neighboring fragments line up exactly.
+    //
+    // The vertices and faces are given as row-major (N,3) buffers.
+    // Only cells that contain at least one face are returned,
+    // in lexicographic (X,Y,Z) order of their cell coordinates.
+    //
+    // Cells are processed in parallel with num_threads threads (0 means "use all cores").
+    std::vector<MeshFragment> partition_mesh_buffers( float const * vertices,
+                                                      size_t vertex_count,
+                                                      uint32_t const * faces,
+                                                      size_t face_count,
+                                                      std::array<double, 3> const & cell_shape,
+                                                      std::array<double, 3> const & origin,
+                                                      bool split_faces,
+                                                      int num_threads )
+    {
+        using detail::clip_point_t;
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            if (!(cell_shape[axis] > 0.0))
+            {
+                throw std::runtime_error("cell_shape must be positive");
+            }
+        }
+
+        for (size_t i = 0; i < 3*face_count; ++i)
+        {
+            if (faces[i] >= vertex_count)
+            {
+                throw std::runtime_error("Face indexes exceed vertices length");
+            }
+        }
+
+        // Determine the (inclusive) range of cells each face will be assigned to:
+        // Either the cell containing its centroid, or every cell whose interior overlaps its bounding box.
+        std::vector<cell_t> first_cells(face_count);
+        std::vector<cell_t> last_cells(face_count);
+        parallel_for(face_count, num_threads, [&](size_t f) {
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                if (!split_faces)
+                {
+                    double centroid = ( double(vertices[3*faces[3*f + 0] + axis])
+                                      + double(vertices[3*faces[3*f + 1] + axis])
+                                      + double(vertices[3*faces[3*f + 2] + axis]) ) / 3.0;
+                    first_cells[f][axis] = static_cast<int32_t>(std::floor((centroid - origin[axis]) / cell_shape[axis]));
+                    last_cells[f][axis] = first_cells[f][axis];
+                    continue;
+                }
+
+                float lo = vertices[3*faces[3*f] + axis];
+                float hi = lo;
+                for (int corner = 1; corner < 3; ++corner)
+                {
+                    float x = vertices[3*faces[3*f + corner] + axis];
+                    lo = std::min(lo, x);
+                    hi = std::max(hi, x);
+                }
+                double first = std::floor((lo - origin[axis]) / cell_shape[axis]);
+                double last = std::ceil((hi - origin[axis]) / cell_shape[axis]) - 1;
+                first_cells[f][axis] = static_cast<int32_t>(first);
+                last_cells[f][axis] = static_cast<int32_t>(std::max(first, last));
+            }
+        });
+
+        // Group the faces by cell.
+        // A face that spans several cells is listed in each of them.
+        std::unordered_map<cell_t, size_t, cell_hasher> cell_indexes;
+        std::vector<cell_t> cells;
+        std::vector<std::vector<uint32_t>> cell_faces;
+        for (size_t f = 0; f < face_count; ++f)
+        {
+            cell_t cell;
+            for (cell[0] = first_cells[f][0]; cell[0] <= last_cells[f][0]; ++cell[0])
+            for (cell[1] = first_cells[f][1]; cell[1] <= last_cells[f][1]; ++cell[1])
+            for (cell[2] = first_cells[f][2]; cell[2] <= last_cells[f][2]; ++cell[2])
+            {
+                auto iter = cell_indexes.find(cell);
+                if (iter == cell_indexes.end())
+                {
+                    iter = cell_indexes.emplace(cell, cells.size()).first;
+                    cells.push_back(cell);
+                    cell_faces.emplace_back();
+                }
+                cell_faces[iter->second].push_back(f);
+            }
+        }
+
+        // Process cells in sorted order
+        std::vector<size_t> order(cells.size());
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return cells[a] < cells[b]; });
+
+        std::vector<MeshFragment> fragments(cells.size());
+        parallel_for(cells.size(), num_threads, [&](size_t i) {
+            size_t c = order[i];
+            MeshFragment & fragment = fragments[i];
+            fragment.cell = cells[c];
+            detail::FragmentBuilder builder(fragment, vertices);
+
+            std::vector<clip_point_t> polygon;
+            std::vector<clip_point_t> clipped;
+
+            for (uint32_t f : cell_faces[c])
+            {
+                uint32_t const * face = faces + 3*size_t(f);
+                if (first_cells[f] == last_cells[f])
+                {
+                    // Fast path: The face is assigned to this cell alone (no clipping needed).
+                    builder.add_face(face[0], face[1], face[2]);
+                    continue;
+                }
+
+                polygon.clear();
+                for (int corner = 0; corner < 3; ++corner)
+                {
+                    float const * v = vertices + 3*size_t(face[corner]);
+                    polygon.push_back(clip_point_t{ {{ v[0], v[1], v[2] }}, face[corner] });
+                }
+
+                for (int axis = 0; axis < 3 && polygon.size() >= 3; ++axis)
+                {
+                    float lower = static_cast<float>(origin[axis] + fragment.cell[axis] * cell_shape[axis]);
+                    float upper = static_cast<float>(origin[axis] + (fragment.cell[axis] + 1) * cell_shape[axis]);
+
+                    detail::clip_polygon(polygon, axis, lower, true, clipped);
+                    detail::clip_polygon(clipped, axis, upper, false, polygon);
+                }
+
+                // Triangulate the (convex) clipped polygon as a fan
+                for (size_t k = 1; k + 1 < polygon.size(); ++k)
+                {
+                    if (!detail::is_degenerate(polygon[0].pos, polygon[k].pos, polygon[k+1].pos))
+                    {
+                        builder.add_face(polygon[0], polygon[k], polygon[k+1]);
+                    }
+                }
+            }
+        });
+
+        // Clipping may leave some cells empty (e.g. if a face only touched a corner).
+        fragments.erase( std::remove_if( fragments.begin(), fragments.end(),
+                                         [](MeshFragment const & fragment) { return fragment.faces.empty(); } ),
+                         fragments.end() );
+        return fragments;
+    }
+}
+
+#endif
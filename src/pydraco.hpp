@@ -5,16 +5,28 @@
 #include <tuple>
 #include <algorithm>
 #include <iostream>
+#include <sstream>
+#include <vector>
+#include <memory>
+#include <limits>
+#include <cstring>
+#include <string>
 
 #include "draco/mesh/mesh.h"
+#include "draco/point_cloud/point_cloud.h"
+#include "draco/metadata/geometry_metadata.h"
 #include "draco/compression/encode.h"
 #include "draco/compression/decode.h"
 
 #include "pybind11/pybind11.h"
+#include "pybind11/numpy.h"
 
 #include "xtensor/xmath.hpp"
 #include "xtensor-python/pytensor.hpp"
 
+#include "parallel.hpp"
+#include "normals.hpp"
+
 using std::uint32_t;
 using std::size_t;
 
@@ -41,31 +53,70 @@ struct Quantizer {
   //     while a value of `2**num_quantization_bits-1` corresponds to
   //     `fragment_origin[i]+fragment_shape[i]`.  Should be less than or equal
   //     to the number of bits in `VertexCoord`.
-  Quantizer(coords_t const & fragment_shape, coords_t const & fragment_origin, int num_quantization_bits) {
-      //assumes has been scaled between 0 and 1
+  Quantizer(coords_t const & fragment_shape, coords_t const & fragment_origin, int num_quantization_bits)
+  : Quantizer( std::array<double, 3>{{ double(fragment_shape[0]), double(fragment_shape[1]), double(fragment_shape[2]) }},
+               std::array<double, 3>{{ double(fragment_origin[0]), double(fragment_origin[1]), double(fragment_origin[2]) }},
+               num_quantization_bits ) {
+  }
+
+  // Same as above, but for non-integer fragment bounds
+  // (e.g. multi-resolution fragments, whose shape is chunk_shape * 2**lod).
+  Quantizer(std::array<double, 3> const & fragment_shape, std::array<double, 3> const & fragment_origin, int num_quantization_bits) {
         for (int i = 0; i < 3; ++i) {
             upper_bound[i] =
                 static_cast<double>(std::numeric_limits<uint32_t>::max() >>
                                     (sizeof(uint32_t) * 8 - num_quantization_bits));
-            fragment_shape_double[i] = static_cast<double>(fragment_shape[i]);
-            //scale[i] = upper_bound[i] / static_cast<float>(fragment_shape[i]);
-            offset[i] = fragment_origin[i] ;//mesh_origin[i] - fragment_origin[i] + 0.5 / scale[i];
+            fragment_shape_double[i] = fragment_shape[i];
+            offset[i] = fragment_origin[i];
         }
   }
 
   // Maps an input vertex position `v_pos`.
-  std::array<uint32_t, 3> operator()(std::array<float, 3>& v_pos) {
+  std::array<uint32_t, 3> operator()(std::array<float, 3> const & v_pos) const {
+    std::array<uint32_t, 3> output;
     for (int i = 0; i < 3; ++i) {
-      output[i] = static_cast<uint32_t>(std::min(
-          //might need to further fix this due to rounding artifacts which set eg a value to 511 when it should be 512. that is why i moved scale out here
-          upper_bound[i], std::max(0.0, (v_pos[i] - offset[i]) * upper_bound[i] / fragment_shape_double[i] + 0.5))); // Add 0.5 to round to nearest rather than round down.
+      output[i] = quantize_coord(v_pos[i], i);
     }
     return output;
   }
 
-  std::array<uint32_t, 3> output;
+  // Maps a whole row-major (N,3) array of vertex positions at once.
+  // Uses exactly the same arithmetic as operator(), but in a flat loop
+  // without function calls or temporaries, which the compiler can vectorize.
+  void quantize(float const * vertices, size_t vertex_count, uint32_t * output) const {
+    for (size_t vi = 0; vi < vertex_count; ++vi) {
+      for (int i = 0; i < 3; ++i) {
+        output[3*vi + i] = quantize_coord(vertices[3*vi + i], i);
+      }
+    }
+  }
+
+  // The inverse of quantize(): maps quantized (N,3) values back to vertex positions
+  // (to within the rounding of the quantization step).
+  void dequantize(uint32_t const * quantized, size_t vertex_count, float * output) const {
+    for (size_t vi = 0; vi < vertex_count; ++vi) {
+      for (int i = 0; i < 3; ++i) {
+        output[3*vi + i] = dequantize_coord(quantized[3*vi + i], i);
+      }
+    }
+  }
+
+  float dequantize_coord(uint32_t q, int i) const {
+    return static_cast<float>(offset[i] + q * fragment_shape_double[i] / upper_bound[i]);
+  }
+
+  // Quantize a single coordinate along axis `i`.
+  // (The ternaries are equivalent to std::min/std::max, including for NaN, which maps to 0.)
+  uint32_t quantize_coord(float v, int i) const {
+    // The scale is applied after the subtraction (rather than precomputed) to avoid rounding artifacts,
+    // e.g. a value quantizing to 511 when it should be 512.
+    double q = (v - offset[i]) * upper_bound[i] / fragment_shape_double[i] + 0.5; // Add 0.5 to round to nearest rather than round down.
+    q = (0.0 < q) ? q : 0.0;
+    q = (q < upper_bound[i]) ? q : upper_bound[i];
+    return static_cast<uint32_t>(q);
+  }
+
   std::array<double, 3> offset;
-  std::array<double, 3> scale;
   std::array<double, 3> upper_bound;
   std::array<double, 3> fragment_shape_double; 
 };
@@ -74,331 +125,1616 @@ struct Quantizer {
 int DEFAULT_COMPRESSION_LEVEL = 7;
 int DEFAULT_POSITION_QUANTIZATION_BITS = 14;
 int DEFAULT_NORMAL_QUANTIZATION_BITS = 10;
-int DEFAULT_GENERIC_QUANTIZATION_BITS = 8;
-bool DEFAULT_DO_CUSTOM = true;
 
+// ...except for GENERIC attributes, which hold user data (e.g. scalar fields),
+// so they aren't quantized unless the caller asks for it.
+int DEFAULT_GENERIC_QUANTIZATION_BITS = 0;
 
-// Encode the given vertices and faces arrays from python
-// into a buffer (bytes object) encoded via draco.
-//
-// Special case: If faces is empty, an empty buffer is returned.
-//
-// Note: The vertices are expected to be passed in X,Y,Z order
+bool DEFAULT_DO_CUSTOM = true;
+bool DEFAULT_COMPUTE_NORMALS = false;
 
-py::bytes encode_faces_to_custom_drc_bytes( vertices_array_t const & vertices,
-                                     normals_array_t const & normals,
-                                     faces_array_t const & faces,
-                                     coords_t const & fragment_shape,
-                                     coords_t const & fragment_origin,
-                                     int compression_level,
-                                     int position_quantization_bits,
-                                     int normal_quantization_bits,
-                                     int generic_quantization_bits,
-                                     bool do_custom)
+// Number of threads used by the batch functions (0 means "use all cores").
+int DEFAULT_NUM_THREADS = 0;
+
+// The draco::Encoder options we expose, bundled together so the
+// single-mesh and batch encoding functions can share them.
+struct DracoEncoderSettings
 {
-    using namespace draco;
-    DataType data_type = do_custom ? DT_UINT32 : DT_FLOAT32;
+    int compression_level = DEFAULT_COMPRESSION_LEVEL;
+    int position_quantization_bits = DEFAULT_POSITION_QUANTIZATION_BITS;
+    int normal_quantization_bits = DEFAULT_NORMAL_QUANTIZATION_BITS;
+    int generic_quantization_bits = DEFAULT_GENERIC_QUANTIZATION_BITS;
 
-    auto vertex_count = vertices.shape()[0];
-    auto normal_count = do_custom ? 0 :normals.shape()[0]; //FOR CUSTOM IGNORE NORMALS, SCREWS UP DECODING
-    auto face_count = faces.shape()[0];
+    // If no normals are given, compute (area-weighted) vertex normals before encoding.
+    // (Ignored for the 'custom' format, which never stores normals.)
+    bool compute_normals = DEFAULT_COMPUTE_NORMALS;
+};
 
-    Quantizer quantizer(fragment_shape, fragment_origin, position_quantization_bits);
 
+// Returns true if the rows of a 2D array are stored as a flat row-major buffer.
+template <typename array_t>
+bool is_packed_rows( array_t const & a )
+{
+    size_t rows = a.shape()[0];
+    size_t cols = a.shape()[1];
+    return ( (rows <= 1 || a.strides()[0] == static_cast<std::ptrdiff_t>(cols))
+             && (cols <= 1 || a.strides()[1] == 1) );
+}
 
-    // Special case:
-    // If faces is empty, an empty buffer is returned.
-    if (face_count == 0)
+// Returns a pointer to the data of a 2D array as a flat row-major buffer.
+// If the array isn't C-contiguous (e.g. a reversed or strided view),
+// a packed copy is made in 'scratch' and a pointer to that is returned instead.
+template <typename array_t>
+typename array_t::value_type const * packed_rows( array_t const & a,
+                                                  std::vector<typename array_t::value_type> & scratch )
+{
+    if (is_packed_rows(a))
     {
-        return py::bytes();
+        return a.data() + a.data_offset();
     }
-    
-    int max_vertex = xt::amax(faces)();
-    if (vertex_count < max_vertex+1)
+
+    size_t rows = a.shape()[0];
+    size_t cols = a.shape()[1];
+
+    scratch.resize(rows * cols);
+    for (size_t r = 0; r < rows; ++r)
     {
-        throw std::runtime_error("Face indexes exceed vertices length");
+        for (size_t c = 0; c < cols; ++c)
+        {
+            scratch[r*cols + c] = a(r, c);
+        }
     }
-    
-    if (normal_count > 0 and normal_count != vertex_count)
+    return scratch.data();
+}
+
+// Raise an error unless the given 2D array has exactly 'cols' columns.
+// packed_rows() and its callers trust the column count, so e.g. an (N,2) vertices
+// array must be rejected up front rather than read as if it were (N,3).
+// An empty array (with no rows) is accepted regardless of its column count.
+template <typename array_t>
+void check_rows( array_t const & a, size_t cols, char const * name )
+{
+    if (a.shape()[0] > 0 && a.shape()[1] != cols)
     {
-        throw std::runtime_error("normals array size does not correspond to vertices array size");
+        std::ostringstream ss;
+        ss << name << " must have " << cols << " columns, not " << a.shape()[1];
+        throw std::runtime_error(ss.str());
     }
+}
 
-    draco::EncoderBuffer buf; // result
+// Add an identity-mapped attribute to a point cloud (or mesh)
+// and fill it from the given row-major buffer with a single bulk write.
+//
+// Returns the new attribute's id.
+int add_point_attribute( draco::PointCloud & geometry,
+                         draco::GeometryAttribute::Type attribute_type,
+                         draco::DataType data_type,
+                         int num_components,
+                         void const * values,
+                         size_t value_count )
+{
+    using namespace draco;
+    int64_t const row_bytes = DataTypeLength(data_type) * num_components;
 
-    // Release the GIL in the following scope.
-    // (No python functions or data structures are touched in this scope)
+    // Init attribute
+    PointAttribute att_template;
+    att_template.Init( attribute_type,                 // attribute_type
+                       nullptr,                        // buffer
+                       num_components,                 // num_components
+                       data_type,                      // data_type
+                       false,                          // normalized
+                       row_bytes,                      // byte_stride
+                       0 );                            // byte_offset
+    att_template.SetIdentityMapping();
+
+    // Add attribute to the geometry (makes a copy internally)
+    int att_id = geometry.AddAttribute(att_template, true, value_count);
+
+    // Load all values at once into the geometry's copy of the attribute
+    // (it's already been allocated with the right size).
+    geometry.attribute(att_id)->buffer()->Write(0, values, value_count * row_bytes);
+    return att_id;
+}
+
+// Add an identity-mapped, 3-component attribute to the mesh
+// and fill it from the given row-major buffer with a single bulk write.
+//
+// Returns a reference to the mesh's copy of the attribute.
+draco::PointAttribute & add_mesh_attribute( draco::Mesh & mesh,
+                                            draco::GeometryAttribute::Type attribute_type,
+                                            draco::DataType data_type,
+                                            void const * values,
+                                            size_t value_count )
+{
+    int att_id = add_point_attribute(mesh, attribute_type, data_type, 3, values, value_count);
+    mesh.SetAttributeElementType(att_id, draco::MESH_VERTEX_ATTRIBUTE);
+    return *(mesh.attribute(att_id));
+}
+
+// The numpy dtypes that can be stored in a GENERIC attribute, and how.
+//
+// 32-bit and 64-bit integers are stored as two or four uint16 components per value:
+// draco's integer encoders work with int32 values, and fail on attributes
+// whose values span more than 2**31, so the values are split into
+// pieces small enough to always be encoded losslessly.
+//
+// The plain DT_INT32/DT_UINT32 entries are never chosen for encoding (the split
+// entries come first), but let us decode buffers that store 32-bit values directly
+// (e.g. from other encoders).
+struct GenericDtype
+{
+    char const * dtype;
+    draco::DataType data_type;
+    int components_per_value;
+};
+
+GenericDtype const GENERIC_DTYPES[] = {
+    { "float32", draco::DT_FLOAT32, 1 },
+    { "int8",    draco::DT_INT8,    1 },
+    { "uint8",   draco::DT_UINT8,   1 },
+    { "int16",   draco::DT_INT16,   1 },
+    { "uint16",  draco::DT_UINT16,  1 },
+    { "int32",   draco::DT_UINT16,  2 },
+    { "uint32",  draco::DT_UINT16,  2 },
+    { "bool",    draco::DT_UINT8,   1 },
+    { "int64",   draco::DT_UINT16,  4 },
+    { "uint64",  draco::DT_UINT16,  4 },
+    { "int32",   draco::DT_INT32,   1 },
+    { "uint32",  draco::DT_UINT32,  1 },
+};
+
+// A named per-point array, stored as a GENERIC draco attribute.
+// The name and numpy dtype are stored in the attribute's metadata.
+struct GenericAttribute
+{
+    std::string name;
+    GenericDtype dtype = GENERIC_DTYPES[0];
+    size_t columns = 1;             // values per point (1-D arrays have 1 column)
+    int att_id = -1;                // the draco attribute (decoding only)
+    char const * data = nullptr;    // packed row-major values (encoding only)
+
+    int num_components() const { return int(columns) * dtype.components_per_value; }
+    size_t row_bytes() const { return num_components() * draco::DataTypeLength(dtype.data_type); }
+};
+
+// Describe the arrays in a python dict of {name: array} as GenericAttributes.
+// Each array must have point_count rows, and is converted to a C-contiguous
+// array (if it isn't one already), which is kept alive in 'arrays'.
+// (Requires the GIL.)
+std::vector<GenericAttribute> generic_attributes_from_dict( py::dict const & attributes,
+                                                            size_t point_count,
+                                                            std::vector<py::array> & arrays )
+{
+    std::vector<GenericAttribute> results;
+    for (auto item : attributes)
     {
-        py::gil_scoped_release nogil;
+        GenericAttribute attribute;
+        attribute.name = py::str(item.first);
 
-        Mesh mesh;
-        mesh.set_num_points(vertex_count);
-        mesh.SetNumFaces(face_count);
-        
-        // Init vertex attribute
-        PointAttribute vert_att_template;
-        vert_att_template.Init( GeometryAttribute::POSITION,    // attribute_type
-                                nullptr,                        // buffer
-                                3,                              // num_components
-                                data_type,                     // data_type
-                                false,                          // normalized
-                                DataTypeLength(data_type) * 3, // byte_stride
-                                0 );                            // byte_offset
-        
-        vert_att_template.SetIdentityMapping();
-
-        // Add vertex attribute to mesh (makes a copy internally)
-        int vert_att_id = mesh.AddAttribute(vert_att_template, true, vertex_count);
-        mesh.SetAttributeElementType(vert_att_id, MESH_VERTEX_ATTRIBUTE);
-
-        // Get a reference to the mesh's copy of the vertex attribute
-        PointAttribute & vert_att = *(mesh.attribute(vert_att_id));
-
-        // Load the vertices into the vertex attribute
-        for (size_t vi = 0; vi < vertex_count; ++vi)
+        py::array a = py::array::ensure(item.second, py::array::c_style);
+        if (!a)
         {
-            std::array<float, 3> v{{ vertices(vi, 0), vertices(vi, 1), vertices(vi, 2) }};
-            if(do_custom){
-                std::array<uint32_t,3> quantized_v = quantizer(v);
-                vert_att.SetAttributeValue(AttributeValueIndex(vi), quantized_v.data());
-            }
-            else{
-                vert_att.SetAttributeValue(AttributeValueIndex(vi), v.data());
-            }
+            throw std::runtime_error("Attribute '" + attribute.name + "' is not an array");
         }
-        
-        if (normal_count > 0)
-        {
-            // Init normal attribute
-            PointAttribute norm_att_template;
-            norm_att_template.Init( GeometryAttribute::NORMAL,      // attribute_type
-                                    nullptr,                        // buffer
-                                    3,                              // num_components
-                                    DT_FLOAT32,                     // data_type
-                                    false,                          // normalized
-                                    DataTypeLength(DT_FLOAT32) * 3, // byte_stride
-                                    0 );                            // byte_offset
-            norm_att_template.SetIdentityMapping();
-
-            // Add normal attribute to mesh (makes a copy internally)
-            int norm_att_id = mesh.AddAttribute(norm_att_template, true, normal_count);
-            mesh.SetAttributeElementType(norm_att_id, MESH_VERTEX_ATTRIBUTE);
-
-            // Get a reference to the mesh's copy of the normal attribute
-            PointAttribute & norm_att = *(mesh.attribute(norm_att_id));
-
-            // Load the normals into the normal attribute
-            for (size_t ni = 0; ni < normal_count; ++ni)
-            {
-                std::array<float, 3> n{{ normals(ni, 0), normals(ni, 1), normals(ni, 2) }};
-                norm_att.SetAttributeValue(AttributeValueIndex(ni), n.data());
-            }
+
+        std::string dtype = py::str(a.dtype());
+        auto dtype_end = std::end(GENERIC_DTYPES);
+        auto dtype_it = std::find_if( std::begin(GENERIC_DTYPES), dtype_end,
+                                      [&](GenericDtype const & d) { return dtype == d.dtype; } );
+        if (dtype_it == dtype_end)
+        {
+            throw std::runtime_error("Attribute '" + attribute.name + "' has unsupported dtype " + dtype
+                                     + " (use float32 or a native-endian integer or bool type)");
+        }
+        attribute.dtype = *dtype_it;
+
+        if (a.ndim() < 1 || a.ndim() > 2 || size_t(a.shape(0)) != point_count)
+        {
+            std::ostringstream ss;
+            ss << "Attribute '" << attribute.name << "' must be a 1-D or 2-D array with " << point_count << " rows";
+            throw std::runtime_error(ss.str());
+        }
+        attribute.columns = (a.ndim() == 2) ? a.shape(1) : 1;
+        if (attribute.columns < 1 || attribute.num_components() > 127)
+        {
+            throw std::runtime_error("Attribute '" + attribute.name + "' has too many (or too few) columns");
+        }
+
+        attribute.data = static_cast<char const *>(a.data());
+        arrays.push_back(std::move(a));
+        results.push_back(std::move(attribute));
+    }
+    return results;
+}
+
+// Add the given attributes to a point cloud (or mesh) as GENERIC attributes,
+// with their names and dtypes in the attribute metadata.
+// Returns the new attribute ids.
+std::vector<int> add_generic_attributes( draco::PointCloud & geometry,
+                                         std::vector<GenericAttribute> const & attributes,
+                                         size_t point_count )
+{
+    using namespace draco;
+    std::vector<int> att_ids;
+    for (auto const & attribute : attributes)
+    {
+        int att_id = add_point_attribute( geometry, GeometryAttribute::GENERIC,
+                                          attribute.dtype.data_type, attribute.num_components(),
+                                          attribute.data, point_count );
+
+        std::unique_ptr<AttributeMetadata> metadata(new AttributeMetadata());
+        metadata->AddEntryString("name", attribute.name);
+        metadata->AddEntryString("dtype", attribute.dtype.dtype);
+        geometry.AddAttributeMetadata(att_id, std::move(metadata));
+        att_ids.push_back(att_id);
+    }
+    return att_ids;
+}
+
+// Describe the GENERIC attributes of a decoded point cloud (or mesh).
+//
+// Attributes without our metadata (e.g. from other encoders) are named 'generic_<i>'
+// (where i counts the GENERIC attributes), and their dtype is inferred from the draco type.
+std::vector<GenericAttribute> read_generic_attributes( draco::PointCloud const & geometry )
+{
+    using namespace draco;
+    std::vector<GenericAttribute> results;
+    int generic_count = geometry.NumNamedAttributes(GeometryAttribute::GENERIC);
+    for (int i = 0; i < generic_count; ++i)
+    {
+        PointAttribute const * att = geometry.GetNamedAttribute(GeometryAttribute::GENERIC, i);
+
+        GenericAttribute attribute;
+        attribute.att_id = geometry.GetNamedAttributeId(GeometryAttribute::GENERIC, i);
+        attribute.name = "generic_" + std::to_string(i);
+
+        std::string dtype;
+        AttributeMetadata const * metadata = geometry.GetAttributeMetadataByAttributeId(attribute.att_id);
+        if (metadata != nullptr)
+        {
+            metadata->GetEntryString("name", &attribute.name);
+            metadata->GetEntryString("dtype", &dtype);
+        }
+
+        auto dtype_end = std::end(GENERIC_DTYPES);
+        auto dtype_it = std::find_if( std::begin(GENERIC_DTYPES), dtype_end, [&](GenericDtype const & d) {
+            return (dtype.empty() && d.data_type == att->data_type() && d.components_per_value == 1)
+                || (d.dtype == dtype && d.data_type == att->data_type());
+        });
+        if (dtype_it == dtype_end || att->num_components() % dtype_it->components_per_value != 0)
+        {
+            throw std::runtime_error("Attribute '" + attribute.name + "' has an unsupported data type");
         }
-        
-        // Load the faces
-        for (size_t f = 0; f < face_count; ++f)
+        attribute.dtype = *dtype_it;
+        attribute.columns = att->num_components() / dtype_it->components_per_value;
+        results.push_back(std::move(attribute));
+    }
+    return results;
+}
+
+// Copy a GENERIC attribute into a row-major buffer, with one row per POINT.
+// Packed, identity-mapped attributes are copied with a single memcpy.
+void extract_generic_attribute( draco::PointCloud const & geometry,
+                                GenericAttribute const & attribute,
+                                char * out )
+{
+    using namespace draco;
+    PointAttribute const & att = *geometry.attribute(attribute.att_id);
+    size_t point_count = geometry.num_points();
+    size_t row_bytes = attribute.row_bytes();
+
+    if (att.is_mapping_identity() && att.byte_stride() == int64_t(row_bytes)
+        && att.byte_offset() == 0 && att.size() >= point_count)
+    {
+        if (point_count > 0)
         {
-            Mesh::Face face = {{ PointIndex(faces(f, 0)),
-                                 PointIndex(faces(f, 1)),
-                                 PointIndex(faces(f, 2)) }};
+            std::memcpy(out, att.GetAddress(AttributeValueIndex(0)), point_count * row_bytes);
+        }
+        return;
+    }
+
+    for (PointIndex i(0); i < point_count; ++i)
+    {
+        std::memcpy(out + i.value() * row_bytes, att.GetAddress(att.mapped_index(i)), row_bytes);
+    }
+}
+
+// The output arrays for the GENERIC attributes of decoded geometry:
+// (point_count,) for single-column attributes, otherwise (point_count, columns).
+struct GenericAttributeArrays
+{
+    std::vector<GenericAttribute> attributes;
+    std::vector<py::array> arrays;
+    std::vector<char *> data;
 
-            for (auto vi : face)
+    // Allocate arrays with point_count rows for the given attributes.
+    // (Requires the GIL.)
+    void allocate( std::vector<GenericAttribute> const & layout, size_t point_count )
+    {
+        attributes = layout;
+        for (auto const & attribute : attributes)
+        {
+            std::vector<size_t> shape{ point_count };
+            if (attribute.columns > 1)
             {
-                assert(vi < vertex_count && "face has an out-of-bounds vertex");
+                shape.push_back(attribute.columns);
             }
+            py::array a(py::dtype(attribute.dtype.dtype), shape);
+            data.push_back(static_cast<char *>(a.mutable_data()));
+            arrays.push_back(std::move(a));
+        }
+    }
 
-            mesh.SetFace(draco::FaceIndex(f), face);
+    // Copy the attributes of the given geometry into the arrays, starting at row_offset.
+    // The geometry's GENERIC attributes must have the same layout that was allocated.
+    void extract( draco::PointCloud const & geometry, size_t row_offset = 0 ) const
+    {
+        if (attributes.empty())
+        {
+            return;
+        }
+        auto layout = read_generic_attributes(geometry);
+        for (size_t i = 0; i < attributes.size(); ++i)
+        {
+            extract_generic_attribute(geometry, layout[i], data[i] + row_offset * attributes[i].row_bytes());
         }
-        
-        mesh.DeduplicateAttributeValues();
-        mesh.DeduplicatePointIds();
+    }
 
-        draco::Encoder encoder;
+    // Returns the arrays as a dict of {name: array}.  (Requires the GIL.)
+    py::dict to_dict()
+    {
+        py::dict result;
+        for (size_t i = 0; i < attributes.size(); ++i)
+        {
+            result[py::str(attributes[i].name)] = std::move(arrays[i]);
+        }
+        return result;
+    }
+};
 
-        int speed = 10 - compression_level;
-        encoder.SetSpeedOptions(speed, speed);
-        encoder.SetAttributeQuantization(draco::GeometryAttribute::POSITION, position_quantization_bits);
-        if(!do_custom) encoder.SetAttributeQuantization(draco::GeometryAttribute::NORMAL,   normal_quantization_bits);
-        encoder.SetAttributeQuantization(draco::GeometryAttribute::GENERIC,  generic_quantization_bits);
+// Returns true if two attribute layouts (from read_generic_attributes()) have
+// the same names, dtypes, and columns, in the same order.
+bool same_generic_layout( std::vector<GenericAttribute> const & a, std::vector<GenericAttribute> const & b )
+{
+    return a.size() == b.size()
+        && std::equal(a.begin(), a.end(), b.begin(), [](GenericAttribute const & x, GenericAttribute const & y) {
+               return x.name == y.name
+                   && std::string(x.dtype.dtype) == y.dtype.dtype
+                   && x.columns == y.columns;
+           });
+}
 
-        encoder.EncodeMeshToBuffer(mesh, &buf);
+// Load a row-major (N,3) buffer of face indexes into the mesh.
+// The caller is responsible for checking that the indexes are in bounds.
+void set_mesh_faces( draco::Mesh & mesh, uint32_t const * faces, size_t face_count )
+{
+    using namespace draco;
+    mesh.SetNumFaces(face_count);
+    for (size_t f = 0; f < face_count; ++f)
+    {
+        Mesh::Face face = {{ PointIndex(faces[3*f + 0]),
+                             PointIndex(faces[3*f + 1]),
+                             PointIndex(faces[3*f + 2]) }};
+        mesh.SetFace(FaceIndex(f), face);
     }
-    
-    // Safe to use python again now that the GIL is re-acquired.
-    return py::bytes(buf.data(), buf.size());
 }
-py::bytes encode_faces_to_drc_bytes( vertices_array_t const & vertices,
-                                     normals_array_t const & normals,
-                                     faces_array_t const & faces,
-                                     int compression_level,
-                                     int position_quantization_bits,
-                                     int normal_quantization_bits,
-                                     int generic_quantization_bits)
-{
-    coords_t fragment_shape = xt::zeros<int>({3});
-    coords_t fragment_origin = xt::zeros<int>({3});
 
-    bool do_custom = false;
-    return encode_faces_to_custom_drc_bytes(vertices, normals, faces, fragment_shape, fragment_origin, compression_level, position_quantization_bits, normal_quantization_bits, generic_quantization_bits, do_custom);
+// Apply the speed and quantization settings to an encoder.
+// For the 'custom' format (do_custom), no normal quantization is set,
+// since normals are never stored in that format.
+void configure_encoder( draco::Encoder & encoder, DracoEncoderSettings const & settings, bool do_custom )
+{
+    int speed = 10 - settings.compression_level;
+    encoder.SetSpeedOptions(speed, speed);
+    encoder.SetAttributeQuantization(draco::GeometryAttribute::POSITION, settings.position_quantization_bits);
+    if(!do_custom) encoder.SetAttributeQuantization(draco::GeometryAttribute::NORMAL,   settings.normal_quantization_bits);
+    encoder.SetAttributeQuantization(draco::GeometryAttribute::GENERIC,  settings.generic_quantization_bits);
 }
 
-// Decode a draco-encoded buffer (given as a python bytes object)
-// into a xtensor-python arrays for the vertices and faces
-// (which are converted to numpy arrays on the python side).
+// Temporary storage used by encode_mesh_to_buffer() for packed copies of
+// non-contiguous input arrays, computed normals, and quantized positions.
+// Callers that encode many meshes may keep one of these around to avoid
+// reallocating the storage for every mesh.
+struct DracoEncoderScratch
+{
+    std::vector<float> vertices;
+    std::vector<float> normals;
+    std::vector<uint32_t> faces;
+    std::vector<uint32_t> quantized;
+};
+
+// Build a draco::Mesh from packed row-major (N,3) buffers and encode it into 'buf'.
 //
-// Special case: If drc_bytes is empty, return empty vertices and faces.
+// The positions may be DT_FLOAT32 (ordinary meshes) or DT_UINT32 (the 'custom'
+// format, in which positions are already quantized to the fragment lattice).
+// Normals are optional (normal_count may be 0).
 //
-// Note: The vertexes are returned in X,Y,Z order.
-std::tuple<vertices_array_t, normals_array_t, faces_array_t> decode_drc_bytes_to_faces( py::bytes const & drc_bytes )
+// If 'encoder' is given, it must already have been set up via configure_encoder()
+// (with the same settings and do_custom flag), and it is used as-is.
+// Otherwise, a new encoder is configured just for this call.
+//
+// If 'attributes' is given, each one (with one row per vertex)
+// is stored as a GENERIC per-vertex attribute (see add_generic_attributes()).
+//
+// Special case: If face_count is 0, 'buf' is left empty.
+void encode_packed_mesh_to_buffer( draco::DataType position_type,
+                                   void const * positions,
+                                   size_t vertex_count,
+                                   float const * normals,
+                                   size_t normal_count,
+                                   uint32_t const * faces,
+                                   size_t face_count,
+                                   DracoEncoderSettings const & settings,
+                                   draco::EncoderBuffer & buf,
+                                   draco::Encoder * encoder = nullptr,
+                                   std::vector<GenericAttribute> const * attributes = nullptr )
 {
     using namespace draco;
-    
+    bool do_custom = (position_type != DT_FLOAT32);
+
     // Special case:
-    // If drc_bytes is empty, return empty vertices and faces.
-    if (py::len(drc_bytes) == 0)
+    // If faces is empty, an empty buffer is returned.
+    if (face_count == 0)
     {
-        vertices_array_t::shape_type verts_shape = {{0, 3}};
-        vertices_array_t vertices(verts_shape);
-
-        normals_array_t::shape_type normals_shape = {{0, 3}};
-        normals_array_t normals(normals_shape);
-        
-        faces_array_t::shape_type faces_shape = {{0, 3}};
-        faces_array_t faces(faces_shape);
-
-        return std::make_tuple( std::move(vertices), std::move(normals), std::move(faces) );
+        return;
     }
 
-    // Extract pointer to raw bytes (avoid copy)
-    PyObject * pyObj = drc_bytes.ptr();
-    char * raw_buf = nullptr;
-    Py_ssize_t bytes_length = 0;
-    PyBytes_AsStringAndSize(pyObj, &raw_buf, &bytes_length);
-
-    DecoderBuffer buf;
-    int point_count;
-    typedef std::unique_ptr<Mesh> MeshPtr;
-    MeshPtr pMesh;
+    uint32_t max_vertex = *std::max_element(faces, faces + 3*face_count);
+    if (vertex_count < size_t(max_vertex)+1)
+    {
+        throw std::runtime_error("Face indexes exceed vertices length");
+    }
     
+    if (normal_count > 0 and normal_count != vertex_count)
     {
-        // Release GIL while decoding the mesh in C++
-        py::gil_scoped_release nogil;
-
-        buf.Init( raw_buf, bytes_length );
+        throw std::runtime_error("normals array size does not correspond to vertices array size");
+    }
 
-        // Decode to Mesh
-        Decoder decoder;
+    Mesh mesh;
+    mesh.set_num_points(vertex_count);
 
-        auto geometry_type = decoder.GetEncodedGeometryType(&buf).value();
-        if (geometry_type != TRIANGULAR_MESH)
+    // Load the vertices (and normals, if any) into their attributes
+    add_mesh_attribute(mesh, GeometryAttribute::POSITION, position_type, positions, vertex_count);
+    if (normal_count > 0)
+    {
+        add_mesh_attribute(mesh, GeometryAttribute::NORMAL, DT_FLOAT32, normals, normal_count);
+    }
+    if (attributes != nullptr)
+    {
+        for (int att_id : add_generic_attributes(mesh, *attributes, vertex_count))
         {
-            throw std::runtime_error("Buffer does not appear to be a mesh file. (Is it a pointcloud?)");
+            mesh.SetAttributeElementType(att_id, MESH_VERTEX_ATTRIBUTE);
         }
-
-        // Wrap bytes in a DecoderBuffer
-        StatusOr<MeshPtr> decoded = decoder.DecodeMeshFromBuffer(&buf);
-        if (!decoded.status().ok())
-        {
-            std::ostringstream ss;
-            ss << "draco::Decoder::DecodeMeshFromBuffer() returned bad status: " << decoded.status();
-            throw std::runtime_error(ss.str().c_str());
-        }
-        
-        // This use of std::move feels like an ugly hack to workaround the fact
-        // that StatusOr does not declare the following member:
-        //   T & value() & { return value_; }
-        // ... it declares a const version of it, which doesn't help us...
-        pMesh = std::move(decoded).value();
-        
-        // Strangely, encoding a mesh may cause it to have duplicate point ids,
-        // so we should de-duplicate them after decoding.
-        pMesh->DeduplicateAttributeValues();
-        pMesh->DeduplicatePointIds();
-    
-        point_count = pMesh->num_points();
     }
     
-    // Initialize Python arrays (with GIL re-aqcuired)
-    
-    // Vertices
-    vertices_array_t::shape_type verts_shape = {{point_count, 3}};
-    vertices_array_t vertices(verts_shape);
+    // Load the faces
+    set_mesh_faces(mesh, faces, face_count);
     
-    // Normals
-    const PointAttribute *const normal_att = pMesh->GetNamedAttribute(GeometryAttribute::NORMAL);
-    normals_array_t::shape_type::value_type normal_count = 0;
-    if (normal_att != nullptr)
+    mesh.DeduplicateAttributeValues();
+    mesh.DeduplicatePointIds();
+
+    draco::Encoder local_encoder;
+    if (encoder == nullptr)
     {
-        // See Note below about why we don't use normal_att->size()
-        normal_count = point_count;
+        configure_encoder(local_encoder, settings, do_custom);
+        encoder = &local_encoder;
     }
-    
-    normals_array_t::shape_type normals_shape = {{normal_count, 3}};
-    normals_array_t normals(normals_shape);
-    
-    // Faces
-    faces_array_t::shape_type faces_shape = {{pMesh->num_faces(), 3}};
-    faces_array_t faces(faces_shape);
 
+    auto status = encoder->EncodeMeshToBuffer(mesh, &buf);
+    if (!status.ok())
     {
-        // Release GIL again while copying from pMesh into the arrays
-        py::gil_scoped_release nogil;
+        std::ostringstream ss;
+        ss << "draco::Encoder::EncodeMeshToBuffer() returned bad status: " << status;
+        throw std::runtime_error(ss.str());
+    }
+}
 
-        // Extract vertices
-        const PointAttribute *const vertex_att = pMesh->GetNamedAttribute(GeometryAttribute::POSITION);
-        if (vertex_att == nullptr)
-        {
-            throw std::runtime_error("Draco mesh appears to have no vertices.");
-        }
+// Build a draco::Mesh from the given arrays and encode it into 'buf'.
+//
+// If 'quantizer' is non-null, the vertices are quantized into a DT_UINT32
+// position attribute (the 'custom' format), and normals are ignored.
+// Otherwise, the vertices are stored as DT_FLOAT32, and if normals is empty
+// and settings.compute_normals is set, vertex normals are computed first.
+//
+// The optional 'scratch' and 'encoder' may be passed to reuse them across calls.
+// (See DracoEncoderScratch and encode_packed_mesh_to_buffer().)
+// The optional 'attributes' are stored as GENERIC per-vertex attributes.
+//
+// Special case: If faces is empty, 'buf' is left empty.
+void encode_mesh_to_buffer( vertices_array_t const & vertices,
+                            normals_array_t const & normals,
+                            faces_array_t const & faces,
+                            Quantizer const * quantizer,
+                            DracoEncoderSettings const & settings,
+                            draco::EncoderBuffer & buf,
+                            DracoEncoderScratch * scratch = nullptr,
+                            draco::Encoder * encoder = nullptr,
+                            std::vector<GenericAttribute> const * attributes = nullptr )
+{
+    using namespace draco;
+    bool do_custom = (quantizer != nullptr);
 
-        std::array<float, 3> vertex_value;
-        for (PointIndex i(0); i < point_count; ++i)
-        {
-            if (!vertex_att->ConvertValue<float, 3>(vertex_att->mapped_index(i), &vertex_value[0]))
-            {
-                std::ostringstream ssErr;
-                ssErr << "Error reading vertex " << i.value() << std::endl;
-                throw std::runtime_error(ssErr.str());
-            }
-            vertices(i.value(), 0) = vertex_value[0];
-            vertices(i.value(), 1) = vertex_value[1];
-            vertices(i.value(), 2) = vertex_value[2];
-        }
+    check_rows(vertices, 3, "vertices");
+    check_rows(normals, 3, "normals");
+    check_rows(faces, 3, "faces");
 
-        // Extract normals (if any)
-        if (normal_count > 0)
-        {
-            std::array<float, 3> normal_value;
+    size_t vertex_count = vertices.shape()[0];
+    size_t normal_count = do_custom ? 0 : normals.shape()[0]; //FOR CUSTOM IGNORE NORMALS, SCREWS UP DECODING
+    size_t face_count = faces.shape()[0];
 
-            // Important:
-            // We don't use normal_att->size(), because it might be smaller
-            // than the number of vertices (if not all vertices had unique normals).
-            // Instead, we loop over the POINT indices, mapping from point indices to normal entries.
-            for (PointIndex i(0); i < normal_count; ++i)
-            {
-                if (!normal_att->ConvertValue<float, 3>(normal_att->mapped_index(i), &normal_value[0]))
-                {
-                    std::ostringstream ssErr;
-                    ssErr << "Error reading normal for point " << i << std::endl;
-                    throw std::runtime_error(ssErr.str());
-                }
-                normals(i.value(), 0) = normal_value[0];
-                normals(i.value(), 1) = normal_value[1];
-                normals(i.value(), 2) = normal_value[2];
-            }
-        }
+    if (face_count == 0)
+    {
+        return;
+    }
 
-        // Extract faces
-        for (auto i = 0; i < pMesh->num_faces(); ++i)
+    DracoEncoderScratch local_scratch;
+    DracoEncoderScratch & s = (scratch != nullptr) ? *scratch : local_scratch;
+
+    uint32_t const * faces_data = packed_rows(faces, s.faces);
+    float const * vertices_data = packed_rows(vertices, s.vertices);
+    float const * normals_data = (normal_count > 0) ? packed_rows(normals, s.normals) : nullptr;
+
+    if (!do_custom && normal_count == 0 && settings.compute_normals)
+    {
+        uint32_t max_vertex = *std::max_element(faces_data, faces_data + 3*face_count);
+        if (vertex_count < size_t(max_vertex)+1)
         {
-            auto const & face = pMesh->face(FaceIndex(i));
-            faces(i, 0) = face[0].value();
-            faces(i, 1) = face[1].value();
-            faces(i, 2) = face[2].value();
+            throw std::runtime_error("Face indexes exceed vertices length");
         }
+
+        s.normals.resize(3 * vertex_count);
+        dvidutils::compute_vertex_normals( vertices_data, vertex_count, faces_data, face_count,
+                                           dvidutils::NormalWeighting::Area, 1, s.normals.data() );
+        normals_data = s.normals.data();
+        normal_count = vertex_count;
     }
 
-    return std::make_tuple( std::move(vertices), std::move(normals), std::move(faces) );
+    if (!do_custom)
+    {
+        encode_packed_mesh_to_buffer( DT_FLOAT32, vertices_data, vertex_count,
+                                      normals_data, normal_count,
+                                      faces_data, face_count,
+                                      settings, buf, encoder, attributes );
+        return;
+    }
+
+    s.quantized.resize(3 * vertex_count);
+    quantizer->quantize(vertices_data, vertex_count, s.quantized.data());
+    encode_packed_mesh_to_buffer( DT_UINT32, s.quantized.data(), vertex_count,
+                                  nullptr, 0,
+                                  faces_data, face_count,
+                                  settings, buf, encoder, attributes );
+}
+
+
+// An encoded draco buffer, which python can read via the buffer protocol
+// (e.g. memoryview(buf), file.write(buf), or socket.send(buf)) without
+// first copying it into a bytes object.
+class DracoBuffer
+{
+public:
+    draco::EncoderBuffer & buffer() { return _buffer; }
+
+    char const * data() const { return _buffer.data(); }
+    size_t size() const { return _buffer.size(); }
+
+private:
+    draco::EncoderBuffer _buffer;
+};
+
+typedef std::unique_ptr<DracoBuffer> DracoBufferPtr;
+
+// The buffer protocol's getbuffer slot for DracoBuffer, which exports the bytes read-only.
+// (pybind11's def_buffer() always exports writable buffers, which would let python
+// modify the encoded bytes in place, e.g. via memoryview(buf)[0] = 0.)
+// Requests for a writable buffer fail with BufferError.
+int draco_buffer_getbuffer( PyObject * obj, Py_buffer * view, int flags )
+{
+    DracoBuffer * buf = nullptr;
+    try
+    {
+        buf = &py::cast<DracoBuffer &>(py::handle(obj));
+    }
+    catch (...)
+    {
+        PyErr_SetString(PyExc_BufferError, "Not a valid DracoBuffer");
+        view->obj = nullptr;
+        return -1;
+    }
+
+    // An empty EncoderBuffer may have no storage at all, but python expects a valid pointer.
+    static char empty = 0;
+    void * data = (buf->size() > 0) ? const_cast<char *>(buf->data()) : &empty;
+    return PyBuffer_FillInfo(view, obj, data, Py_ssize_t(buf->size()), 1, flags);
+}
+
+// Returns the encoded buffer to python, either as a DracoBuffer
+// (which takes ownership of it, without a copy) or as a copy in a bytes object.
+py::object encoded_buffer_to_python( DracoBufferPtr buf, bool return_buffer )
+{
+    if (return_buffer)
+    {
+        return py::cast(std::move(buf));
+    }
+    return py::bytes(buf->data(), buf->size());
+}
+
+// Encode the given vertices and faces arrays from python
+// into a buffer (bytes object) encoded via draco.
+//
+// Special case: If faces is empty, an empty buffer is returned.
+//
+// If return_buffer is true, a DracoBuffer is returned instead of a bytes object.
+//
+// 'attributes' is a dict of {name: array} of per-vertex values (e.g. supervoxel IDs
+// or scalar fields), each with one row per vertex, which are stored as GENERIC attributes.
+// Float attributes are quantized with generic_quantization_bits (by default 0, meaning no
+// quantization); integer attributes are lossless.  (See GENERIC_DTYPES for the supported dtypes.)
+//
+// Note: The vertices are expected to be passed in X,Y,Z order
+
+py::object encode_faces_to_custom_drc_bytes( vertices_array_t const & vertices,
+                                     normals_array_t const & normals,
+                                     faces_array_t const & faces,
+                                     coords_t const & fragment_shape,
+                                     coords_t const & fragment_origin,
+                                     int compression_level,
+                                     int position_quantization_bits,
+                                     int normal_quantization_bits,
+                                     int generic_quantization_bits,
+                                     bool do_custom,
+                                     bool return_buffer,
+                                     py::dict const & attributes)
+{
+    DracoEncoderSettings settings;
+    settings.compression_level = compression_level;
+    settings.position_quantization_bits = position_quantization_bits;
+    settings.normal_quantization_bits = normal_quantization_bits;
+    settings.generic_quantization_bits = generic_quantization_bits;
+
+    Quantizer quantizer(fragment_shape, fragment_origin, position_quantization_bits);
+
+    std::vector<py::array> attribute_arrays;
+    auto generic_attributes = generic_attributes_from_dict(attributes, vertices.shape()[0], attribute_arrays);
+
+    DracoBufferPtr buf(new DracoBuffer()); // result
+
+    // Release the GIL in the following scope.
+    // (No python functions or data structures are touched in this scope)
+    {
+        py::gil_scoped_release nogil;
+        encode_mesh_to_buffer( vertices, normals, faces, do_custom ? &quantizer : nullptr, settings, buf->buffer(),
+                               nullptr, nullptr, &generic_attributes );
+    }
+    
+    // Safe to use python again now that the GIL is re-acquired.
+    return encoded_buffer_to_python(std::move(buf), return_buffer);
+}
+py::object encode_faces_to_drc_bytes( vertices_array_t const & vertices,
+                                     normals_array_t const & normals,
+                                     faces_array_t const & faces,
+                                     int compression_level,
+                                     int position_quantization_bits,
+                                     int normal_quantization_bits,
+                                     int generic_quantization_bits,
+                                     bool compute_normals,
+                                     bool return_buffer,
+                                     py::dict const & attributes)
+{
+    DracoEncoderSettings settings;
+    settings.compression_level = compression_level;
+    settings.position_quantization_bits = position_quantization_bits;
+    settings.normal_quantization_bits = normal_quantization_bits;
+    settings.generic_quantization_bits = generic_quantization_bits;
+    settings.compute_normals = compute_normals;
+
+    std::vector<py::array> attribute_arrays;
+    auto generic_attributes = generic_attributes_from_dict(attributes, vertices.shape()[0], attribute_arrays);
+
+    DracoBufferPtr buf(new DracoBuffer()); // result
+    {
+        py::gil_scoped_release nogil;
+        encode_mesh_to_buffer( vertices, normals, faces, nullptr, settings, buf->buffer(),
+                               nullptr, nullptr, &generic_attributes );
+    }
+    return encoded_buffer_to_python(std::move(buf), return_buffer);
+}
+
+// Encode a mesh whose vertices are given as integer lattice coordinates
+// (e.g. the half-voxel lattice of a marching-cubes mesh) into the 'custom'
+// format, i.e. with DT_UINT32 positions, as encode_faces_to_custom_drc_bytes() produces.
+//
+// Each coordinate is mapped to its quantized value with integer arithmetic only:
+//
+//     quantized = (vertex - lattice_origin) * lattice_scale
+//
+// ...so lattice_origin is the lattice coordinate of the fragment origin,
+// and lattice_scale is the number of quantization steps per lattice unit.
+// (The fragment therefore spans (2**position_quantization_bits - 1) / lattice_scale lattice units.)
+//
+// Unlike the Quantizer, no clamping is performed: If any quantized value would fall
+// outside of [0, 2**position_quantization_bits - 1], an error is raised.
+//
+// As with encode_faces_to_custom_drc_bytes(), 'attributes' is a dict of per-vertex
+// GENERIC attributes, and return_buffer=true yields a DracoBuffer instead of a bytes object.
+//
+// Special case: If faces is empty, an empty buffer is returned.
+template <typename lattice_t>
+py::object encode_lattice_faces_to_custom_drc_bytes( xt::pytensor<lattice_t, 2> const & vertices,
+                                                     faces_array_t const & faces,
+                                                     coords_t const & lattice_scale,
+                                                     coords_t const & lattice_origin,
+                                                     int compression_level,
+                                                     int position_quantization_bits,
+                                                     int generic_quantization_bits,
+                                                     bool return_buffer,
+                                                     py::dict const & attributes )
+{
+    using namespace draco;
+
+    if (lattice_scale.size() != 3 || lattice_origin.size() != 3)
+    {
+        throw std::runtime_error("lattice_scale and lattice_origin must each have 3 elements");
+    }
+    if (position_quantization_bits < 1 || position_quantization_bits > 32)
+    {
+        throw std::runtime_error("position_quantization_bits must be in the range [1, 32]");
+    }
+    check_rows(vertices, 3, "vertices");
+    check_rows(faces, 3, "faces");
+
+    DracoEncoderSettings settings;
+    settings.compression_level = compression_level;
+    settings.position_quantization_bits = position_quantization_bits;
+    settings.generic_quantization_bits = generic_quantization_bits;
+
+    std::array<int64_t, 3> scale{{ lattice_scale(0), lattice_scale(1), lattice_scale(2) }};
+    std::array<int64_t, 3> origin{{ lattice_origin(0), lattice_origin(1), lattice_origin(2) }};
+    int64_t const max_value = std::numeric_limits<uint32_t>::max() >> (32 - position_quantization_bits);
+
+    std::vector<py::array> attribute_arrays;
+    auto generic_attributes = generic_attributes_from_dict(attributes, vertices.shape()[0], attribute_arrays);
+
+    DracoBufferPtr buf(new DracoBuffer()); // result
+
+    {
+        py::gil_scoped_release nogil;
+
+        size_t vertex_count = vertices.shape()[0];
+        size_t face_count = faces.shape()[0];
+
+        std::vector<lattice_t> vertices_scratch;
+        lattice_t const * vertices_data = packed_rows(vertices, vertices_scratch);
+
+        std::vector<uint32_t> faces_scratch;
+        uint32_t const * faces_data = packed_rows(faces, faces_scratch);
+
+        std::vector<uint32_t> quantized(3 * vertex_count);
+        for (size_t vi = 0; vi < vertex_count; ++vi)
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                int64_t q = (static_cast<int64_t>(vertices_data[3*vi + i]) - origin[i]) * scale[i];
+                if (q < 0 || q > max_value)
+                {
+                    std::ostringstream ss;
+                    ss << "Vertex " << vi << " falls outside the quantization range "
+                       << "(axis " << i << " maps to " << q << ", but the maximum is " << max_value << ")";
+                    throw std::runtime_error(ss.str());
+                }
+                quantized[3*vi + i] = static_cast<uint32_t>(q);
+            }
+        }
+
+        encode_packed_mesh_to_buffer( DT_UINT32, quantized.data(), vertex_count,
+                                      nullptr, 0,
+                                      faces_data, face_count,
+                                      settings, buf->buffer(), nullptr, &generic_attributes );
+    }
+
+    return encoded_buffer_to_python(std::move(buf), return_buffer);
+}
+
+// A (vertices, normals, faces) triple, as passed in from python.
+typedef std::tuple<vertices_array_t, normals_array_t, faces_array_t> mesh_arrays_t;
+
+// Encode a list of (vertices, normals, faces) meshes into a list of
+// draco-encoded buffers (bytes objects), in the same order.
+//
+// The meshes are encoded concurrently in a pool of num_threads native threads
+// (0 means "use all cores"), with the GIL released for the whole batch.
+// The bytes objects are created at the end, once the GIL is re-acquired.
+//
+// As with encode_faces_to_drc_bytes(), an empty faces array yields an empty buffer,
+// and return_buffer=true yields DracoBuffer objects instead of bytes objects.
+// If attributes_list is non-empty, it holds one dict of per-vertex attributes for each mesh.
+py::list encode_many_to_drc_bytes( std::vector<mesh_arrays_t> const & meshes,
+                                   int num_threads,
+                                   int compression_level,
+                                   int position_quantization_bits,
+                                   int normal_quantization_bits,
+                                   int generic_quantization_bits,
+                                   bool compute_normals,
+                                   bool return_buffer,
+                                   std::vector<py::dict> const & attributes_list )
+{
+    if (!attributes_list.empty() && attributes_list.size() != meshes.size())
+    {
+        throw std::runtime_error("attributes_list must be empty or have one dict per mesh");
+    }
+
+    DracoEncoderSettings settings;
+    settings.compression_level = compression_level;
+    settings.position_quantization_bits = position_quantization_bits;
+    settings.normal_quantization_bits = normal_quantization_bits;
+    settings.generic_quantization_bits = generic_quantization_bits;
+    settings.compute_normals = compute_normals;
+
+    std::vector<py::array> attribute_arrays;
+    std::vector<std::vector<GenericAttribute>> generic_attributes(meshes.size());
+    for (size_t i = 0; i < attributes_list.size(); ++i)
+    {
+        generic_attributes[i] = generic_attributes_from_dict( attributes_list[i], std::get<0>(meshes[i]).shape()[0],
+                                                              attribute_arrays );
+    }
+
+    std::vector<DracoBufferPtr> buffers(meshes.size());
+    for (auto & buf : buffers)
+    {
+        buf.reset(new DracoBuffer());
+    }
+
+    {
+        py::gil_scoped_release nogil;
+        dvidutils::parallel_for(meshes.size(), num_threads, [&](size_t i) {
+            auto const & mesh = meshes[i];
+            encode_mesh_to_buffer( std::get<0>(mesh), std::get<1>(mesh), std::get<2>(mesh),
+                                   nullptr, settings, buffers[i]->buffer(),
+                                   nullptr, nullptr, &generic_attributes[i] );
+        });
+    }
+
+    py::list results;
+    for (auto & buf : buffers)
+    {
+        results.append(encoded_buffer_to_python(std::move(buf), return_buffer));
+    }
+    return results;
+}
+
+typedef std::unique_ptr<draco::Mesh> MeshPtr;
+
+// Returns true if every attribute of the mesh uses the identity mapping.
+// In that case, each point has its own attribute entries, so no two points
+// can be duplicates, and Mesh::DeduplicatePointIds() would have nothing to do.
+bool all_attributes_identity_mapped( draco::Mesh const & mesh )
+{
+    for (int a = 0; a < mesh.num_attributes(); ++a)
+    {
+        if (!mesh.attribute(a)->is_mapping_identity())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Decode a raw draco buffer into a draco::Mesh.
+//
+// If deduplicate is true, duplicate attribute values and duplicate
+// points are merged after decoding (see note below).
+// Both are full hash passes over the mesh, so callers that don't need
+// a minimal mesh (e.g. for rendering) can skip them.
+//
+// If 'decoder' is given, it is used instead of a new draco::Decoder.
+MeshPtr decode_buffer_to_mesh( char const * raw_buf, size_t bytes_length, bool deduplicate = true,
+                               draco::Decoder * decoder = nullptr )
+{
+    using namespace draco;
+
+    DecoderBuffer buf;
+    buf.Init( raw_buf, bytes_length );
+
+    // Decode to Mesh
+    Decoder local_decoder;
+    if (decoder == nullptr)
+    {
+        decoder = &local_decoder;
+    }
+
+    auto geometry_type = decoder->GetEncodedGeometryType(&buf).value();
+    if (geometry_type != TRIANGULAR_MESH)
+    {
+        throw std::runtime_error("Buffer does not appear to be a mesh file. (Is it a pointcloud? If so, use decode_drc_bytes_to_points().)");
+    }
+
+    // Wrap bytes in a DecoderBuffer
+    StatusOr<MeshPtr> decoded = decoder->DecodeMeshFromBuffer(&buf);
+    if (!decoded.status().ok())
+    {
+        std::ostringstream ss;
+        ss << "draco::Decoder::DecodeMeshFromBuffer() returned bad status: " << decoded.status();
+        throw std::runtime_error(ss.str().c_str());
+    }
+    
+    // This use of std::move feels like an ugly hack to workaround the fact
+    // that StatusOr does not declare the following member:
+    //   T & value() & { return value_; }
+    // ... it declares a const version of it, which doesn't help us...
+    MeshPtr pMesh = std::move(decoded).value();
+    
+    // Strangely, encoding a mesh may cause it to have duplicate point ids,
+    // so we should de-duplicate them after decoding.
+    if (deduplicate)
+    {
+        pMesh->DeduplicateAttributeValues();
+        if (!all_attributes_identity_mapped(*pMesh))
+        {
+            pMesh->DeduplicatePointIds();
+        }
+    }
+
+    return pMesh;
+}
+
+// Returns the number of normals that extract_mesh() will write for the given mesh:
+// Either one per point, or zero if the mesh has no normals.
+size_t mesh_normal_count( draco::Mesh const & mesh )
+{
+    // See Note in extract_mesh() about why we don't use normal_att->size()
+    if (mesh.GetNamedAttribute(draco::GeometryAttribute::NORMAL) == nullptr)
+    {
+        return 0;
+    }
+    return mesh.num_points();
+}
+
+// Copy a 3-component attribute into a row-major (point_count,3) float buffer,
+// with one row per POINT (not per attribute value).
+//
+// Float32 attributes are copied directly from the attribute's buffer:
+// with a single memcpy if the point-to-value mapping is the identity and the
+// values are tightly packed, or one 12-byte copy per point otherwise.
+// Any other data type falls back to PointAttribute::ConvertValue().
+//
+// 'name' is used in error messages only.
+void extract_attribute_values( draco::PointAttribute const & att,
+                               size_t point_count,
+                               float * out,
+                               char const * name )
+{
+    using namespace draco;
+    size_t const row_bytes = 3 * sizeof(float);
+
+    bool is_packed_float = ( att.data_type() == DT_FLOAT32
+                             && att.num_components() == 3
+                             && att.byte_stride() == static_cast<int64_t>(row_bytes)
+                             && att.byte_offset() == 0 );
+
+    if (is_packed_float && att.is_mapping_identity() && att.size() >= point_count)
+    {
+        if (point_count > 0)
+        {
+            std::memcpy(out, att.GetAddress(AttributeValueIndex(0)), point_count * row_bytes);
+        }
+        return;
+    }
+
+    if (att.data_type() == DT_FLOAT32 && att.num_components() == 3)
+    {
+        for (PointIndex i(0); i < point_count; ++i)
+        {
+            std::memcpy(out + 3*i.value(), att.GetAddress(att.mapped_index(i)), row_bytes);
+        }
+        return;
+    }
+
+    std::array<float, 3> value;
+    for (PointIndex i(0); i < point_count; ++i)
+    {
+        if (!att.ConvertValue<float, 3>(att.mapped_index(i), &value[0]))
+        {
+            std::ostringstream ssErr;
+            ssErr << "Error reading " << name << " for point " << i.value() << std::endl;
+            throw std::runtime_error(ssErr.str());
+        }
+        out[3*i.value() + 0] = value[0];
+        out[3*i.value() + 1] = value[1];
+        out[3*i.value() + 2] = value[2];
+    }
+}
+
+// Copy the DT_UINT32 positions of a 'custom' mesh into a row-major (point_count,3)
+// float buffer, mapping them back to vertex coordinates with the given Quantizer
+// (the inverse of the quantization applied by encode_faces_to_custom_drc_bytes()).
+void extract_dequantized_positions( draco::PointAttribute const & att,
+                                    size_t point_count,
+                                    Quantizer const & dequantizer,
+                                    float * out )
+{
+    using namespace draco;
+    if (att.data_type() != DT_UINT32 || att.num_components() != 3)
+    {
+        throw std::runtime_error("Can't dequantize vertices: the mesh positions are not "
+                                 "uint32 values, so it doesn't appear to be in the 'custom' format.");
+    }
+
+    if (att.is_mapping_identity() && att.byte_stride() == 3 * sizeof(uint32_t)
+        && att.byte_offset() == 0 && att.size() >= point_count)
+    {
+        if (point_count > 0)
+        {
+            auto quantized = reinterpret_cast<uint32_t const *>(att.GetAddress(AttributeValueIndex(0)));
+            dequantizer.dequantize(quantized, point_count, out);
+        }
+        return;
+    }
+
+    std::array<uint32_t, 3> quantized;
+    for (PointIndex i(0); i < point_count; ++i)
+    {
+        std::memcpy(quantized.data(), att.GetAddress(att.mapped_index(i)), sizeof(quantized));
+        dequantizer.dequantize(quantized.data(), 1, out + 3*i.value());
+    }
+}
+
+// Copy the vertices, normals, and faces of a decoded draco::Mesh into
+// the given row-major (N,3) buffers, which must already be allocated with
+// num_points(), mesh_normal_count(), and num_faces() rows, respectively.
+// If 'normals' is nullptr (or the mesh has no normals), normals are not extracted.
+//
+// The given face_index_offset is added to every face index,
+// which is convenient when the mesh will be part of a larger concatenated mesh.
+//
+// If 'dequantizer' is given, the mesh must be in the 'custom' format,
+// and its quantized positions are mapped back to vertex coordinates.
+void extract_mesh( draco::Mesh const & mesh,
+                   float * vertices,
+                   float * normals,
+                   uint32_t * faces,
+                   uint32_t face_index_offset = 0,
+                   Quantizer const * dequantizer = nullptr )
+{
+    using namespace draco;
+    size_t point_count = mesh.num_points();
+
+    // Extract vertices
+    const PointAttribute *const vertex_att = mesh.GetNamedAttribute(GeometryAttribute::POSITION);
+    if (vertex_att == nullptr)
+    {
+        throw std::runtime_error("Draco mesh appears to have no vertices.");
+    }
+    if (dequantizer != nullptr)
+    {
+        extract_dequantized_positions(*vertex_att, point_count, *dequantizer, vertices);
+    }
+    else
+    {
+        extract_attribute_values(*vertex_att, point_count, vertices, "vertex");
+    }
+
+    // Extract normals (if any)
+    //
+    // Important:
+    // We don't use normal_att->size(), because it might be smaller
+    // than the number of vertices (if not all vertices had unique normals).
+    // Instead, we loop over the POINT indices, mapping from point indices to normal entries.
+    size_t normal_count = mesh_normal_count(mesh);
+    if (normals != nullptr && normal_count > 0)
+    {
+        const PointAttribute *const normal_att = mesh.GetNamedAttribute(GeometryAttribute::NORMAL);
+        extract_attribute_values(*normal_att, normal_count, normals, "normal");
+    }
+
+    // Extract faces
+    // Draco stores the faces contiguously as triples of 32-bit PointIndex values,
+    // so we can copy them in bulk (or add the offset in a single flat loop).
+    static_assert( sizeof(Mesh::Face) == 3 * sizeof(uint32_t), "Unexpected draco face layout" );
+    size_t index_count = 3 * size_t(mesh.num_faces());
+    if (index_count == 0)
+    {
+        return;
+    }
+
+    uint32_t const * face_indexes = reinterpret_cast<uint32_t const *>(&mesh.face(FaceIndex(0)));
+    if (face_index_offset == 0)
+    {
+        std::memcpy(faces, face_indexes, index_count * sizeof(uint32_t));
+    }
+    else
+    {
+        for (size_t j = 0; j < index_count; ++j)
+        {
+            faces[j] = face_indexes[j] + face_index_offset;
+        }
+    }
+}
+
+// Returns empty (0,3) vertices, normals, and faces arrays.
+std::tuple<vertices_array_t, normals_array_t, faces_array_t> empty_mesh_arrays()
+{
+    vertices_array_t::shape_type verts_shape = {{0, 3}};
+    vertices_array_t vertices(verts_shape);
+
+    normals_array_t::shape_type normals_shape = {{0, 3}};
+    normals_array_t normals(normals_shape);
+    
+    faces_array_t::shape_type faces_shape = {{0, 3}};
+    faces_array_t faces(faces_shape);
+
+    return std::make_tuple( std::move(vertices), std::move(normals), std::move(faces) );
+}
+
+// Decode a draco-encoded buffer (given as a python bytes object) into new arrays.
+// The shared implementation of decode_drc_bytes_to_faces(), decode_custom_drc_bytes_to_faces(),
+// and DracoCodec::decode(); see those functions.
+//
+// If 'dequantizer' is given, the positions are dequantized (see extract_mesh()).
+// If 'decoder' is given, it is used instead of a new draco::Decoder.
+// If 'attributes' is given, the mesh's GENERIC attributes are decoded into it, too.
+std::tuple<vertices_array_t, normals_array_t, faces_array_t> decode_drc_bytes_to_arrays( py::bytes const & drc_bytes,
+                                                                                        bool deduplicate,
+                                                                                        Quantizer const * dequantizer = nullptr,
+                                                                                        draco::Decoder * decoder = nullptr,
+                                                                                        GenericAttributeArrays * attributes = nullptr )
+{
+    // Special case:
+    // If drc_bytes is empty, return empty vertices and faces.
+    if (py::len(drc_bytes) == 0)
+    {
+        return empty_mesh_arrays();
+    }
+
+    // Extract pointer to raw bytes (avoid copy)
+    PyObject * pyObj = drc_bytes.ptr();
+    char * raw_buf = nullptr;
+    Py_ssize_t bytes_length = 0;
+    PyBytes_AsStringAndSize(pyObj, &raw_buf, &bytes_length);
+
+    MeshPtr pMesh;
+    
+    {
+        // Release GIL while decoding the mesh in C++
+        py::gil_scoped_release nogil;
+        pMesh = decode_buffer_to_mesh(raw_buf, bytes_length, deduplicate, decoder);
+    }
+    
+    // Initialize Python arrays (with GIL re-aqcuired)
+    
+    // Vertices
+    vertices_array_t::shape_type verts_shape = {{pMesh->num_points(), 3}};
+    vertices_array_t vertices(verts_shape);
+    
+    // Normals
+    normals_array_t::shape_type normals_shape = {{mesh_normal_count(*pMesh), 3}};
+    normals_array_t normals(normals_shape);
+    
+    // Faces
+    faces_array_t::shape_type faces_shape = {{pMesh->num_faces(), 3}};
+    faces_array_t faces(faces_shape);
+
+    // Generic attributes
+    if (attributes != nullptr)
+    {
+        attributes->allocate(read_generic_attributes(*pMesh), pMesh->num_points());
+    }
+
+    {
+        // Release GIL again while copying from pMesh into the arrays
+        py::gil_scoped_release nogil;
+        extract_mesh(*pMesh, vertices.data(), normals.data(), faces.data(), 0, dequantizer);
+        if (attributes != nullptr)
+        {
+            attributes->extract(*pMesh);
+        }
+    }
+
+    return std::make_tuple( std::move(vertices), std::move(normals), std::move(faces) );
+}
+
+// Returns decoded mesh arrays to python as a (vertices, normals, faces) tuple,
+// with the attributes dict as a fourth element if 'attributes' is given.
+// (Requires the GIL.)
+py::object decoded_mesh_to_python( std::tuple<vertices_array_t, normals_array_t, faces_array_t> mesh,
+                                   GenericAttributeArrays * attributes )
+{
+    if (attributes != nullptr)
+    {
+        return py::make_tuple( std::move(std::get<0>(mesh)), std::move(std::get<1>(mesh)),
+                               std::move(std::get<2>(mesh)), attributes->to_dict() );
+    }
+    return py::cast(std::move(mesh));
+}
+
+// Decode a draco-encoded buffer (given as a python bytes object)
+// into a xtensor-python arrays for the vertices and faces
+// (which are converted to numpy arrays on the python side).
+//
+// Special case: If drc_bytes is empty, return empty vertices and faces.
+//
+// If deduplicate is false, the decoded mesh is returned as-is, without
+// merging duplicate vertices, which is faster but may yield more vertices.
+//
+// If return_attributes is true, a fourth element is returned: a dict of
+// {name: array} for the mesh's GENERIC per-vertex attributes
+// (see encode_faces_to_drc_bytes()), with single-column attributes as 1-D arrays.
+//
+// Note: The vertexes are returned in X,Y,Z order.
+py::object decode_drc_bytes_to_faces( py::bytes const & drc_bytes, bool deduplicate, bool return_attributes )
+{
+    GenericAttributeArrays attributes;
+    auto mesh = decode_drc_bytes_to_arrays( drc_bytes, deduplicate, nullptr, nullptr,
+                                            return_attributes ? &attributes : nullptr );
+    return decoded_mesh_to_python(std::move(mesh), return_attributes ? &attributes : nullptr);
+}
+
+// Decode a buffer produced by encode_faces_to_custom_drc_bytes() (with do_custom=True),
+// mapping its quantized positions back to vertex coordinates during extraction.
+//
+// The fragment_shape, fragment_origin, and position_quantization_bits must be
+// the same ones that were used to encode the buffer.
+// (Otherwise, use decode_drc_bytes_to_faces() to obtain the raw quantized values.)
+std::tuple<vertices_array_t, normals_array_t, faces_array_t> decode_custom_drc_bytes_to_faces( py::bytes const & drc_bytes,
+                                                                                              coords_t const & fragment_shape,
+                                                                                              coords_t const & fragment_origin,
+                                                                                              int position_quantization_bits,
+                                                                                              bool deduplicate )
+{
+    if (fragment_shape.size() != 3 || fragment_origin.size() != 3)
+    {
+        throw std::runtime_error("fragment_shape and fragment_origin must each have 3 elements");
+    }
+    Quantizer dequantizer(fragment_shape, fragment_origin, position_quantization_bits);
+    return decode_drc_bytes_to_arrays(drc_bytes, deduplicate, &dequantizer);
+}
+
+// Decode a list of draco-encoded buffers (bytes objects).
+//
+// The buffers are decoded concurrently in a pool of num_threads native threads
+// (0 means "use all cores"), with the GIL released.  All output arrays are
+// allocated in a single GIL section once decoding is finished, and then
+// filled (in parallel) with the GIL released again.
+//
+// If concatenate is false, returns a list of (vertices, normals, faces) tuples,
+// one per buffer, just as decode_drc_bytes_to_faces() would.
+//
+// If concatenate is true, returns a single (vertices, normals, faces) tuple
+// containing all meshes, in order, with the face indexes of each mesh offset
+// to refer to its own vertices in the combined vertices array.
+// In that case, the combined normals are only returned if every (non-empty)
+// mesh has normals.  Otherwise, the returned normals array is empty.
+//
+// As with decode_drc_bytes_to_faces(), empty buffers yield empty meshes,
+// and deduplicate=false skips the post-decode deduplication passes.
+//
+// If return_attributes is true, each tuple gets a fourth element: a dict of the
+// GENERIC per-vertex attributes, as in decode_drc_bytes_to_faces().  When concatenating,
+// every (non-empty) mesh must have the same attributes, which are concatenated, too.
+py::object decode_many_drc_bytes( std::vector<py::bytes> const & drc_bytes_list,
+                                  int num_threads,
+                                  bool concatenate,
+                                  bool deduplicate,
+                                  bool return_attributes )
+{
+    size_t mesh_count = drc_bytes_list.size();
+
+    // Extract pointers to raw bytes (avoid copy).
+    // The bytes objects are kept alive by drc_bytes_list.
+    std::vector<char *> raw_bufs(mesh_count, nullptr);
+    std::vector<Py_ssize_t> bytes_lengths(mesh_count, 0);
+    for (size_t i = 0; i < mesh_count; ++i)
+    {
+        PyBytes_AsStringAndSize(drc_bytes_list[i].ptr(), &raw_bufs[i], &bytes_lengths[i]);
+    }
+
+    // Empty buffers are left as nullptr.
+    std::vector<MeshPtr> meshes(mesh_count);
+    {
+        py::gil_scoped_release nogil;
+        dvidutils::parallel_for(mesh_count, num_threads, [&](size_t i) {
+            if (bytes_lengths[i] > 0)
+            {
+                meshes[i] = decode_buffer_to_mesh(raw_bufs[i], bytes_lengths[i], deduplicate);
+            }
+        });
+    }
+
+    if (!concatenate)
+    {
+        typedef std::tuple<vertices_array_t, normals_array_t, faces_array_t> mesh_tuple_t;
+
+        // Allocate all output arrays in one GIL section
+        std::vector<mesh_tuple_t> results;
+        std::vector<GenericAttributeArrays> attributes(mesh_count);
+        results.reserve(mesh_count);
+        for (size_t i = 0; i < mesh_count; ++i)
+        {
+            auto const & pMesh = meshes[i];
+            if (!pMesh)
+            {
+                results.push_back(empty_mesh_arrays());
+                continue;
+            }
+            if (return_attributes)
+            {
+                attributes[i].allocate(read_generic_attributes(*pMesh), pMesh->num_points());
+            }
+
+            vertices_array_t::shape_type verts_shape = {{pMesh->num_points(), 3}};
+            normals_array_t::shape_type normals_shape = {{mesh_normal_count(*pMesh), 3}};
+            faces_array_t::shape_type faces_shape = {{pMesh->num_faces(), 3}};
+            results.emplace_back( vertices_array_t(verts_shape),
+                                  normals_array_t(normals_shape),
+                                  faces_array_t(faces_shape) );
+        }
+
+        {
+            py::gil_scoped_release nogil;
+            dvidutils::parallel_for(mesh_count, num_threads, [&](size_t i) {
+                if (meshes[i])
+                {
+                    extract_mesh( *meshes[i],
+                                  std::get<0>(results[i]).data(),
+                                  std::get<1>(results[i]).data(),
+                                  std::get<2>(results[i]).data() );
+                    attributes[i].extract(*meshes[i]);
+                }
+            });
+        }
+
+        py::list result_list;
+        for (size_t i = 0; i < mesh_count; ++i)
+        {
+            auto & result = results[i];
+            if (return_attributes)
+            {
+                result_list.append(py::make_tuple( std::move(std::get<0>(result)),
+                                                   std::move(std::get<1>(result)),
+                                                   std::move(std::get<2>(result)),
+                                                   attributes[i].to_dict() ));
+            }
+            else
+            {
+                result_list.append(py::make_tuple( std::move(std::get<0>(result)),
+                                                   std::move(std::get<1>(result)),
+                                                   std::move(std::get<2>(result)) ));
+            }
+        }
+        return std::move(result_list);
+    }
+
+    // Concatenate: Compute the position of each mesh within the combined arrays.
+    std::vector<size_t> vertex_offsets(mesh_count+1, 0);
+    std::vector<size_t> face_offsets(mesh_count+1, 0);
+    bool all_normals = true;
+    for (size_t i = 0; i < mesh_count; ++i)
+    {
+        size_t point_count = meshes[i] ? meshes[i]->num_points() : 0;
+        size_t face_count = meshes[i] ? meshes[i]->num_faces() : 0;
+        vertex_offsets[i+1] = vertex_offsets[i] + point_count;
+        face_offsets[i+1] = face_offsets[i] + face_count;
+
+        if (meshes[i] && mesh_normal_count(*meshes[i]) == 0)
+        {
+            all_normals = false;
+        }
+    }
+
+    if (vertex_offsets[mesh_count] > std::numeric_limits<uint32_t>::max())
+    {
+        throw std::runtime_error("Concatenated mesh has too many vertices for uint32 face indexes");
+    }
+
+    vertices_array_t::shape_type verts_shape = {{vertex_offsets[mesh_count], 3}};
+    vertices_array_t vertices(verts_shape);
+    
+    normals_array_t::shape_type normals_shape = {{all_normals ? vertex_offsets[mesh_count] : 0, 3}};
+    normals_array_t normals(normals_shape);
+    
+    faces_array_t::shape_type faces_shape = {{face_offsets[mesh_count], 3}};
+    faces_array_t faces(faces_shape);
+
+    // The attributes of the first non-empty mesh determine the combined layout.
+    GenericAttributeArrays attributes;
+    if (return_attributes)
+    {
+        bool have_layout = false;
+        std::vector<GenericAttribute> layout;
+        for (auto const & pMesh : meshes)
+        {
+            if (!pMesh)
+            {
+                continue;
+            }
+            auto mesh_layout = read_generic_attributes(*pMesh);
+            if (!have_layout)
+            {
+                layout = mesh_layout;
+                have_layout = true;
+            }
+            else if (!same_generic_layout(layout, mesh_layout))
+            {
+                throw std::runtime_error("Can't concatenate meshes with different generic attributes");
+            }
+        }
+        attributes.allocate(layout, vertex_offsets[mesh_count]);
+    }
+
+    {
+        py::gil_scoped_release nogil;
+
+        dvidutils::parallel_for(mesh_count, num_threads, [&](size_t i) {
+            if (!meshes[i])
+            {
+                return;
+            }
+
+            extract_mesh( *meshes[i],
+                          vertices.data() + 3*vertex_offsets[i],
+                          all_normals ? normals.data() + 3*vertex_offsets[i] : nullptr,
+                          faces.data() + 3*face_offsets[i],
+                          vertex_offsets[i] );
+            attributes.extract(*meshes[i], vertex_offsets[i]);
+        });
+    }
+
+    if (return_attributes)
+    {
+        return py::make_tuple( std::move(vertices), std::move(normals), std::move(faces), attributes.to_dict() );
+    }
+    return py::make_tuple( std::move(vertices), std::move(normals), std::move(faces) );
+}
+
+// Raise an error if the given (N,3) output array can't be written in place as packed rows.
+// (Requires the GIL.)
+template <typename array_t>
+void check_output_rows( array_t const & a, char const * name )
+{
+    if (a.shape()[1] != 3 || !is_packed_rows(a))
+    {
+        throw std::runtime_error(std::string(name) + " must be a C-contiguous array with 3 columns");
+    }
+    if (!PyArray_ISWRITEABLE(reinterpret_cast<PyArrayObject *>(a.ptr())))
+    {
+        throw std::runtime_error(std::string(name) + " is not writeable");
+    }
+}
+
+// Decode a list of draco-encoded buffers directly into caller-provided arrays.
+//
+// The meshes are written consecutively, starting at row vertex_offset of the
+// vertices (and normals) array and row face_offset of the faces array.
+// The face indexes of each mesh are offset by face_index_offset plus the number of
+// vertices written for the preceding meshes in the list.
+// By default (face_index_offset < 0), face_index_offset is vertex_offset,
+// so the faces refer to their vertices' rows in the output vertices array.
+//
+// If the normals array is empty, normals are not written.  Otherwise,
+// it must have as many rows as the vertices array, and the normal rows of
+// any mesh that has no normals are filled with zeros.
+//
+// The output arrays are not resized; if they are too small, an error is raised
+// (before anything is written).  They must be C-contiguous, writeable, and of the
+// exact dtypes (float32, uint32), since any converted copy would be discarded.
+//
+// The buffers are decoded and extracted concurrently in a pool of num_threads
+// native threads (0 means "use all cores"), with the GIL released.
+//
+// Returns the number of (vertices, faces) written.
+std::tuple<size_t, size_t> decode_many_drc_bytes_into( std::vector<py::bytes> const & drc_bytes_list,
+                                                       vertices_array_t & vertices,
+                                                       normals_array_t & normals,
+                                                       faces_array_t & faces,
+                                                       size_t vertex_offset,
+                                                       size_t face_offset,
+                                                       int64_t face_index_offset,
+                                                       int num_threads,
+                                                       bool deduplicate )
+{
+    check_output_rows(vertices, "vertices");
+    check_output_rows(faces, "faces");
+    bool write_normals = (normals.shape()[0] > 0);
+    if (write_normals)
+    {
+        check_output_rows(normals, "normals");
+        if (normals.shape()[0] != vertices.shape()[0])
+        {
+            throw std::runtime_error("normals must be empty or have as many rows as vertices");
+        }
+    }
+    if (face_index_offset < 0)
+    {
+        face_index_offset = vertex_offset;
+    }
+
+    size_t mesh_count = drc_bytes_list.size();
+    std::vector<char *> raw_bufs(mesh_count, nullptr);
+    std::vector<Py_ssize_t> bytes_lengths(mesh_count, 0);
+    for (size_t i = 0; i < mesh_count; ++i)
+    {
+        PyBytes_AsStringAndSize(drc_bytes_list[i].ptr(), &raw_bufs[i], &bytes_lengths[i]);
+    }
+
+    std::vector<size_t> vertex_offsets(mesh_count+1, vertex_offset);
+    std::vector<size_t> face_offsets(mesh_count+1, face_offset);
+
+    {
+        py::gil_scoped_release nogil;
+
+        std::vector<MeshPtr> meshes(mesh_count);
+        dvidutils::parallel_for(mesh_count, num_threads, [&](size_t i) {
+            if (bytes_lengths[i] > 0)
+            {
+                meshes[i] = decode_buffer_to_mesh(raw_bufs[i], bytes_lengths[i], deduplicate);
+            }
+        });
+
+        for (size_t i = 0; i < mesh_count; ++i)
+        {
+            vertex_offsets[i+1] = vertex_offsets[i] + (meshes[i] ? meshes[i]->num_points() : 0);
+            face_offsets[i+1] = face_offsets[i] + (meshes[i] ? meshes[i]->num_faces() : 0);
+        }
+
+        if (vertex_offsets[mesh_count] > vertices.shape()[0])
+        {
+            std::ostringstream ss;
+            ss << "vertices array is too small: the decoded meshes need " << vertex_offsets[mesh_count]
+               << " rows, but it has " << vertices.shape()[0];
+            throw std::runtime_error(ss.str());
+        }
+        if (face_offsets[mesh_count] > faces.shape()[0])
+        {
+            std::ostringstream ss;
+            ss << "faces array is too small: the decoded meshes need " << face_offsets[mesh_count]
+               << " rows, but it has " << faces.shape()[0];
+            throw std::runtime_error(ss.str());
+        }
+        if (face_index_offset + (vertex_offsets[mesh_count] - vertex_offset) > std::numeric_limits<uint32_t>::max())
+        {
+            throw std::runtime_error("Decoded face indexes would exceed the range of uint32");
+        }
+
+        float * vertices_data = vertices.data() + vertices.data_offset();
+        float * normals_data = write_normals ? normals.data() + normals.data_offset() : nullptr;
+        uint32_t * faces_data = faces.data() + faces.data_offset();
+
+        dvidutils::parallel_for(mesh_count, num_threads, [&](size_t i) {
+            if (!meshes[i])
+            {
+                return;
+            }
+
+            float * mesh_normals = write_normals ? normals_data + 3*vertex_offsets[i] : nullptr;
+            if (mesh_normals != nullptr && mesh_normal_count(*meshes[i]) == 0)
+            {
+                std::fill(mesh_normals, mesh_normals + 3*meshes[i]->num_points(), 0.0f);
+            }
+
+            extract_mesh( *meshes[i],
+                          vertices_data + 3*vertex_offsets[i],
+                          mesh_normals,
+                          faces_data + 3*face_offsets[i],
+                          face_index_offset + (vertex_offsets[i] - vertex_offset) );
+        });
+    }
+
+    return std::make_tuple( vertex_offsets[mesh_count] - vertex_offset,
+                            face_offsets[mesh_count] - face_offset );
+}
+
+// Decode a single draco-encoded buffer directly into caller-provided arrays.
+// See decode_many_drc_bytes_into() for details.
+std::tuple<size_t, size_t> decode_drc_bytes_into( py::bytes const & drc_bytes,
+                                                  vertices_array_t & vertices,
+                                                  normals_array_t & normals,
+                                                  faces_array_t & faces,
+                                                  size_t vertex_offset,
+                                                  size_t face_offset,
+                                                  int64_t face_index_offset,
+                                                  bool deduplicate )
+{
+    return decode_many_drc_bytes_into( std::vector<py::bytes>{drc_bytes}, vertices, normals, faces,
+                                       vertex_offset, face_offset, face_index_offset, 1, deduplicate );
 }
 
 #endif
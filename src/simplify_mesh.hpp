@@ -0,0 +1,457 @@
+#ifndef DVIDUTILS_SIMPLIFY_MESH_HPP
+#define DVIDUTILS_SIMPLIFY_MESH_HPP
+
+#include <cstdint>
+#include <cmath>
+#include <array>
+#include <vector>
+#include <queue>
+#include <unordered_map>
+#include <algorithm>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+using std::size_t;
+using std::uint32_t;
+using std::uint64_t;
+
+namespace dvidutils
+{
+    // A symmetric 4x4 error quadric (Garland & Heckbert), stored as its 10 unique coefficients:
+    //
+    //   [a0 a1 a2 a3]
+    //   [a1 a4 a5 a6]
+    //   [a2 a5 a7 a8]
+    //   [a3 a6 a8 a9]
+    //
+    struct Quadric
+    {
+        std::array<double, 10> a{};
+
+        // The quadric of the plane n.x + d = 0, scaled by the given weight.
+        static Quadric from_plane(double nx, double ny, double nz, double d, double weight)
+        {
+            Quadric q;
+            q.a = {{ nx*nx, nx*ny, nx*nz, nx*d,
+                            ny*ny, ny*nz, ny*d,
+                                   nz*nz, nz*d,
+                                          d*d }};
+            for (auto & x : q.a)
+            {
+                x *= weight;
+            }
+            return q;
+        }
+
+        Quadric & operator+=(Quadric const & other)
+        {
+            for (int i = 0; i < 10; ++i)
+            {
+                a[i] += other.a[i];
+            }
+            return *this;
+        }
+
+        // The squared-distance error of placing a vertex at p
+        double error(std::array<double, 3> const & p) const
+        {
+            double x = p[0], y = p[1], z = p[2];
+            return      a[0]*x*x + 2*a[1]*x*y + 2*a[2]*x*z + 2*a[3]*x
+                      + a[4]*y*y + 2*a[5]*y*z + 2*a[6]*y
+                      + a[7]*z*z + 2*a[8]*z
+                      + a[9];
+        }
+
+        // Find the position that minimizes the error, if the system is well-conditioned.
+        bool optimal_position(std::array<double, 3> & p) const
+        {
+            // Solve A p = -b (via Cramer's rule), with A the upper-left 3x3 block and b the last column.
+            double det = a[0]*(a[4]*a[7] - a[5]*a[5])
+                       - a[1]*(a[1]*a[7] - a[5]*a[2])
+                       + a[2]*(a[1]*a[5] - a[4]*a[2]);
+
+            double scale = std::max(std::abs(a[0]), std::max(std::abs(a[4]), std::abs(a[7])));
+            if (std::abs(det) <= 1e-9 * scale * scale * scale)
+            {
+                return false;
+            }
+
+            double bx = -a[3], by = -a[6], bz = -a[8];
+            p[0] = ( bx*(a[4]*a[7] - a[5]*a[5]) - a[1]*(by*a[7] - a[5]*bz) + a[2]*(by*a[5] - a[4]*bz) ) / det;
+            p[1] = ( a[0]*(by*a[7] - bz*a[5]) - bx*(a[1]*a[7] - a[5]*a[2]) + a[2]*(a[1]*bz - by*a[2]) ) / det;
+            p[2] = ( a[0]*(a[4]*bz - a[5]*by) - a[1]*(a[1]*bz - by*a[2]) + bx*(a[1]*a[5] - a[4]*a[2]) ) / det;
+            return true;
+        }
+    };
+
+    // Mesh simplification by iterative edge collapse, ordered by quadric error.
+    //
+    // Each vertex accumulates the (area-weighted) plane quadrics of its faces.
+    // Edges are kept in a priority queue keyed by the error of their optimal collapse position.
+    // Queue entries are invalidated lazily: each vertex carries a version number,
+    // which is bumped whenever the vertex moves, and stale entries are skipped when popped.
+    //
+    // Collapses that would make the mesh non-manifold (link condition) or
+    // flip the orientation of a face are rejected.
+    //
+    // If preserve_boundary is true, vertices on the mesh boundary (edges with only one face)
+    // never move, so open meshes keep their outline.
+    //
+    // The simplifier may be run repeatedly with decreasing targets (see simplify_to()),
+    // which makes it cheap to produce a series of successively coarser LODs.
+    class QuadricSimplifier
+    {
+    public:
+        QuadricSimplifier( float const * vertices, size_t vertex_count,
+                           uint32_t const * faces, size_t face_count,
+                           bool preserve_boundary )
+        : _positions(vertex_count)
+        , _quadrics(vertex_count)
+        , _version(vertex_count, 0)
+        , _vertex_alive(vertex_count, true)
+        , _locked(vertex_count, false)
+        , _vertex_faces(vertex_count)
+        , _faces(face_count)
+        , _face_alive(face_count, true)
+        , _face_count(face_count)
+        {
+            for (size_t i = 0; i < 3*face_count; ++i)
+            {
+                if (faces[i] >= vertex_count)
+                {
+                    throw std::runtime_error("Face indexes exceed vertices length");
+                }
+            }
+
+            for (size_t v = 0; v < vertex_count; ++v)
+            {
+                _positions[v] = {{ vertices[3*v + 0], vertices[3*v + 1], vertices[3*v + 2] }};
+            }
+
+            std::unordered_map<uint64_t, uint32_t> edge_face_counts;
+            for (size_t f = 0; f < face_count; ++f)
+            {
+                _faces[f] = {{ faces[3*f + 0], faces[3*f + 1], faces[3*f + 2] }};
+                for (int corner = 0; corner < 3; ++corner)
+                {
+                    _vertex_faces[_faces[f][corner]].push_back(f);
+                    edge_face_counts[edge_key(_faces[f][corner], _faces[f][(corner+1) % 3])] += 1;
+                }
+
+                // Accumulate the face's plane quadric into its vertices
+                std::array<double, 3> n = face_normal(_faces[f]);
+                double length = std::sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+                if (length == 0.0)
+                {
+                    continue;
+                }
+                double area = 0.5 * length;
+                n = {{ n[0] / length, n[1] / length, n[2] / length }};
+                auto const & p = _positions[_faces[f][0]];
+                double d = -(n[0]*p[0] + n[1]*p[1] + n[2]*p[2]);
+                Quadric q = Quadric::from_plane(n[0], n[1], n[2], d, area);
+                for (auto v : _faces[f])
+                {
+                    _quadrics[v] += q;
+                }
+            }
+
+            if (preserve_boundary)
+            {
+                for (auto const & edge : edge_face_counts)
+                {
+                    if (edge.second == 1)
+                    {
+                        _locked[edge.first >> 32] = true;
+                        _locked[edge.first & 0xFFFFFFFF] = true;
+                    }
+                }
+            }
+
+            for (auto const & edge : edge_face_counts)
+            {
+                push_candidate(edge.first >> 32, edge.first & 0xFFFFFFFF);
+            }
+        }
+
+        size_t face_count() const
+        {
+            return _face_count;
+        }
+
+        // Collapse edges (cheapest first) until at most target_face_count faces remain,
+        // or until no more valid collapses are available.
+        void simplify_to(size_t target_face_count)
+        {
+            while (_face_count > target_face_count && !_queue.empty())
+            {
+                Candidate c = _queue.top();
+                _queue.pop();
+
+                if ( !_vertex_alive[c.u] || !_vertex_alive[c.v]
+                     || _version[c.u] != c.version_u || _version[c.v] != c.version_v )
+                {
+                    continue; // stale
+                }
+
+                if (is_valid_collapse(c.u, c.v, c.position))
+                {
+                    collapse(c.u, c.v, c.position);
+                }
+            }
+        }
+
+        // Write out the current mesh, with unused vertices dropped and the rest renumbered.
+        void extract(std::vector<float> & vertices, std::vector<uint32_t> & faces) const
+        {
+            std::vector<uint32_t> new_indexes(_positions.size(), UINT32_MAX);
+            vertices.clear();
+            faces.clear();
+            for (size_t f = 0; f < _faces.size(); ++f)
+            {
+                if (!_face_alive[f])
+                {
+                    continue;
+                }
+                for (auto v : _faces[f])
+                {
+                    if (new_indexes[v] == UINT32_MAX)
+                    {
+                        new_indexes[v] = vertices.size() / 3;
+                        vertices.push_back(static_cast<float>(_positions[v][0]));
+                        vertices.push_back(static_cast<float>(_positions[v][1]));
+                        vertices.push_back(static_cast<float>(_positions[v][2]));
+                    }
+                    faces.push_back(new_indexes[v]);
+                }
+            }
+        }
+
+    private:
+        // A proposed collapse of vertex v into vertex u, which moves u to 'position'.
+        struct Candidate
+        {
+            double cost;
+            uint32_t u;
+            uint32_t v;
+            uint32_t version_u;
+            uint32_t version_v;
+            std::array<double, 3> position;
+
+            bool operator>(Candidate const & other) const
+            {
+                return cost > other.cost;
+            }
+        };
+
+        static uint64_t edge_key(uint32_t a, uint32_t b)
+        {
+            if (a > b)
+            {
+                std::swap(a, b);
+            }
+            return (uint64_t(a) << 32) | b;
+        }
+
+        // The (non-normalized) normal of a face, i.e. twice its area vector
+        std::array<double, 3> face_normal( std::array<uint32_t, 3> const & face,
+                                           uint32_t moved = UINT32_MAX,
+                                           std::array<double, 3> const & moved_position = {} ) const
+        {
+            auto const & a = (face[0] == moved) ? moved_position : _positions[face[0]];
+            auto const & b = (face[1] == moved) ? moved_position : _positions[face[1]];
+            auto const & c = (face[2] == moved) ? moved_position : _positions[face[2]];
+            std::array<double, 3> u{{ b[0] - a[0], b[1] - a[1], b[2] - a[2] }};
+            std::array<double, 3> w{{ c[0] - a[0], c[1] - a[1], c[2] - a[2] }};
+            return {{ u[1]*w[2] - u[2]*w[1],
+                      u[2]*w[0] - u[0]*w[2],
+                      u[0]*w[1] - u[1]*w[0] }};
+        }
+
+        void push_candidate(uint32_t a, uint32_t b)
+        {
+            // Locked (boundary) vertices never move, but other vertices may be merged into them.
+            if (_locked[a] && _locked[b])
+            {
+                return;
+            }
+            uint32_t u = _locked[b] ? b : a;
+            uint32_t v = (u == a) ? b : a;
+
+            Quadric q = _quadrics[u];
+            q += _quadrics[v];
+
+            Candidate c;
+            c.u = u;
+            c.v = v;
+            c.version_u = _version[u];
+            c.version_v = _version[v];
+
+            if (_locked[u])
+            {
+                c.position = _positions[u];
+                c.cost = q.error(c.position);
+            }
+            else if (q.optimal_position(c.position))
+            {
+                c.cost = q.error(c.position);
+            }
+            else
+            {
+                // Ill-conditioned: Choose the best of the endpoints and the midpoint.
+                auto const & pu = _positions[u];
+                auto const & pv = _positions[v];
+                std::array<std::array<double, 3>, 3> options{{ pu, pv, {{ (pu[0]+pv[0])/2, (pu[1]+pv[1])/2, (pu[2]+pv[2])/2 }} }};
+                c.cost = std::numeric_limits<double>::infinity();
+                for (auto const & option : options)
+                {
+                    double cost = q.error(option);
+                    if (cost < c.cost)
+                    {
+                        c.cost = cost;
+                        c.position = option;
+                    }
+                }
+            }
+
+            _queue.push(c);
+        }
+
+        // Collect the neighbors of a vertex (via its live faces) into a sorted list.
+        void neighbors(uint32_t vertex, std::vector<uint32_t> & result) const
+        {
+            result.clear();
+            for (auto f : _vertex_faces[vertex])
+            {
+                if (!_face_alive[f])
+                {
+                    continue;
+                }
+                for (auto w : _faces[f])
+                {
+                    if (w != vertex)
+                    {
+                        result.push_back(w);
+                    }
+                }
+            }
+            std::sort(result.begin(), result.end());
+            result.erase(std::unique(result.begin(), result.end()), result.end());
+        }
+
+        bool is_valid_collapse(uint32_t u, uint32_t v, std::array<double, 3> const & position)
+        {
+            // Count the faces shared by u and v (i.e. the faces of edge (u,v))
+            size_t shared_faces = 0;
+            for (auto f : _vertex_faces[v])
+            {
+                if (_face_alive[f] && (_faces[f][0] == u || _faces[f][1] == u || _faces[f][2] == u))
+                {
+                    ++shared_faces;
+                }
+            }
+            if (shared_faces == 0)
+            {
+                return false; // The edge no longer exists.
+            }
+
+            // Link condition: The only vertices adjacent to both u and v
+            // must be the opposite corners of the edge's own faces.
+            neighbors(u, _scratch_u);
+            neighbors(v, _scratch_v);
+            _scratch_common.clear();
+            std::set_intersection( _scratch_u.begin(), _scratch_u.end(),
+                                   _scratch_v.begin(), _scratch_v.end(),
+                                   std::back_inserter(_scratch_common) );
+            if (_scratch_common.size() != shared_faces)
+            {
+                return false;
+            }
+
+            // No surviving face may flip (or collapse to zero area).
+            for (uint32_t moved : {u, v})
+            {
+                for (auto f : _vertex_faces[moved])
+                {
+                    auto const & face = _faces[f];
+                    bool has_u = (face[0] == u || face[1] == u || face[2] == u);
+                    bool has_v = (face[0] == v || face[1] == v || face[2] == v);
+                    if (!_face_alive[f] || (has_u && has_v))
+                    {
+                        continue;
+                    }
+
+                    auto before = face_normal(face);
+                    auto after = face_normal(face, moved, position);
+                    double dot = before[0]*after[0] + before[1]*after[1] + before[2]*after[2];
+                    if (dot <= 0.0)
+                    {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        void collapse(uint32_t u, uint32_t v, std::array<double, 3> const & position)
+        {
+            for (auto f : _vertex_faces[v])
+            {
+                if (!_face_alive[f])
+                {
+                    continue;
+                }
+                auto & face = _faces[f];
+                if (face[0] == u || face[1] == u || face[2] == u)
+                {
+                    _face_alive[f] = false;
+                    --_face_count;
+                    continue;
+                }
+                std::replace(face.begin(), face.end(), v, u);
+                _vertex_faces[u].push_back(f);
+            }
+
+            // Drop dead faces from u's list
+            auto & u_faces = _vertex_faces[u];
+            u_faces.erase( std::remove_if( u_faces.begin(), u_faces.end(),
+                                           [&](uint32_t f) { return !_face_alive[f]; } ),
+                           u_faces.end() );
+            std::vector<uint32_t>().swap(_vertex_faces[v]);
+
+            _positions[u] = position;
+            _quadrics[u] += _quadrics[v];
+            _vertex_alive[v] = false;
+            _version[u] += 1;
+
+            neighbors(u, _scratch_u);
+            for (auto w : _scratch_u)
+            {
+                push_candidate(u, w);
+            }
+        }
+
+        std::vector<std::array<double, 3>> _positions;
+        std::vector<Quadric> _quadrics;
+        std::vector<uint32_t> _version;
+        std::vector<bool> _vertex_alive;
+        std::vector<bool> _locked;
+        std::vector<std::vector<uint32_t>> _vertex_faces;
+
+        std::vector<std::array<uint32_t, 3>> _faces;
+        std::vector<bool> _face_alive;
+        size_t _face_count;
+
+        std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> _queue;
+
+        // Scratch space, to avoid reallocating in the inner loop
+        std::vector<uint32_t> _scratch_u;
+        std::vector<uint32_t> _scratch_v;
+        std::vector<uint32_t> _scratch_common;
+    };
+}
+
+#endif
@@ -0,0 +1,188 @@
+#ifndef DVIDUTILS_SMOOTH_MESH_HPP
+#define DVIDUTILS_SMOOTH_MESH_HPP
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#include "parallel.hpp"
+
+using std::size_t;
+using std::uint32_t;
+
+namespace dvidutils
+{
+    // The vertex-to-vertex connectivity of a triangle mesh, in CSR form:
+    // The neighbors of vertex v are neighbors[offsets[v]] ... neighbors[offsets[v+1]-1], in sorted order.
+    struct VertexAdjacency
+    {
+        std::vector<size_t> offsets;
+        std::vector<uint32_t> neighbors;
+
+        // Vertices that lie on an edge used by only one face
+        std::vector<uint8_t> is_boundary;
+    };
+
+    // Build the vertex adjacency of a mesh from its row-major (N,3) faces.
+    //
+    // Each face contributes both of its other corners to each corner's row.
+    // The rows are then sorted and deduplicated in parallel, and any neighbor that
+    // appeared only once in a row marks an edge with only one face, i.e. a boundary edge.
+    VertexAdjacency vertex_adjacency( uint32_t const * faces, size_t face_count, size_t vertex_count, int num_threads )
+    {
+        for (size_t j = 0; j < 3*face_count; ++j)
+        {
+            if (faces[j] >= vertex_count)
+            {
+                throw std::runtime_error("Face indexes exceed vertices length");
+            }
+        }
+
+        // Count the (non-unique) entries of each row, and lay out the rows
+        std::vector<size_t> offsets(vertex_count + 1, 0);
+        for (size_t j = 0; j < 3*face_count; ++j)
+        {
+            offsets[faces[j] + 1] += 2;
+        }
+        for (size_t v = 0; v < vertex_count; ++v)
+        {
+            offsets[v+1] += offsets[v];
+        }
+
+        std::vector<uint32_t> entries(offsets[vertex_count]);
+        {
+            std::vector<size_t> cursors(offsets.begin(), offsets.end() - 1);
+            for (size_t f = 0; f < face_count; ++f)
+            {
+                uint32_t const * face = faces + 3*f;
+                for (int corner = 0; corner < 3; ++corner)
+                {
+                    uint32_t v = face[corner];
+                    entries[cursors[v]++] = face[(corner + 1) % 3];
+                    entries[cursors[v]++] = face[(corner + 2) % 3];
+                }
+            }
+        }
+
+        VertexAdjacency adjacency;
+        adjacency.is_boundary.resize(vertex_count, 0);
+
+        // Sort and deduplicate each row (in place), noting the unique row sizes.
+        size_t const block_size = 16384;
+        size_t num_blocks = (vertex_count + block_size - 1) / block_size;
+        std::vector<size_t> unique_counts(vertex_count + 1, 0);
+        parallel_for(num_blocks, num_threads, [&](size_t block) {
+            size_t end = std::min((block + 1) * block_size, vertex_count);
+            for (size_t v = block * block_size; v < end; ++v)
+            {
+                auto begin = entries.begin() + offsets[v];
+                auto row_end = entries.begin() + offsets[v+1];
+                std::sort(begin, row_end);
+
+                size_t unique_count = 0;
+                for (auto it = begin; it != row_end; )
+                {
+                    auto next = std::find_if(it, row_end, [&](uint32_t n) { return n != *it; });
+                    if (next - it == 1)
+                    {
+                        adjacency.is_boundary[v] = 1;
+                    }
+                    *(begin + unique_count++) = *it;
+                    it = next;
+                }
+                unique_counts[v+1] = unique_count;
+            }
+        });
+
+        // Compact the rows
+        adjacency.offsets.resize(vertex_count + 1, 0);
+        for (size_t v = 0; v < vertex_count; ++v)
+        {
+            adjacency.offsets[v+1] = adjacency.offsets[v] + unique_counts[v+1];
+        }
+        adjacency.neighbors.resize(adjacency.offsets[vertex_count]);
+        parallel_for(num_blocks, num_threads, [&](size_t block) {
+            size_t end = std::min((block + 1) * block_size, vertex_count);
+            for (size_t v = block * block_size; v < end; ++v)
+            {
+                std::copy_n( entries.begin() + offsets[v],
+                             unique_counts[v+1],
+                             adjacency.neighbors.begin() + adjacency.offsets[v] );
+            }
+        });
+
+        return adjacency;
+    }
+
+    // Smooth a row-major (N,3) vertex buffer in place, with Taubin's lambda/mu algorithm.
+    //
+    // Each iteration applies two umbrella-operator (uniform Laplacian) steps:
+    //
+    //     v += lambda * (mean(neighbors of v) - v)
+    //     v += mu * (mean(neighbors of v) - v)
+    //
+    // ...where lambda > 0 smooths and mu < -lambda re-inflates the mesh, so it doesn't shrink.
+    // With mu = 0, this is plain Laplacian smoothing.
+    //
+    // If fix_boundary is true, boundary vertices (see vertex_adjacency()) are not moved.
+    // Isolated vertices (without neighbors) are never moved.
+    //
+    // Each step reads from one buffer and writes to another, so the vertices can be
+    // updated in parallel (in blocks), and the results don't depend on the thread count.
+    void smooth_vertices( float * vertices,
+                          size_t vertex_count,
+                          VertexAdjacency const & adjacency,
+                          int iterations,
+                          float lambda,
+                          float mu,
+                          bool fix_boundary,
+                          int num_threads )
+    {
+        size_t const block_size = 16384;
+        size_t num_blocks = (vertex_count + block_size - 1) / block_size;
+
+        std::vector<float> scratch(3 * vertex_count);
+
+        auto step = [&](float const * src, float * dst, float factor) {
+            parallel_for(num_blocks, num_threads, [&](size_t block) {
+                size_t end = std::min((block + 1) * block_size, vertex_count);
+                for (size_t v = block * block_size; v < end; ++v)
+                {
+                    size_t begin = adjacency.offsets[v];
+                    size_t degree = adjacency.offsets[v+1] - begin;
+                    if (degree == 0 || (fix_boundary && adjacency.is_boundary[v]))
+                    {
+                        std::copy_n(src + 3*v, 3, dst + 3*v);
+                        continue;
+                    }
+
+                    float sum[3] = { 0.0f, 0.0f, 0.0f };
+                    for (size_t k = begin; k < begin + degree; ++k)
+                    {
+                        float const * n = src + 3*size_t(adjacency.neighbors[k]);
+                        sum[0] += n[0];
+                        sum[1] += n[1];
+                        sum[2] += n[2];
+                    }
+
+                    float weight = factor / float(degree);
+                    for (int axis = 0; axis < 3; ++axis)
+                    {
+                        dst[3*v + axis] = src[3*v + axis] + (weight * sum[axis] - factor * src[3*v + axis]);
+                    }
+                }
+            });
+        };
+
+        // Alternate between the two buffers; after each pair of steps,
+        // the result is back in the caller's buffer.
+        for (int i = 0; i < iterations; ++i)
+        {
+            step(vertices, scratch.data(), lambda);
+            step(scratch.data(), vertices, mu);
+        }
+    }
+}
+
+#endif
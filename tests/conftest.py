@@ -0,0 +1,106 @@
+"""
+Mesh fixtures shared by the tests.
+
+The analytic meshes (cube_mesh, uv_sphere_mesh) have known geometry, so tests
+can check results against exact values.  label_sphere_mesh is a marching-cubes
+mesh, for tests that need a realistic (voxelized) surface.
+"""
+import pytest
+import numpy as np
+from dvidutils import meshes_from_labels
+
+
+def _cube_mesh(origin=(0,0,0), size=1.0):
+    """
+    A closed cube, with outward-facing triangles.
+    """
+    vertices = np.array([[0,0,0], [1,0,0], [1,1,0], [0,1,0],
+                         [0,0,1], [1,0,1], [1,1,1], [0,1,1]], np.float32)
+    vertices = (size * vertices + origin).astype(np.float32)
+    faces = np.array([[0,2,1], [0,3,2],  # bottom
+                      [4,5,6], [4,6,7],  # top
+                      [0,1,5], [0,5,4],  # front
+                      [2,3,7], [2,7,6],  # back
+                      [1,2,6], [1,6,5],  # right
+                      [3,0,4], [3,4,7]], # left
+                     np.uint32)
+    return vertices, faces
+
+
+def _uv_sphere_mesh(radius=10.0, center=(0,0,0), rings=32, segments=64):
+    """
+    A closed latitude/longitude sphere, with outward-facing triangles.
+    All vertices lie exactly (up to float32 rounding) on the sphere.
+    """
+    theta = np.pi * np.arange(1, rings) / rings
+    phi = 2 * np.pi * np.arange(segments) / segments
+    t, p = np.meshgrid(theta, phi, indexing='ij')
+    ring_vertices = np.stack([np.sin(t) * np.cos(p), np.sin(t) * np.sin(p), np.cos(t)], axis=-1).reshape(-1, 3)
+    vertices = np.concatenate([[(0,0,1)], ring_vertices, [(0,0,-1)]])
+    vertices = (radius * vertices + center).astype(np.float32)
+
+    # Vertex index of ring r, segment s: 1 + r*segments + s
+    s = np.arange(segments)
+    s1 = (s + 1) % segments
+    north = np.zeros_like(s)
+    south = np.full_like(s, len(vertices) - 1)
+    last_ring = 1 + (rings - 2) * segments
+
+    faces = [np.stack([north, 1 + s, 1 + s1], axis=1)]
+    for r in range(rings - 2):
+        a = 1 + r * segments + s
+        b = 1 + r * segments + s1
+        c = a + segments
+        d = b + segments
+        faces += [np.stack([a, c, d], axis=1), np.stack([a, d, b], axis=1)]
+    faces.append(np.stack([south, last_ring + s1, last_ring + s], axis=1))
+    return vertices, np.concatenate(faces).astype(np.uint32)
+
+
+def _label_sphere_mesh(radius=15, spacing=(1.0, 1.0, 1.0), offset=(0.0, 0.0, 0.0)):
+    """
+    The marching-cubes mesh of a voxelized sphere, centered in a 40**3 volume.
+    """
+    z, y, x = np.ogrid[:40, :40, :40]
+    labels = ((z-20)**2 + (y-20)**2 + (x-20)**2 < radius**2).astype(np.uint64)
+    return meshes_from_labels(labels, [1], spacing=spacing, offset=offset)[1]
+
+
+def _triangle_set(vertices, faces):
+    """
+    The mesh's triangles as a set of vertex-coordinate triples,
+    for comparing meshes regardless of their vertex order.
+    """
+    return set(map(lambda t: tuple(map(tuple, t)), vertices[faces]))
+
+
+@pytest.fixture
+def cube_mesh():
+    """
+    Returns a function cube_mesh(origin=(0,0,0), size=1.0) -> (vertices, faces).
+    """
+    return _cube_mesh
+
+
+@pytest.fixture
+def uv_sphere_mesh():
+    """
+    Returns a function uv_sphere_mesh(radius=10.0, center=(0,0,0), rings=32, segments=64) -> (vertices, faces).
+    """
+    return _uv_sphere_mesh
+
+
+@pytest.fixture
+def label_sphere_mesh():
+    """
+    Returns a function label_sphere_mesh(radius=15, spacing=(1,1,1), offset=(0,0,0)) -> (vertices, faces).
+    """
+    return _label_sphere_mesh
+
+
+@pytest.fixture
+def triangle_set():
+    """
+    Returns a function triangle_set(vertices, faces) -> set of triangles.
+    """
+    return _triangle_set
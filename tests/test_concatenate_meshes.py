@@ -0,0 +1,101 @@
+import pytest
+import numpy as np
+from dvidutils import concatenate_meshes, remap_duplicates, meshes_from_labels
+
+import faulthandler
+faulthandler.enable()
+
+
+def supervoxel_meshes():
+    """
+    Meshes for a handful of touching supervoxels, which share vertices along their boundaries.
+    """
+    z, y, x = np.ogrid[:20, :24, :28]
+    labels = np.zeros((20, 24, 28), np.uint64)
+    labels[2:18, 2:22, 2:26] = 1 + (x[:, :, 2:26] // 6) + 10 * (z[2:18] // 8)
+    meshes = meshes_from_labels(labels)
+    return [(v, np.zeros((0,3), np.float32), f) for (v, f) in meshes.values()]
+
+
+def test_concatenate():
+    meshes = supervoxel_meshes()
+    vertices, normals, faces = concatenate_meshes(meshes, deduplicate=False, num_threads=4)
+
+    assert (vertices == np.concatenate([v for (v, _, _) in meshes])).all()
+    assert normals.shape == (0, 3)
+
+    offsets = np.cumsum([0] + [len(v) for (v, _, _) in meshes])
+    expected_faces = np.concatenate([f + offset for (_, _, f), offset in zip(meshes, offsets)])
+    assert (faces == expected_faces).all()
+
+
+def test_concatenate_deduplicate(triangle_set):
+    meshes = supervoxel_meshes()
+    vertices, _, faces = concatenate_meshes(meshes, num_threads=4)
+    raw_vertices, _, raw_faces = concatenate_meshes(meshes, deduplicate=False)
+
+    # The supervoxels share boundary vertices
+    assert len(vertices) < len(raw_vertices)
+    assert len(np.unique(vertices, axis=0)) == len(vertices)
+    assert faces.max() < len(vertices)
+
+    # Same surviving vertices (in the same order) that remap_duplicates() prescribes
+    duplicates = remap_duplicates(raw_vertices)
+    keep = np.ones(len(raw_vertices), bool)
+    keep[duplicates[:, 0]] = False
+    assert (vertices == raw_vertices[keep]).all()
+
+    assert triangle_set(vertices, faces) == triangle_set(raw_vertices, raw_faces)
+
+    single_vertices, _, single_faces = concatenate_meshes(meshes, num_threads=1)
+    assert (single_vertices == vertices).all()
+    assert (single_faces == faces).all()
+
+
+def test_concatenate_normals():
+    vertices = np.array([[0,0,0], [1,0,0], [0,1,0]], np.float32)
+    normals = np.array([[0,0,1], [0,0,1], [0,0,1]], np.float32)
+    faces = np.array([[0,1,2]], np.uint32)
+
+    other_vertices = vertices + [1,0,0]
+    other_normals = -normals
+    meshes = [(vertices, normals, faces), (other_vertices, other_normals, faces)]
+
+    combined_vertices, combined_normals, combined_faces = concatenate_meshes(meshes)
+    assert len(combined_vertices) == 5
+    assert combined_normals.shape == (5, 3)
+
+    # Vertex [1,0,0] appears in both meshes; the first one's normal wins.
+    assert (combined_normals[1] == [0,0,1]).all()
+    assert (combined_faces == [[0,1,2], [1,3,4]]).all()
+
+    # If any mesh lacks normals, none are returned.
+    meshes.append((vertices, np.zeros((0,3), np.float32), faces))
+    _, combined_normals, _ = concatenate_meshes(meshes)
+    assert combined_normals.shape == (0, 3)
+
+
+def test_concatenate_bad_mesh():
+    vertices = np.array([[0,0,0], [1,0,0], [0,1,0]], np.float32)
+    faces = np.array([[0,1,3]], np.uint32)
+    with pytest.raises(RuntimeError):
+        concatenate_meshes([(vertices, np.zeros((0,3), np.float32), faces)])
+
+    with pytest.raises(RuntimeError):
+        concatenate_meshes([(vertices, np.zeros((2,3), np.float32), faces[:, [0,1,1]])])
+
+
+def test_concatenate_wrong_column_count():
+    vertices = np.array([[0,0,0], [1,0,0], [0,1,0]], np.float32)
+    faces = np.array([[0,1,2]], np.uint32)
+    empty_normals = np.zeros((0,3), np.float32)
+    with pytest.raises(RuntimeError):
+        concatenate_meshes([(np.ascontiguousarray(vertices[:, :2]), empty_normals, faces)])
+    with pytest.raises(RuntimeError):
+        concatenate_meshes([(vertices, empty_normals, np.ascontiguousarray(faces[:, :2]))])
+    with pytest.raises(RuntimeError):
+        concatenate_meshes([(vertices, np.zeros((3,2), np.float32), faces)])
+
+
+if __name__ == "__main__":
+    pytest.main()
@@ -0,0 +1,127 @@
+from concurrent.futures import ThreadPoolExecutor
+
+import pytest
+import numpy as np
+from dvidutils import ( DracoCodec, DracoBuffer, encode_faces_to_drc_bytes, encode_faces_to_custom_drc_bytes,
+                        decode_drc_bytes_to_faces, compute_vertex_normals )
+
+import faulthandler
+faulthandler.enable()
+
+EMPTY_NORMALS = np.zeros((0,3), np.float32)
+
+
+@pytest.fixture
+def sphere_meshes(label_sphere_mesh):
+    """
+    Meshes of a few spheres of different sizes,
+    so consecutive calls must grow (and shrink) the codec's buffers.
+    """
+    meshes = []
+    for radius in (15, 5, 10):
+        vertices, faces = label_sphere_mesh(radius)
+        meshes.append((vertices, compute_vertex_normals(vertices, faces), faces))
+    return meshes
+
+
+def test_settings():
+    codec = DracoCodec(compression_level=5, position_quantization_bits=12)
+    assert codec.compression_level == 5
+    assert codec.position_quantization_bits == 12
+    assert not codec.compute_normals
+
+
+def test_encode(sphere_meshes):
+    codec = DracoCodec(compression_level=5, position_quantization_bits=12)
+    for vertices, normals, faces in sphere_meshes:
+        expected = encode_faces_to_drc_bytes(vertices, normals, faces, compression_level=5, position_quantization_bits=12)
+        assert codec.encode(vertices, normals, faces) == expected
+
+        # Non-contiguous input is handled via the codec's scratch space
+        expected = encode_faces_to_drc_bytes(vertices[:, ::-1], EMPTY_NORMALS, faces[:, ::-1],
+                                             compression_level=5, position_quantization_bits=12)
+        assert codec.encode(vertices[:, ::-1], EMPTY_NORMALS, faces[:, ::-1]) == expected
+
+    assert codec.encode(vertices, normals, faces[:0]) == b''
+
+
+def test_encode_custom(sphere_meshes):
+    codec = DracoCodec()
+    fragment_shape = np.array([64, 64, 64], np.int32)
+    fragment_origin = np.array([-10, -10, -10], np.int32)
+    for vertices, normals, faces in sphere_meshes:
+        expected = encode_faces_to_custom_drc_bytes(vertices, normals, faces, fragment_shape, fragment_origin)
+        assert codec.encode_custom(vertices, normals, faces, fragment_shape, fragment_origin) == expected
+
+
+def test_compute_normals(sphere_meshes):
+    codec = DracoCodec(compute_normals=True)
+    vertices, _, faces = sphere_meshes[0]
+    drc = codec.encode(vertices, EMPTY_NORMALS, faces)
+    assert drc == encode_faces_to_drc_bytes(vertices, EMPTY_NORMALS, faces, compute_normals=True)
+
+
+def test_decode(sphere_meshes):
+    codec = DracoCodec()
+    for vertices, normals, faces in sphere_meshes:
+        drc = codec.encode(vertices, normals, faces)
+        for deduplicate in (True, False):
+            decoded = codec.decode(drc, deduplicate=deduplicate)
+            expected = decode_drc_bytes_to_faces(drc, deduplicate=deduplicate)
+            for a, b in zip(decoded, expected):
+                assert (a == b).all()
+
+    v, n, f = codec.decode(b'')
+    assert v.shape == n.shape == f.shape == (0, 3)
+
+
+def test_options(sphere_meshes):
+    # The codec accepts the same options as the module functions, with the same results.
+    codec = DracoCodec()
+    fragment_shape = np.array([64, 64, 64], np.int32)
+    fragment_origin = np.array([-10, -10, -10], np.int32)
+    for vertices, normals, faces in sphere_meshes:
+        attributes = { 'id': np.arange(len(vertices), dtype=np.uint32),
+                       'distance': np.linalg.norm(vertices - 20, axis=1).astype(np.float32) }
+
+        expected = encode_faces_to_drc_bytes(vertices, normals, faces, attributes=attributes)
+        assert codec.encode(vertices, normals, faces, attributes=attributes) == expected
+
+        buf = codec.encode(vertices, normals, faces, return_buffer=True, attributes=attributes)
+        assert isinstance(buf, DracoBuffer)
+        assert bytes(buf) == expected
+
+        # The returned buffer is not the codec's own, so it survives the next call.
+        codec.encode(*sphere_meshes[1])
+        assert bytes(buf) == expected
+
+        decoded = codec.decode(expected, return_attributes=True)
+        expected_decoded = decode_drc_bytes_to_faces(expected, return_attributes=True)
+        for a, b in zip(decoded[:3], expected_decoded[:3]):
+            assert (a == b).all()
+        assert sorted(decoded[3].keys()) == sorted(attributes.keys())
+        for name in attributes:
+            assert decoded[3][name].dtype == attributes[name].dtype
+            assert (decoded[3][name] == expected_decoded[3][name]).all()
+
+        expected = encode_faces_to_custom_drc_bytes(vertices, normals, faces, fragment_shape, fragment_origin,
+                                                    attributes=attributes)
+        buf = codec.encode_custom(vertices, normals, faces, fragment_shape, fragment_origin,
+                                  return_buffer=True, attributes=attributes)
+        assert bytes(buf) == expected
+
+
+def test_threads(sphere_meshes):
+    meshes = sphere_meshes * 4
+    expected = [encode_faces_to_drc_bytes(*mesh) for mesh in meshes]
+
+    # One codec per thread is the intended use,
+    # but a shared codec must still produce correct results.
+    shared_codec = DracoCodec()
+    with ThreadPoolExecutor(4) as executor:
+        results = list(executor.map(lambda mesh: shared_codec.encode(*mesh), meshes))
+    assert results == expected
+
+
+if __name__ == "__main__":
+    pytest.main()
@@ -0,0 +1,90 @@
+import pytest
+import numpy as np
+from dvidutils import ( encode_faces_to_drc_bytes, encode_faces_to_custom_drc_bytes, decode_drc_bytes_to_faces,
+                        inspect_drc_bytes, inspect_many_drc_bytes, compute_vertex_normals )
+
+import faulthandler
+faulthandler.enable()
+
+
+# The fragment origin in test_inspect_custom() assumes the mesh lies near this offset.
+SPHERE_OFFSET = (100.0, 200.0, 300.0)
+
+
+@pytest.mark.parametrize('compression_level, encoding_method', [(0, 'sequential'), (7, 'edgebreaker')])
+def test_inspect(compression_level, encoding_method, label_sphere_mesh):
+    vertices, faces = label_sphere_mesh(offset=SPHERE_OFFSET)
+    drc = encode_faces_to_drc_bytes(vertices, np.zeros((0,3), np.float32), faces, compression_level)
+
+    info = inspect_drc_bytes(drc)
+    assert info['geometry_type'] == 'triangular_mesh'
+    assert info['encoding_method'] == encoding_method
+    assert info['version'][0] >= 2
+    assert not info['has_metadata']
+    assert 'attributes' not in info
+
+    decoded_vertices, _, decoded_faces = decode_drc_bytes_to_faces(drc, deduplicate=False)
+    assert info['point_count'] == len(decoded_vertices)
+    assert info['face_count'] == len(decoded_faces)
+
+
+def test_inspect_attributes(label_sphere_mesh):
+    vertices, faces = label_sphere_mesh(offset=SPHERE_OFFSET)
+    normals = compute_vertex_normals(vertices, faces)
+    drc = encode_faces_to_drc_bytes(vertices, normals, faces, position_quantization_bits=12)
+
+    info = inspect_drc_bytes(drc, attributes=True)
+    types = [att['type'] for att in info['attributes']]
+    assert sorted(types) == ['normal', 'position']
+
+    position = info['attributes'][types.index('position')]
+    assert position['num_components'] == 3
+    assert position['quantization_bits'] == 12
+
+    origin = np.array(position['quantization_origin'])
+    assert (origin <= vertices.min(axis=0)).all()
+    assert (origin + position['quantization_range'] >= vertices.max(axis=0)).all()
+
+    # The bounds are those of the decoded vertices, which lie within the quantization box.
+    decoded_vertices, _, _ = decode_drc_bytes_to_faces(drc)
+    lower, upper = map(np.array, info['bounds'])
+    assert (lower == decoded_vertices.min(axis=0)).all()
+    assert (upper == decoded_vertices.max(axis=0)).all()
+    assert (lower >= origin).all()
+    assert (upper <= origin + position['quantization_range'] + 1e-3).all()
+
+
+def test_inspect_custom(label_sphere_mesh):
+    vertices, faces = label_sphere_mesh(offset=SPHERE_OFFSET)
+    fragment_shape = np.array([64, 64, 64], np.int32)
+    fragment_origin = np.array([90, 190, 290], np.int32)
+    drc = encode_faces_to_custom_drc_bytes(vertices, np.zeros((0,3), np.float32), faces, fragment_shape, fragment_origin)
+
+    # Custom positions are quantized by us, not by draco
+    info = inspect_drc_bytes(drc, attributes=True)
+    position, = info['attributes']
+    assert position['data_type'] == 'uint32'
+    assert 'quantization_bits' not in position
+
+    q_vertices, _, _ = decode_drc_bytes_to_faces(drc)
+    lower, upper = map(np.array, info['bounds'])
+    assert (lower == q_vertices.min(axis=0)).all()
+    assert (upper == q_vertices.max(axis=0)).all()
+
+
+def test_inspect_many(label_sphere_mesh):
+    vertices, faces = label_sphere_mesh(offset=SPHERE_OFFSET)
+    drcs = [ encode_faces_to_drc_bytes(vertices, np.zeros((0,3), np.float32), faces[:n])
+             for n in (len(faces), 100, 0) ]
+
+    infos = inspect_many_drc_bytes(drcs, num_threads=4)
+    assert [info['face_count'] for info in infos] == [len(faces), 100, 0]
+    assert infos[2]['geometry_type'] is None
+    assert infos[:2] == [inspect_drc_bytes(drc) for drc in drcs[:2]]
+
+    with pytest.raises(RuntimeError):
+        inspect_many_drc_bytes(drcs + [b'not a draco buffer'])
+
+
+if __name__ == "__main__":
+    pytest.main()
@@ -0,0 +1,151 @@
+import pytest
+import numpy as np
+from dvidutils import ( encode_points_to_drc_bytes, encode_many_points_to_drc_bytes,
+                        decode_drc_bytes_to_points, decode_many_drc_bytes_to_points,
+                        decode_drc_bytes_to_faces, encode_faces_to_drc_bytes )
+
+import faulthandler
+faulthandler.enable()
+
+
+def random_points(count, seed=0):
+    return np.random.RandomState(seed).uniform(0, 1000, (count, 3)).astype(np.float32)
+
+
+def sort_rows(*arrays):
+    """
+    Sort the given arrays (which have the same number of rows) by the rows of the first one.
+    (The kd-tree encoding doesn't preserve the point order.)
+    """
+    order = np.lexsort(arrays[0].T[::-1])
+    return [a[order] for a in arrays]
+
+
+def test_roundtrip():
+    points = random_points(1000)
+    drc = encode_points_to_drc_bytes(points, position_quantization_bits=0)
+    decoded, attributes = decode_drc_bytes_to_points(drc)
+    assert attributes == {}
+    assert decoded.dtype == np.float32
+    assert (sort_rows(decoded)[0] == sort_rows(points)[0]).all()
+
+
+def test_quantized():
+    points = random_points(1000)
+    drc = encode_points_to_drc_bytes(points, position_quantization_bits=14)
+    decoded, _ = decode_drc_bytes_to_points(drc)
+    assert decoded.shape == points.shape
+
+    # Compare each decoded point with its nearest input point
+    dists = np.linalg.norm(decoded[:, None, :] - points[None, :, :], axis=2).min(axis=1)
+    assert dists.max() <= 1000 / 2**14 * np.sqrt(3)
+
+    # Smaller than the raw points
+    assert len(drc) < points.nbytes
+
+
+def test_preserve_order():
+    points = random_points(1000)
+    ids = np.arange(1000, dtype=np.uint32)
+    drc = encode_points_to_drc_bytes(points, {'id': ids}, position_quantization_bits=0, preserve_order=True)
+    decoded, attributes = decode_drc_bytes_to_points(drc)
+    assert (decoded == points).all()
+    assert (attributes['id'] == ids).all()
+
+
+def test_attributes():
+    points = random_points(500)
+    rng = np.random.RandomState(1)
+    attributes = {
+        'supervoxel': rng.randint(0, 2**62, 500, dtype=np.uint64),
+        'confidence': rng.uniform(0, 1, 500).astype(np.float32),
+        'radius': rng.uniform(0, 1, (500, 2)).astype(np.float32),
+        'kind': rng.randint(0, 5, 500).astype(np.uint8),
+        'offset': rng.randint(-1000, 1000, (500, 3)).astype(np.int32),
+        'flag': rng.randint(0, 2, 500).astype(bool),
+    }
+    # Float attributes aren't quantized by default.
+    drc = encode_points_to_drc_bytes(points, attributes, position_quantization_bits=0)
+    decoded, decoded_attributes = decode_drc_bytes_to_points(drc)
+    assert sorted(decoded_attributes.keys()) == sorted(attributes.keys())
+
+    order = np.lexsort(points.T[::-1])
+    decoded_order = np.lexsort(decoded.T[::-1])
+    for name, values in attributes.items():
+        decoded_values = decoded_attributes[name]
+        assert decoded_values.dtype == values.dtype, name
+        assert decoded_values.shape == values.shape, name
+        assert (decoded_values[decoded_order] == values[order]).all(), name
+
+
+def test_quantized_attributes():
+    points = random_points(500)
+    confidence = np.random.RandomState(1).uniform(0, 1, 500).astype(np.float32)
+    drc = encode_points_to_drc_bytes(points, {'confidence': confidence},
+                                     position_quantization_bits=0, generic_quantization_bits=10)
+    decoded, attributes = decode_drc_bytes_to_points(drc)
+    decoded, decoded_confidence = sort_rows(decoded, attributes['confidence'])
+    _, confidence = sort_rows(points, confidence)
+    assert np.abs(decoded_confidence - confidence).max() < 2 / 2**10
+
+
+def test_bad_attributes():
+    points = random_points(10)
+    with pytest.raises(RuntimeError):
+        encode_points_to_drc_bytes(points, {'x': np.zeros(9, np.float32)})
+    with pytest.raises(RuntimeError):
+        encode_points_to_drc_bytes(points, {'x': np.zeros(10, np.float64)})
+
+
+def test_wrong_column_count():
+    # (N,2) points must be rejected, not read as if they had 3 columns.
+    points = np.ascontiguousarray(random_points(10)[:, :2])
+    with pytest.raises(RuntimeError):
+        encode_points_to_drc_bytes(points)
+    with pytest.raises(RuntimeError):
+        encode_many_points_to_drc_bytes([random_points(10), points])
+
+
+def test_empty():
+    assert encode_points_to_drc_bytes(np.zeros((0,3), np.float32)) == b''
+    points, attributes = decode_drc_bytes_to_points(b'')
+    assert points.shape == (0,3)
+    assert attributes == {}
+
+
+def test_mesh_buffer():
+    # The vertices of a mesh can be decoded as points
+    vertices = random_points(4)
+    faces = np.array([[0,1,2], [0,2,3]], np.uint32)
+    drc = encode_faces_to_drc_bytes(vertices, np.zeros((0,3), np.float32), faces, position_quantization_bits=0)
+    points, _ = decode_drc_bytes_to_points(drc)
+    assert (sort_rows(points)[0] == sort_rows(vertices)[0]).all()
+
+    # But point clouds can't be decoded as meshes
+    with pytest.raises(RuntimeError):
+        decode_drc_bytes_to_faces(encode_points_to_drc_bytes(vertices))
+
+
+def test_many():
+    points_list = [random_points(n, seed=n) for n in (100, 0, 2000, 10)]
+    attributes_list = [{'id': np.arange(len(p), dtype=np.uint64)} for p in points_list]
+
+    drcs = encode_many_points_to_drc_bytes(points_list, attributes_list, num_threads=4, position_quantization_bits=0)
+    assert drcs == [encode_points_to_drc_bytes(p, a, position_quantization_bits=0)
+                    for p, a in zip(points_list, attributes_list)]
+
+    results = decode_many_drc_bytes_to_points(drcs, num_threads=4)
+    assert len(results) == len(points_list)
+    for (decoded, attributes), points in zip(results, points_list):
+        if len(points) == 0:
+            assert decoded.shape == (0,3)
+            continue
+        assert (decoded == points[attributes['id']]).all()
+
+    # Attributes are optional
+    drcs = encode_many_points_to_drc_bytes(points_list, num_threads=4)
+    assert [decode_drc_bytes_to_points(drc)[0].shape for drc in drcs] == [p.shape for p in points_list]
+
+
+if __name__ == "__main__":
+    pytest.main()
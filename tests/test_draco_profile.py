@@ -0,0 +1,73 @@
+import itertools
+
+import pytest
+import numpy as np
+from dvidutils import ( profile_drc_settings, choose_drc_settings, encode_faces_to_drc_bytes,
+                        compute_vertex_normals )
+
+import faulthandler
+faulthandler.enable()
+
+
+@pytest.fixture
+def sphere_mesh(label_sphere_mesh):
+    vertices, faces = label_sphere_mesh(spacing=(8.0, 8.0, 8.0))
+    return vertices, compute_vertex_normals(vertices, faces), faces
+
+
+def test_profile(sphere_mesh):
+    vertices, normals, faces = sphere_mesh
+    grid = [ {'compression_level': level, 'position_quantization_bits': bits}
+             for level, bits in itertools.product([0, 7], [8, 14]) ]
+
+    profiles = profile_drc_settings(vertices, normals, faces, grid, repeats=2)
+    assert len(profiles) == len(grid)
+
+    for settings, profile in zip(grid, profiles):
+        for key, value in settings.items():
+            assert profile[key] == value
+        assert profile['normal_quantization_bits'] == 10
+
+        drc = encode_faces_to_drc_bytes(vertices, normals, faces, **settings)
+        assert profile['encoded_bytes'] == len(drc)
+        assert profile['encode_seconds'] > 0
+        assert profile['decode_seconds'] > 0
+
+        # Positions are rounded to the nearest quantization step (along each axis)
+        extent = (vertices.max(axis=0) - vertices.min(axis=0)).max()
+        step = extent / (2**settings['position_quantization_bits'] - 1)
+        assert 0 < profile['max_error'] <= 1.01 * np.sqrt(3) * step / 2
+
+    # More bits: larger, but more accurate
+    assert profiles[1]['encoded_bytes'] > profiles[0]['encoded_bytes']
+    assert profiles[1]['max_error'] < profiles[0]['max_error']
+
+    with pytest.raises(RuntimeError):
+        profile_drc_settings(vertices, normals, faces, [{'compression_levle': 5}])
+
+    # An (N,2) array must be rejected, not read as if it had 3 columns.
+    with pytest.raises(RuntimeError):
+        profile_drc_settings(np.ascontiguousarray(vertices[:, :2]), normals, faces, grid[:1])
+    with pytest.raises(RuntimeError):
+        profile_drc_settings(vertices, normals, np.ascontiguousarray(faces[:, :2]), grid[:1])
+
+
+def test_choose():
+    profiles = [ {'compression_level': 0, 'encoded_bytes': 1000, 'encode_seconds': 1.0, 'decode_seconds': 1.0, 'max_error': 0.1},
+                 {'compression_level': 7, 'encoded_bytes': 500,  'encode_seconds': 3.0, 'decode_seconds': 2.0, 'max_error': 0.1},
+                 {'compression_level': 7, 'encoded_bytes': 200,  'encode_seconds': 3.0, 'decode_seconds': 2.0, 'max_error': 1.0},
+                 {'compression_level': 5, 'encoded_bytes': 600,  'encode_seconds': 0.5, 'decode_seconds': 3.0, 'max_error': 0.1} ]
+
+    assert choose_drc_settings(profiles) is profiles[0]
+    assert choose_drc_settings(profiles, max_bytes=800) is profiles[2]
+    assert choose_drc_settings(profiles, max_bytes=800, max_error=0.5) is profiles[1]
+    assert choose_drc_settings(profiles, objective='encode') is profiles[3]
+    assert choose_drc_settings(profiles, objective='total') is profiles[0]
+    assert choose_drc_settings(profiles, max_bytes=100) is None
+
+    with pytest.raises(RuntimeError):
+        choose_drc_settings(profiles, objective='fastest')
+
+
+if __name__ == "__main__":
+    pytest.main()
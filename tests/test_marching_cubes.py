@@ -0,0 +1,132 @@
+import pytest
+import numpy as np
+from dvidutils import meshes_from_labels, encode_faces_to_drc_bytes, decode_drc_bytes_to_faces
+
+import faulthandler
+faulthandler.enable()
+
+
+def label_volume():
+    """
+    A sphere split into two labels, plus a speckled slab touching the volume border.
+    """
+    z, y, x = np.ogrid[:30, :34, :40]
+    labels = np.zeros((30, 34, 40), np.uint64)
+    sphere = (z-15)**2 + (y-17)**2 + (x-20)**2 < 10**2
+    labels[sphere & (x < 20)] = 7
+    labels[sphere & (x >= 20)] = 9
+    labels[:, :, 37:] = np.where((z + y + x)[:, :, 37:] % 3, 3, 5)
+    return labels
+
+
+def signed_volume(vertices, faces):
+    triangles = vertices[faces].astype(np.float64)
+    return np.einsum('ij,ij->i', triangles[:,0], np.cross(triangles[:,1], triangles[:,2])).sum() / 6
+
+
+def check_closed(faces):
+    # Every directed edge appears exactly once, and so does its reverse.
+    edges = np.concatenate([faces[:, [0,1]], faces[:, [1,2]], faces[:, [2,0]]])
+    unique_edges = set(map(tuple, edges))
+    assert len(unique_edges) == len(edges)
+    assert unique_edges == set(map(tuple, edges[:, ::-1]))
+
+
+def test_meshes_from_labels():
+    labels = label_volume()
+    meshes = meshes_from_labels(labels, num_threads=4)
+    assert sorted(meshes.keys()) == [3, 5, 7, 9]
+
+    for label, (vertices, faces) in meshes.items():
+        assert vertices.dtype == np.float32
+        assert faces.dtype == np.uint32
+        assert faces.max() < len(vertices)
+        check_closed(faces)
+
+        # Outward-facing, and roughly the size of the label
+        volume = signed_volume(vertices, faces)
+        assert 0 < volume <= (labels == label).sum()
+
+        # Vertices are shared, not duplicated
+        assert len(np.unique(vertices, axis=0)) == len(vertices)
+
+    # Same result with any number of threads
+    single_meshes = meshes_from_labels(labels, num_threads=1)
+    for label, (vertices, faces) in meshes.items():
+        single_vertices, single_faces = single_meshes[label]
+        assert (single_vertices == vertices).all()
+        assert (single_faces == faces).all()
+
+
+def test_meshes_from_labels_spacing():
+    labels = label_volume()
+    spacing = (2.0, 3.0, 4.0)
+    offset = (10.0, 20.0, 30.0)
+    meshes = meshes_from_labels(labels, [9, 7], spacing, offset)
+    assert list(meshes.keys()) == [9, 7]
+
+    unit_meshes = meshes_from_labels(labels, [9, 7])
+    for label in (7, 9):
+        vertices, faces = meshes[label]
+        unit_vertices, unit_faces = unit_meshes[label]
+        assert (faces == unit_faces).all()
+        assert np.allclose(vertices, unit_vertices * spacing + offset)
+
+
+def test_meshes_from_labels_axis_order():
+    # A box spanning 4 voxels in z, 6 in y and 10 in x
+    labels = np.zeros((8, 10, 14), np.uint64)
+    labels[2:6, 2:8, 2:12] = 1
+    spacing = (1.0, 2.0, 3.0)
+    offset = (100.0, 200.0, 300.0)
+
+    # By default, vertices are (x, y, z), as are spacing and offset.
+    vertices, faces = meshes_from_labels(labels, [1], spacing, offset)[1]
+    assert np.allclose(vertices.min(axis=0), np.array([1.5, 1.5, 1.5]) * spacing + offset)
+    assert np.allclose(vertices.max(axis=0), np.array([11.5, 7.5, 5.5]) * spacing + offset)
+    assert signed_volume(vertices, faces) > 0
+
+    # With zyx order, the columns are reversed, and so is the winding.
+    zyx_vertices, zyx_faces = meshes_from_labels(labels, [1], spacing[::-1], offset[::-1], axis_order='zyx')[1]
+    assert (zyx_vertices[:, ::-1] == vertices).all()
+    assert (zyx_faces[:, [0,2,1]] == faces).all()
+    assert signed_volume(zyx_vertices, zyx_faces) > 0
+
+    with pytest.raises(RuntimeError):
+        meshes_from_labels(labels, [1], axis_order='yxz')
+
+
+def test_meshes_from_labels_encode():
+    # The output can be encoded directly, and is still outward-facing in xyz.
+    labels = label_volume()
+    vertices, faces = meshes_from_labels(labels, [7], spacing=(4.0, 4.0, 8.0))[7]
+    assert signed_volume(vertices, faces) > 0
+
+    drc = encode_faces_to_drc_bytes(vertices, np.zeros((0,3), np.float32), faces)
+    decoded_vertices, _, decoded_faces = decode_drc_bytes_to_faces(drc)
+    assert len(decoded_faces) == len(faces)
+    assert np.isclose(signed_volume(decoded_vertices, decoded_faces), signed_volume(vertices, faces), rtol=0.01)
+
+
+def test_meshes_from_labels_missing_label():
+    labels = label_volume()
+    meshes = meshes_from_labels(labels, [7, 12345])
+    vertices, faces = meshes[12345]
+    assert vertices.shape == (0, 3)
+    assert faces.shape == (0, 3)
+
+    with pytest.raises(RuntimeError):
+        meshes_from_labels(labels, [0])
+
+
+def test_meshes_from_labels_noncontiguous():
+    labels = label_volume()
+    transposed = labels.transpose(2, 1, 0)
+    meshes = meshes_from_labels(transposed, [7])
+    copied_meshes = meshes_from_labels(transposed.copy(), [7])
+    assert (meshes[7][0] == copied_meshes[7][0]).all()
+    assert (meshes[7][1] == copied_meshes[7][1]).all()
+
+
+if __name__ == "__main__":
+    pytest.main()
@@ -0,0 +1,89 @@
+import pytest
+import numpy as np
+from dvidutils import mesh_components, remove_small_components, meshes_from_labels, concatenate_meshes
+
+import faulthandler
+faulthandler.enable()
+
+
+def specks_mesh():
+    """
+    One big sphere and a few single-voxel specks, as a single mesh.
+    Returns (vertices, faces, face counts of the separate meshes).
+    """
+    z, y, x = np.ogrid[:40, :40, :40]
+    labels = ((z-20)**2 + (y-20)**2 + (x-20)**2 < 12**2).astype(np.uint64)
+    labels[2, 2, 2] = 2
+    labels[2, 37, 2] = 3
+    labels[37, 37, 37] = 4
+
+    meshes = meshes_from_labels(labels)
+    parts = [meshes[label] for label in sorted(meshes)]
+    vertices, _, faces = concatenate_meshes([(v, np.zeros((0,3), np.float32), f) for v, f in parts], deduplicate=False)
+    return vertices, faces, [len(f) for _, f in parts]
+
+
+def test_mesh_components():
+    vertices, faces, face_counts = specks_mesh()
+    vertex_labels, face_labels = mesh_components(faces, num_threads=4)
+
+    assert vertex_labels.shape == (len(vertices),)
+    assert face_labels.shape == (len(faces),)
+
+    # Each input mesh is one component, numbered in order of its first vertex
+    expected = np.repeat(np.arange(len(face_counts)), face_counts)
+    assert (face_labels == expected).all()
+    assert (vertex_labels[faces] == face_labels[:, None]).all()
+
+    # Deterministic, regardless of thread count
+    single_vertex_labels, single_face_labels = mesh_components(faces, num_threads=1)
+    assert (single_vertex_labels == vertex_labels).all()
+    assert (single_face_labels == face_labels).all()
+
+    # Unused vertices are components of their own
+    vertex_labels, _ = mesh_components(faces, vertex_count=len(vertices) + 2)
+    assert vertex_labels[-2:].tolist() == [len(face_counts), len(face_counts) + 1]
+
+
+def test_remove_small_components():
+    vertices, faces, face_counts = specks_mesh()
+    big_faces = face_counts[0]
+    assert all(n < big_faces for n in face_counts[1:])
+
+    kept_vertices, kept_faces = remove_small_components(vertices, faces, min_faces=big_faces, num_threads=4)
+    assert len(kept_faces) == big_faces
+    assert kept_faces.max() == len(kept_vertices) - 1
+
+    # The kept mesh is identical to the big sphere on its own
+    sphere_vertex_count = faces[:big_faces].max() + 1
+    assert (kept_vertices == vertices[:sphere_vertex_count]).all()
+    assert (kept_faces == faces[:big_faces]).all()
+
+    # Nothing removed
+    all_vertices, all_faces = remove_small_components(vertices, faces, min_faces=1)
+    assert (all_vertices == vertices).all() and (all_faces == faces).all()
+
+    # Everything removed
+    no_vertices, no_faces = remove_small_components(vertices, faces, min_faces=len(faces) + 1)
+    assert no_vertices.shape == no_faces.shape == (0, 3)
+
+
+def test_bad_faces():
+    faces = np.array([[0,1,2]], np.uint32)
+    with pytest.raises(RuntimeError):
+        mesh_components(faces, vertex_count=2)
+
+
+def test_wrong_column_count():
+    vertices = np.array([[0,0,0], [1,0,0], [0,1,0]], np.float32)
+    faces = np.array([[0,1,2]], np.uint32)
+    with pytest.raises(RuntimeError):
+        mesh_components(np.ascontiguousarray(faces[:, :2]))
+    with pytest.raises(RuntimeError):
+        remove_small_components(np.ascontiguousarray(vertices[:, :2]), faces, min_faces=1)
+    with pytest.raises(RuntimeError):
+        remove_small_components(vertices, np.ascontiguousarray(faces[:, :2]), min_faces=1)
+
+
+if __name__ == "__main__":
+    pytest.main()
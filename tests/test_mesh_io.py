@@ -0,0 +1,132 @@
+import struct
+import pytest
+import numpy as np
+from dvidutils import ( encode_faces_to_ngmesh_bytes, decode_ngmesh_bytes,
+                        encode_faces_to_ply_bytes, decode_ply_bytes,
+                        encode_faces_to_obj_bytes, decode_obj_bytes,
+                        compute_vertex_normals )
+
+import faulthandler
+faulthandler.enable()
+
+
+@pytest.fixture
+def sphere_mesh(label_sphere_mesh):
+    vertices, faces = label_sphere_mesh(spacing=(1.1, 1.3, 0.7), offset=(0.1, 0.0, 0.0))
+    normals = compute_vertex_normals(vertices, faces)
+    return vertices, normals, faces
+
+
+EMPTY_NORMALS = np.zeros((0,3), np.float32)
+
+
+def test_ngmesh(sphere_mesh):
+    vertices, normals, faces = sphere_mesh
+    ngmesh = encode_faces_to_ngmesh_bytes(vertices, normals, faces)
+
+    # uint32 vertex count, then vertices, then faces
+    assert struct.unpack_from('<I', ngmesh)[0] == len(vertices)
+    assert len(ngmesh) == 4 + vertices.nbytes + faces.nbytes
+
+    decoded_vertices, decoded_normals, decoded_faces = decode_ngmesh_bytes(ngmesh)
+    assert (decoded_vertices == vertices).all()
+    assert (decoded_faces == faces).all()
+    assert decoded_normals.shape == (0, 3)
+
+    with pytest.raises(RuntimeError):
+        decode_ngmesh_bytes(ngmesh[:-1])
+
+
+@pytest.mark.parametrize('with_normals', [False, True])
+def test_ply(with_normals, sphere_mesh):
+    vertices, normals, faces = sphere_mesh
+    if not with_normals:
+        normals = EMPTY_NORMALS
+
+    ply = encode_faces_to_ply_bytes(vertices, normals, faces)
+    assert ply.startswith(b'ply\nformat binary_little_endian 1.0\n')
+
+    decoded_vertices, decoded_normals, decoded_faces = decode_ply_bytes(ply)
+    assert (decoded_vertices == vertices).all()
+    assert (decoded_normals == normals).all()
+    assert (decoded_faces == faces).all()
+
+
+def test_ply_foreign():
+    # Big-endian, double-precision positions, an extra property and element, and a quad.
+    header = ( b'ply\nformat binary_big_endian 1.0\ncomment test\n'
+               b'element vertex 4\nproperty double x\nproperty double y\nproperty double z\nproperty uchar red\n'
+               b'element face 1\nproperty list uchar int vertex_indices\n'
+               b'element edge 1\nproperty int vertex1\nproperty int vertex2\n'
+               b'end_header\n' )
+    vertices = np.array([[0,0,0], [1,0,0], [1,1,0], [0,1,0]], np.float32)
+    data = b''.join(struct.pack('>dddB', *v, 255) for v in vertices)
+    data += struct.pack('>Biiii', 4, 0, 1, 2, 3)
+    data += struct.pack('>ii', 0, 2)
+
+    decoded_vertices, decoded_normals, decoded_faces = decode_ply_bytes(header + data)
+    assert (decoded_vertices == vertices).all()
+    assert decoded_normals.shape == (0, 3)
+    assert (decoded_faces == [[0,1,2], [0,2,3]]).all()
+
+    with pytest.raises(RuntimeError):
+        decode_ply_bytes(header + data[:-1])
+
+
+@pytest.mark.parametrize('with_normals', [False, True])
+def test_obj(with_normals, sphere_mesh):
+    vertices, normals, faces = sphere_mesh
+    if not with_normals:
+        normals = EMPTY_NORMALS
+
+    obj = encode_faces_to_obj_bytes(vertices, normals, faces, num_threads=4)
+    lines = obj.decode().splitlines()
+    assert sum(line.startswith('v ') for line in lines) == len(vertices)
+    assert sum(line.startswith('f ') for line in lines) == len(faces)
+
+    # Float32 values survive the round-trip exactly
+    decoded_vertices, decoded_normals, decoded_faces = decode_obj_bytes(obj, num_threads=4)
+    assert (decoded_vertices == vertices).all()
+    assert (decoded_normals == normals).all()
+    assert (decoded_faces == faces).all()
+
+
+def test_obj_foreign():
+    obj = ( b'# A square, with relative indexes and texture coordinates\n'
+            b'o square\n'
+            b'v 0 0 0\nv 1 0 0\r\nv 1 1 0\nv 0 1 0\n'
+            b'vt 0 0\nvn 0 0 1\n'
+            b'f -4/1/1 -3/1/1 -2/1/1 -1/1/1\n'
+            b'f 1//1 2//1 3//1\n' )
+
+    vertices, normals, faces = decode_obj_bytes(obj)
+    assert (vertices == [[0,0,0], [1,0,0], [1,1,0], [0,1,0]]).all()
+    assert (faces == [[0,1,2], [0,2,3], [0,1,2]]).all()
+    assert (normals == [0,0,1]).all()
+
+    with pytest.raises(RuntimeError):
+        decode_obj_bytes(obj + b'f 1 2 5\n')
+
+    with pytest.raises(RuntimeError):
+        decode_obj_bytes(obj + b'v 1 2 x\n')
+
+    # Indexes too long for an int64 are rejected, not overflowed
+    for index in (b'1' + b'0'*30, b'-' + b'9'*30):
+        with pytest.raises(RuntimeError):
+            decode_obj_bytes(obj + b'f 1 2 ' + index + b'\n')
+
+
+@pytest.mark.parametrize('encode', [encode_faces_to_ngmesh_bytes, encode_faces_to_ply_bytes, encode_faces_to_obj_bytes])
+def test_wrong_column_count(encode):
+    vertices = np.array([[0,0,0], [1,0,0], [0,1,0]], np.float32)
+    faces = np.array([[0,1,2]], np.uint32)
+    with pytest.raises(RuntimeError):
+        encode(np.ascontiguousarray(vertices[:, :2]), EMPTY_NORMALS, faces)
+    with pytest.raises(RuntimeError):
+        encode(vertices, EMPTY_NORMALS, np.ascontiguousarray(faces[:, :2]))
+    with pytest.raises(RuntimeError):
+        encode(vertices, np.zeros((3,2), np.float32), faces)
+
+
+if __name__ == "__main__":
+    pytest.main()
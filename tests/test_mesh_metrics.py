@@ -0,0 +1,148 @@
+import pytest
+import numpy as np
+from dvidutils import ( mesh_metrics, mesh_metrics_many, drc_mesh_metrics,
+                        encode_faces_to_drc_bytes, decode_drc_bytes_to_faces )
+
+import faulthandler
+faulthandler.enable()
+
+EMPTY_NORMALS = np.zeros((0,3), np.float32)
+
+
+@pytest.fixture
+def analytic_meshes(cube_mesh, uv_sphere_mesh):
+    return [ cube_mesh(),
+             cube_mesh(origin=(10, -20, 30), size=2.5),
+             uv_sphere_mesh(),
+             uv_sphere_mesh(radius=5.0, center=(100, 200, 300), rings=16, segments=32) ]
+
+
+def numpy_metrics(vertices, faces):
+    a, b, c = (vertices[faces[:, i]].astype(np.float64) for i in range(3))
+    area = np.linalg.norm(np.cross(b-a, c-a), axis=1).sum() / 2
+    dets = (a * np.cross(b, c)).sum(axis=1)
+    volume = dets.sum() / 6
+    centroid = (dets[:, None] * (a+b+c)).sum(axis=0) / (4 * dets.sum())
+    return area, volume, centroid
+
+
+def check_metrics(metrics, vertices, faces):
+    area, volume, centroid = numpy_metrics(vertices, faces)
+    assert metrics['vertex_count'] == len(vertices)
+    assert metrics['face_count'] == len(faces)
+    assert np.isclose(metrics['surface_area'], area)
+    assert np.isclose(metrics['volume'], volume)
+    assert np.allclose(metrics['centroid'], centroid)
+    assert np.allclose(metrics['bounds'][0], vertices.min(axis=0))
+    assert np.allclose(metrics['bounds'][1], vertices.max(axis=0))
+
+
+def test_cube(cube_mesh):
+    vertices, faces = cube_mesh()
+    metrics = mesh_metrics(vertices, faces)
+    assert metrics['vertex_count'] == 8
+    assert metrics['face_count'] == 12
+    assert np.isclose(metrics['surface_area'], 6.0)
+    assert np.isclose(metrics['volume'], 1.0)
+    assert np.allclose(metrics['centroid'], (0.5, 0.5, 0.5))
+    assert np.allclose(metrics['bounds'], [(0,0,0), (1,1,1)])
+
+    # Inward-facing triangles give a negative volume
+    assert np.isclose(mesh_metrics(vertices, faces[:, ::-1])['volume'], -1.0)
+
+
+def test_far_from_origin(cube_mesh):
+    # Sums are taken relative to the mesh, so large coordinates don't lose precision.
+    vertices, faces = cube_mesh(origin=(100000, 200000, 300000), size=2.0)
+    metrics = mesh_metrics(vertices, faces)
+    assert np.isclose(metrics['surface_area'], 24.0)
+    assert np.isclose(metrics['volume'], 8.0)
+    assert np.allclose(metrics['centroid'], (100001, 200001, 300001))
+
+
+def test_open_mesh(cube_mesh):
+    # A flat mesh encloses no volume; its centroid is the mean of its vertices.
+    vertices, faces = cube_mesh()
+    metrics = mesh_metrics(vertices, faces[:2])
+    assert np.isclose(metrics['surface_area'], 1.0)
+    assert metrics['volume'] == 0.0
+    assert np.allclose(metrics['centroid'], vertices.mean(axis=0))
+
+
+def test_empty():
+    metrics = mesh_metrics(np.zeros((0,3), np.float32), np.zeros((0,3), np.uint32))
+    assert metrics['vertex_count'] == metrics['face_count'] == 0
+    assert metrics['surface_area'] == metrics['volume'] == 0.0
+    assert metrics['bounds'] is None
+
+
+def test_bad_faces(cube_mesh):
+    vertices, faces = cube_mesh()
+    with pytest.raises(RuntimeError):
+        mesh_metrics(vertices[:4], faces)
+
+
+def test_wrong_column_count(cube_mesh):
+    vertices, faces = cube_mesh()
+    flat_vertices = np.ascontiguousarray(vertices[:, :2])
+    flat_faces = np.ascontiguousarray(faces[:, :2])
+    with pytest.raises(RuntimeError):
+        mesh_metrics(flat_vertices, faces)
+    with pytest.raises(RuntimeError):
+        mesh_metrics(vertices, flat_faces)
+    with pytest.raises(RuntimeError):
+        mesh_metrics_many([(vertices, faces), (flat_vertices, faces)])
+
+
+def test_uv_sphere(uv_sphere_mesh):
+    radius, center = 5.0, np.array([100, 200, 300])
+    vertices, faces = uv_sphere_mesh(radius, center)
+    metrics = mesh_metrics(vertices, faces)
+    check_metrics(metrics, vertices, faces)
+
+    # The inscribed polyhedron is slightly smaller than the sphere, but symmetric about its center.
+    assert 0.99 < metrics['volume'] / (4/3 * np.pi * radius**3) < 1.0
+    assert 0.99 < metrics['surface_area'] / (4 * np.pi * radius**2) < 1.0
+    assert np.allclose(metrics['centroid'], center, atol=1e-3)
+    assert np.allclose(metrics['bounds'], [center - radius, center + radius], atol=1e-3)
+
+
+def test_noncontiguous(analytic_meshes):
+    for vertices, faces in analytic_meshes:
+        reversed_faces = (len(vertices) - 1 - faces.astype(np.int64)).astype(np.uint32)
+        check_metrics(mesh_metrics(vertices[::-1], reversed_faces[:, ::-1]), vertices[::-1], reversed_faces[:, ::-1])
+
+
+def test_many(analytic_meshes):
+    meshes = analytic_meshes * 3
+    results = mesh_metrics_many(meshes, num_threads=4)
+    assert len(results) == len(meshes)
+    for metrics, (vertices, faces) in zip(results, meshes):
+        check_metrics(metrics, vertices, faces)
+
+    assert mesh_metrics_many([]) == []
+
+
+def test_drc(analytic_meshes):
+    meshes = analytic_meshes * 3
+    drcs = [encode_faces_to_drc_bytes(v, EMPTY_NORMALS, f, position_quantization_bits=0) for v, f in meshes]
+    drcs.append(b'')
+
+    results = drc_mesh_metrics(drcs, num_threads=4)
+    assert len(results) == len(drcs)
+    for metrics, drc, (vertices, faces) in zip(results, drcs, meshes):
+        # Same as measuring the decoded arrays
+        decoded_vertices, _, decoded_faces = decode_drc_bytes_to_faces(drc)
+        check_metrics(metrics, decoded_vertices, decoded_faces)
+
+        # Draco reorders the faces, but (without quantization) the shape is unchanged.
+        expected = mesh_metrics(vertices, faces)
+        for key in ('face_count', 'surface_area', 'volume', 'centroid', 'bounds'):
+            assert np.allclose(metrics[key], expected[key])
+
+    assert results[-1]['face_count'] == 0
+    assert results[-1]['bounds'] is None
+
+
+if __name__ == "__main__":
+    pytest.main()
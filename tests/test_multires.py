@@ -0,0 +1,183 @@
+import struct
+import pytest
+import numpy as np
+from dvidutils import write_multires_mesh, read_multires_mesh, decode_drc_bytes_to_faces
+
+import faulthandler
+faulthandler.enable()
+
+
+def box_mesh(lo, hi):
+    """
+    Returns (vertices, faces) for an axis-aligned box, with outward-facing triangles.
+    """
+    (x0, y0, z0), (x1, y1, z1) = lo, hi
+    vertices = np.array([[x0, y0, z0], [x1, y0, z0], [x0, y1, z0], [x1, y1, z0],
+                         [x0, y0, z1], [x1, y0, z1], [x0, y1, z1], [x1, y1, z1]], np.float32)
+    faces = np.array([[0,2,1], [1,2,3],  # z0
+                      [4,5,6], [5,7,6],  # z1
+                      [0,1,4], [1,5,4],  # y0
+                      [2,6,3], [3,6,7],  # y1
+                      [0,4,2], [2,4,6],  # x0
+                      [1,3,5], [3,7,5]], # x1
+                     np.uint32)
+    return vertices, faces
+
+
+def surface_area(vertices, faces):
+    triangles = vertices[faces].astype(np.float64)
+    cross = np.cross(triangles[:,1] - triangles[:,0], triangles[:,2] - triangles[:,0])
+    return 0.5 * np.linalg.norm(cross, axis=1).sum()
+
+
+def parse_manifest(manifest):
+    """
+    Parse a neuroglancer multi-resolution manifest (see MultiresManifest in multires.hpp)
+    """
+    chunk_shape = np.frombuffer(manifest, '<f4', 3, 0)
+    grid_origin = np.frombuffer(manifest, '<f4', 3, 12)
+    num_lods = struct.unpack_from('<I', manifest, 24)[0]
+    pos = 28
+    lod_scales = np.frombuffer(manifest, '<f4', num_lods, pos)
+    pos += 4*num_lods
+    vertex_offsets = np.frombuffer(manifest, '<f4', 3*num_lods, pos).reshape(num_lods, 3)
+    pos += 12*num_lods
+    num_fragments = np.frombuffer(manifest, '<u4', num_lods, pos)
+    pos += 4*num_lods
+
+    fragment_positions = []
+    fragment_sizes = []
+    for n in num_fragments:
+        fragment_positions.append(np.frombuffer(manifest, '<u4', 3*n, pos).reshape(3, n).transpose())
+        pos += 12*n
+        fragment_sizes.append(np.frombuffer(manifest, '<u4', n, pos))
+        pos += 4*n
+
+    assert pos == len(manifest)
+    return chunk_shape, grid_origin, lod_scales, vertex_offsets, fragment_positions, fragment_sizes
+
+
+def morton(position):
+    code = 0
+    for bit in range(21):
+        for axis in range(3):
+            code |= ((int(position[axis]) >> bit) & 1) << (3*bit + axis)
+    return code
+
+
+def test_write_multires_mesh():
+    vertices, faces = box_mesh((1,1,1), (9,9,9))
+    lod_meshes = [(vertices, faces), (vertices, faces)]
+    bits = 16
+
+    manifest, data = write_multires_mesh(lod_meshes, (4.0, 4.0, 4.0), (0.0, 0.0, 0.0),
+                                         vertex_quantization_bits=bits, num_threads=4)
+
+    chunk_shape, grid_origin, lod_scales, vertex_offsets, fragment_positions, fragment_sizes = parse_manifest(manifest)
+    assert (chunk_shape == 4).all()
+    assert (grid_origin == 0).all()
+    assert (lod_scales == [1, 2]).all()
+    assert (vertex_offsets == 0).all()
+    assert sum(s.sum() for s in fragment_sizes) == len(data)
+
+    # The box surface touches 26 of the 27 cells at LOD 0 (all but the center)
+    assert len(fragment_positions[0]) == 26
+    assert len(fragment_positions[1]) == 8
+
+    offset = 0
+    for lod, (positions, sizes) in enumerate(zip(fragment_positions, fragment_sizes)):
+        # Z-curve order
+        codes = [morton(p) for p in positions]
+        assert codes == sorted(codes)
+
+        fragment_shape = chunk_shape * 2**lod
+        lod_area = 0.0
+        for position, size in zip(positions, sizes):
+            fragment_origin = grid_origin + vertex_offsets[lod] + position * fragment_shape
+            q_vertices, _, q_faces = decode_drc_bytes_to_faces(data[offset:offset+size])
+            offset += size
+
+            # Every fragment must lie within its own cell
+            assert (q_vertices >= 0).all() and (q_vertices <= 2**bits - 1).all()
+
+            frag_vertices = fragment_origin + q_vertices * fragment_shape / (2**bits - 1)
+            lod_area += surface_area(frag_vertices, q_faces)
+
+        assert np.isclose(lod_area, surface_area(vertices, faces), rtol=1e-3)
+
+    # Every LOD 0 fragment has a parent at LOD 1
+    parents = set(map(tuple, fragment_positions[0] // 2))
+    assert parents <= set(map(tuple, fragment_positions[1]))
+
+
+def test_write_multires_empty_parents():
+    # The coarse LOD has no faces near the fine LOD's fragments,
+    # so empty parent fragments must be listed.
+    fine = box_mesh((1,1,1), (3,3,3))
+    coarse = box_mesh((17,17,17), (19,19,19))
+    manifest, data = write_multires_mesh([fine, coarse], (4.0, 4.0, 4.0), (0.0, 0.0, 0.0))
+
+    _, _, _, _, fragment_positions, fragment_sizes = parse_manifest(manifest)
+    assert fragment_positions[0].tolist() == [[0,0,0]]
+    assert sorted(fragment_positions[1].tolist()) == [[0,0,0], [2,2,2]]
+
+    sizes = dict(zip(map(tuple, fragment_positions[1]), fragment_sizes[1]))
+    assert sizes[(0,0,0)] == 0
+    assert sizes[(2,2,2)] > 0
+
+
+def test_write_multires_bad_origin():
+    vertices, faces = box_mesh((1,1,1), (9,9,9))
+    with pytest.raises(RuntimeError):
+        write_multires_mesh([(vertices, faces)], (4.0, 4.0, 4.0), (2.0, 2.0, 2.0))
+
+
+def test_write_multires_wrong_column_count():
+    vertices, faces = box_mesh((1,1,1), (9,9,9))
+    with pytest.raises(RuntimeError):
+        write_multires_mesh([(np.ascontiguousarray(vertices[:, :2]), faces)], (8.0, 8.0, 8.0), (0.0, 0.0, 0.0))
+    with pytest.raises(RuntimeError):
+        write_multires_mesh([(vertices, np.ascontiguousarray(faces[:, :2]))], (8.0, 8.0, 8.0), (0.0, 0.0, 0.0))
+
+
+def test_read_multires_mesh():
+    vertices, faces = box_mesh((1,1,1), (9,9,9))
+    coarse_vertices, coarse_faces = box_mesh((3,3,3), (13,13,13))
+    manifest, data = write_multires_mesh([(vertices, faces), (coarse_vertices, coarse_faces)],
+                                         (4.0, 4.0, 4.0), (0.0, 0.0, 0.0), num_threads=4)
+
+    for lod, (orig_vertices, orig_faces) in enumerate([(vertices, faces), (coarse_vertices, coarse_faces)]):
+        rt_vertices, rt_faces = read_multires_mesh(manifest, data, lod, num_threads=4)
+        assert np.isclose(surface_area(rt_vertices, rt_faces), surface_area(orig_vertices, orig_faces), rtol=1e-3)
+
+        # The box corners survive (to within the quantization step)
+        for corner in orig_vertices:
+            assert np.abs(rt_vertices - corner).max(axis=1).min() < 1e-3
+
+        # Fragments share their boundary vertices, which are welded by default
+        raw_vertices, raw_faces = read_multires_mesh(manifest, data, lod, deduplicate=False)
+        assert len(raw_vertices) > len(rt_vertices)
+        assert len(raw_faces) == len(rt_faces)
+        assert len(np.unique(rt_vertices, axis=0)) == len(rt_vertices)
+
+    # Only the fragments whose cells intersect the bounding box are read:
+    # At LOD 0, the box (0,0,0)-(3,3,3) only touches cell (0,0,0),
+    # which contains the corner of the mesh box.
+    corner_vertices, corner_faces = read_multires_mesh(manifest, data, 0, bounding_box=[(0,0,0), (3,3,3)])
+    assert 0 < len(corner_faces) < len(read_multires_mesh(manifest, data, 0)[1])
+    assert (corner_vertices <= 4 + 1e-3).all()
+    assert np.isclose(surface_area(corner_vertices, corner_faces), 3 * 3*3, rtol=1e-3)
+
+    empty_vertices, empty_faces = read_multires_mesh(manifest, data, 0, bounding_box=[(20,20,20), (30,30,30)])
+    assert empty_vertices.shape == empty_faces.shape == (0, 3)
+
+    with pytest.raises(RuntimeError):
+        read_multires_mesh(manifest, data, 2)
+    with pytest.raises(RuntimeError):
+        read_multires_mesh(manifest[:-1], data)
+    with pytest.raises(RuntimeError):
+        read_multires_mesh(manifest, data[:-1])
+
+
+if __name__ == "__main__":
+    pytest.main()
@@ -0,0 +1,101 @@
+import pytest
+import numpy as np
+from dvidutils import compute_vertex_normals, encode_faces_to_drc_bytes, decode_drc_bytes_to_faces
+
+import faulthandler
+faulthandler.enable()
+
+
+def numpy_normals(vertices, faces, weighting):
+    triangles = vertices[faces].astype(np.float64)
+    face_normals = np.cross(triangles[:,1] - triangles[:,0], triangles[:,2] - triangles[:,0])
+    if weighting == 'area':
+        corner_weights = np.ones((len(faces), 3))
+    else:
+        face_normals /= np.linalg.norm(face_normals, axis=1)[:, None]
+        corner_weights = np.zeros((len(faces), 3))
+        for corner in range(3):
+            ab = triangles[:, (corner+1) % 3] - triangles[:, corner]
+            ac = triangles[:, (corner+2) % 3] - triangles[:, corner]
+            cosine = (ab * ac).sum(axis=1) / np.linalg.norm(ab, axis=1) / np.linalg.norm(ac, axis=1)
+            corner_weights[:, corner] = np.arccos(np.clip(cosine, -1, 1))
+
+    normals = np.zeros(vertices.shape, np.float64)
+    for corner in range(3):
+        np.add.at(normals, faces[:, corner], face_normals * corner_weights[:, corner, None])
+    return normals / np.linalg.norm(normals, axis=1)[:, None]
+
+
+@pytest.mark.parametrize('weighting', ['area', 'angle'])
+def test_compute_vertex_normals(uv_sphere_mesh, weighting):
+    # Enough faces to be split across several threads
+    center = np.array([10, 20, 30])
+    vertices, faces = uv_sphere_mesh(radius=25.0, center=center, rings=100, segments=200)
+    normals = compute_vertex_normals(vertices, faces, weighting, num_threads=4)
+    assert normals.dtype == np.float32
+    assert normals.shape == vertices.shape
+    assert np.allclose(normals, numpy_normals(vertices, faces, weighting), atol=1e-5)
+
+    # Single-threaded result is identical up to summation order
+    single_normals = compute_vertex_normals(vertices, faces, weighting, num_threads=1)
+    assert np.allclose(normals, single_normals, atol=1e-6)
+
+    # The sphere's normals point (very nearly) straight outward
+    radial = vertices - center
+    radial /= np.linalg.norm(radial, axis=1)[:, None]
+    assert ((normals * radial).sum(axis=1) > 0.999).all()
+
+
+def test_cube_normals(cube_mesh):
+    # Each cube corner touches three faces, each at a right angle,
+    # so its angle-weighted normal points exactly along the diagonal.
+    vertices, faces = cube_mesh()
+    normals = compute_vertex_normals(vertices, faces, 'angle')
+    diagonals = (vertices - 0.5) / np.linalg.norm(vertices - 0.5, axis=1)[:, None]
+    assert np.allclose(normals, diagonals, atol=1e-6)
+
+    # Area weighting depends on the triangulation, but still points outward.
+    normals = compute_vertex_normals(vertices, faces, 'area')
+    assert ((normals * diagonals).sum(axis=1) > 0.8).all()
+
+
+def test_compute_vertex_normals_unused_vertex():
+    vertices = np.array([[0,0,0], [1,0,0], [0,1,0], [5,5,5]], np.float32)
+    faces = np.array([[0,1,2]], np.uint32)
+    normals = compute_vertex_normals(vertices, faces)
+    assert (normals[:3] == [0,0,1]).all()
+    assert (normals[3] == 0).all()
+
+    with pytest.raises(RuntimeError):
+        compute_vertex_normals(vertices, faces, 'volume')
+
+    faces[0,0] = 4
+    with pytest.raises(RuntimeError):
+        compute_vertex_normals(vertices, faces)
+
+
+def test_compute_vertex_normals_wrong_column_count():
+    vertices = np.array([[0,0,0], [1,0,0], [0,1,0]], np.float32)
+    faces = np.array([[0,1,2]], np.uint32)
+    with pytest.raises(RuntimeError):
+        compute_vertex_normals(np.ascontiguousarray(vertices[:, :2]), faces)
+    with pytest.raises(RuntimeError):
+        compute_vertex_normals(vertices, np.ascontiguousarray(faces[:, :2]))
+
+
+def test_encode_with_computed_normals(uv_sphere_mesh):
+    vertices, faces = uv_sphere_mesh()
+    empty_normals = np.zeros((0,3), np.float32)
+
+    drc = encode_faces_to_drc_bytes(vertices, empty_normals, faces, compute_normals=True)
+    decoded_vertices, decoded_normals, _ = decode_drc_bytes_to_faces(drc)
+    assert decoded_normals.shape == decoded_vertices.shape
+
+    # Without the option, no normals are stored
+    drc = encode_faces_to_drc_bytes(vertices, empty_normals, faces)
+    _, decoded_normals, _ = decode_drc_bytes_to_faces(drc)
+    assert len(decoded_normals) == 0
+
+
+if __name__ == "__main__":
+    pytest.main()
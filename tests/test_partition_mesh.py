@@ -0,0 +1,92 @@
+import pytest
+import numpy as np
+from dvidutils import partition_mesh, encode_faces_to_custom_drc_bytes, decode_drc_bytes_to_faces
+
+import faulthandler
+faulthandler.enable()
+
+
+def random_mesh(seed, num_vertices=200, num_faces=500):
+    rng = np.random.RandomState(seed)
+    vertices = rng.uniform(0, 40, size=(num_vertices, 3)).astype(np.float32)
+    faces = np.array([rng.choice(num_vertices, 3, replace=False) for _ in range(num_faces)], np.uint32)
+    return vertices, faces
+
+
+def triangle_areas(vertices, faces):
+    triangles = vertices[faces].astype(np.float64)
+    cross = np.cross(triangles[:,1] - triangles[:,0], triangles[:,2] - triangles[:,0])
+    return 0.5 * np.linalg.norm(cross, axis=1)
+
+
+def test_partition_by_centroid():
+    vertices, faces = random_mesh(0)
+    cell_shape = np.array([8, 10, 12], np.int32)
+    origin = np.array([-1, 0, 2], np.int32)
+
+    fragments = partition_mesh(vertices, faces, cell_shape, origin, num_threads=4)
+    
+    total_faces = 0
+    original_triangles = set(map(lambda t: tuple(map(tuple, t)), vertices[faces]))
+    for fragment_origin, frag_vertices, frag_faces in fragments:
+        assert fragment_origin.dtype == np.int32
+        assert ((fragment_origin - origin) % cell_shape == 0).all()
+
+        # Compacted: every vertex is used
+        assert len(np.unique(frag_faces)) == len(frag_vertices)
+
+        # Every face is in the cell that contains its centroid, unchanged
+        centroids = frag_vertices[frag_faces].mean(axis=1)
+        assert (centroids >= fragment_origin - 1e-4).all()
+        assert (centroids < fragment_origin + cell_shape + 1e-4).all()
+
+        for triangle in frag_vertices[frag_faces]:
+            assert tuple(map(tuple, triangle)) in original_triangles
+        total_faces += len(frag_faces)
+
+    assert total_faces == len(faces)
+
+
+def test_partition_split_faces():
+    vertices, faces = random_mesh(1)
+    cell_shape = np.array([8, 10, 12], np.int32)
+    origin = np.array([-1, 0, 2], np.int32)
+
+    fragments = partition_mesh(vertices, faces, cell_shape, origin, split_faces=True)
+
+    total_area = 0.0
+    for fragment_origin, frag_vertices, frag_faces in fragments:
+        # Every vertex lies within the fragment's cell
+        assert (frag_vertices >= fragment_origin - 1e-4).all()
+        assert (frag_vertices <= fragment_origin + cell_shape + 1e-4).all()
+        total_area += triangle_areas(frag_vertices, frag_faces).sum()
+    
+    assert np.isclose(total_area, triangle_areas(vertices, faces).sum(), rtol=1e-4)
+
+    # Fragments are ready for custom encoding
+    fragment_origin, frag_vertices, frag_faces = fragments[0]
+    drc = encode_faces_to_custom_drc_bytes(frag_vertices, np.zeros((0,3), np.float32), frag_faces,
+                                           cell_shape, fragment_origin, position_quantization_bits=10)
+    q_vertices, _, q_faces = decode_drc_bytes_to_faces(drc)
+    assert len(q_faces) == len(frag_faces)
+    assert (q_vertices <= 1023).all()
+
+
+def test_partition_bad_faces():
+    vertices, faces = random_mesh(0)
+    faces[0,0] = len(vertices)
+    with pytest.raises(RuntimeError):
+        partition_mesh(vertices, faces, np.array([8,8,8], np.int32), np.array([0,0,0], np.int32))
+
+
+def test_partition_wrong_column_count():
+    vertices, faces = random_mesh(0)
+    cell_shape, origin = np.array([8,8,8], np.int32), np.array([0,0,0], np.int32)
+    with pytest.raises(RuntimeError):
+        partition_mesh(np.ascontiguousarray(vertices[:, :2]), faces, cell_shape, origin)
+    with pytest.raises(RuntimeError):
+        partition_mesh(vertices, np.ascontiguousarray(faces[:, :2]), cell_shape, origin)
+
+
+if __name__ == "__main__":
+    pytest.main()
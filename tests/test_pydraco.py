@@ -3,7 +3,10 @@ from itertools import product
 import pytest
 import numpy as np
 import pandas as pd
-from dvidutils import encode_faces_to_drc_bytes, decode_drc_bytes_to_faces
+from dvidutils import ( encode_faces_to_drc_bytes, encode_faces_to_custom_drc_bytes, decode_drc_bytes_to_faces,
+                        encode_lattice_faces_to_custom_drc_bytes, encode_many_to_drc_bytes, decode_many_drc_bytes,
+                        decode_drc_bytes_into, decode_many_drc_bytes_into, decode_custom_drc_bytes_to_faces,
+                        DracoBuffer )
 
 import faulthandler
 faulthandler.enable()
@@ -92,7 +95,394 @@ def _hexagon_roundtrip(normals_set):
     
 
 def test_random_roundtrip():
-    np.random.seed(0) # Force deterministic testing.
+    vertices, normals, faces = _random_mesh(0)
+ 
+    #print(f"\nEncoding {len(vertices)} verts, {len(normals)} norms, {len(faces)} faces\n")
+ 
+    # Must use better than default normals quantization, or comparisons
+    # in this test will fail (rounding to nearest .1 isn't enough).
+    drc_bytes = encode_faces_to_drc_bytes(vertices, normals, faces, normal_quantization_bits=14)
+    rt_vertices, rt_normals, rt_faces = decode_drc_bytes_to_faces(drc_bytes)
+      
+    #print(f"\nGot {len(rt_vertices)} verts, {len(rt_normals)} norms, {len(rt_faces)} faces\n")
+         
+    _compare(vertices, normals, faces, rt_vertices, rt_normals, rt_faces, True)
+
+
+def test_encode_many():
+    meshes = [_random_mesh(seed) for seed in range(10)]
+
+    # Include an empty mesh, which should produce an empty buffer
+    empty_mesh = (np.zeros((0,3), np.float32), np.zeros((0,3), np.float32), np.zeros((0,3), np.uint32))
+    meshes.insert(3, empty_mesh)
+
+    drc_list = encode_many_to_drc_bytes(meshes, num_threads=4, normal_quantization_bits=14)
+    assert len(drc_list) == len(meshes)
+    assert drc_list[3] == b''
+
+    for (vertices, normals, faces), drc_bytes in zip(meshes, drc_list):
+        # Results should be identical to the single-mesh function
+        assert drc_bytes == encode_faces_to_drc_bytes(vertices, normals, faces, normal_quantization_bits=14)
+        if len(faces) > 0:
+            rt_vertices, rt_normals, rt_faces = decode_drc_bytes_to_faces(drc_bytes)
+            _compare(vertices, normals, faces, rt_vertices, rt_normals, rt_faces, True)
+
+
+def test_encode_many_bad_mesh():
+    vertices, normals, faces = _random_mesh(0)
+    bad_faces = faces.copy()
+    bad_faces[0,0] = len(vertices)
+    
+    with pytest.raises(RuntimeError):
+        encode_many_to_drc_bytes([(vertices, normals, faces), (vertices, normals, bad_faces)], num_threads=2)
+
+
+def test_decode_many():
+    meshes = [_random_mesh(seed) for seed in range(10)]
+    drc_list = [encode_faces_to_drc_bytes(v, n, f, normal_quantization_bits=14) for (v, n, f) in meshes]
+    drc_list.insert(3, b'')
+
+    decoded = decode_many_drc_bytes(drc_list, num_threads=4)
+    assert len(decoded) == len(drc_list)
+
+    rt_vertices, rt_normals, rt_faces = decoded[3]
+    assert rt_vertices.shape == rt_normals.shape == rt_faces.shape == (0,3)
+    del decoded[3]
+
+    for (vertices, normals, faces), (rt_vertices, rt_normals, rt_faces) in zip(meshes, decoded):
+        _compare(vertices, normals, faces, rt_vertices, rt_normals, rt_faces, True)
+
+
+def test_decode_many_concatenate():
+    meshes = [_random_mesh(seed) for seed in range(10)]
+    drc_list = [encode_faces_to_drc_bytes(v, n, f, normal_quantization_bits=14) for (v, n, f) in meshes]
+    drc_list.insert(3, b'')
+
+    separate = [decode_drc_bytes_to_faces(b) for b in drc_list]
+    rt_vertices, rt_normals, rt_faces = decode_many_drc_bytes(drc_list, num_threads=4, concatenate=True)
+
+    assert (rt_vertices == np.concatenate([v for (v, _, _) in separate])).all()
+    assert (rt_normals == np.concatenate([n for (_, n, _) in separate])).all()
+    
+    offsets = np.cumsum([0] + [len(v) for (v, _, _) in separate])
+    expected_faces = np.concatenate([f + offset for (_, _, f), offset in zip(separate, offsets)])
+    assert (rt_faces == expected_faces).all()
+
+    # If any mesh lacks normals, no normals are returned.
+    v, _, f = meshes[0]
+    drc_list.append(encode_faces_to_drc_bytes(v, np.zeros((0,3), np.float32), f))
+    rt_vertices, rt_normals, rt_faces = decode_many_drc_bytes(drc_list, concatenate=True)
+    assert rt_normals.shape == (0,3)
+    assert len(rt_vertices) == offsets[-1] + len(decode_drc_bytes_to_faces(drc_list[-1])[0])
+
+
+def test_decode_into():
+    meshes = [_random_mesh(seed) for seed in range(10)]
+    drc_list = [encode_faces_to_drc_bytes(v, n, f, normal_quantization_bits=14) for (v, n, f) in meshes]
+    drc_list.insert(3, b'')
+    expected_vertices, expected_normals, expected_faces = decode_many_drc_bytes(drc_list, concatenate=True)
+
+    # Leave some room before and after the decoded meshes
+    vertices = np.full((len(expected_vertices) + 7, 3), -1, np.float32)
+    normals = np.full((len(expected_vertices) + 7, 3), -1, np.float32)
+    faces = np.full((len(expected_faces) + 9, 3), 99, np.uint32)
+
+    counts = decode_many_drc_bytes_into(drc_list, vertices, normals, faces, vertex_offset=5, face_offset=2, num_threads=4)
+    assert counts == (len(expected_vertices), len(expected_faces))
+    assert (vertices[5:-2] == expected_vertices).all()
+    assert (normals[5:-2] == expected_normals).all()
+    assert (faces[2:-7] == expected_faces + 5).all()
+    assert (vertices[:5] == -1).all() and (vertices[-2:] == -1).all()
+    assert (faces[:2] == 99).all() and (faces[-7:] == 99).all()
+
+    # Single buffer, explicit face index offset, no normals
+    v, n, f = decode_drc_bytes_to_faces(drc_list[0])
+    vertices = np.zeros((len(v) + 1, 3), np.float32)
+    faces = np.zeros((len(f), 3), np.uint32)
+    counts = decode_drc_bytes_into(drc_list[0], vertices, np.zeros((0,3), np.float32), faces,
+                                   vertex_offset=1, face_index_offset=100)
+    assert counts == (len(v), len(f))
+    assert (vertices[1:] == v).all()
+    assert (faces == f + 100).all()
+
+    # Too small
+    with pytest.raises(RuntimeError):
+        decode_drc_bytes_into(drc_list[0], vertices, np.zeros((0,3), np.float32), faces[:-1])
+
+    # Wrong dtype or non-contiguous arrays can't be written in place
+    with pytest.raises(TypeError):
+        decode_drc_bytes_into(drc_list[0], vertices.astype(np.float64), np.zeros((0,3), np.float32), faces)
+    with pytest.raises(RuntimeError):
+        decode_drc_bytes_into(drc_list[0], np.zeros((len(v), 6), np.float32)[:, ::2], np.zeros((0,3), np.float32), faces)
+
+
+def test_decode_without_deduplication():
+    vertices, normals, faces = _random_mesh(0)
+    drc_bytes = encode_faces_to_drc_bytes(vertices, normals, faces, normal_quantization_bits=14)
+
+    dedup_vertices, _, _ = decode_drc_bytes_to_faces(drc_bytes)
+    rt_vertices, rt_normals, rt_faces = decode_drc_bytes_to_faces(drc_bytes, deduplicate=False)
+    assert len(rt_vertices) >= len(dedup_vertices)
+    assert len(rt_normals) == len(rt_vertices)
+
+    # Same geometry, possibly with some extra (duplicate) vertices.
+    def triangle_set(v, f):
+        return set(tuple(sorted(map(tuple, np.round(v[face], 2)))) for face in f)
+
+    assert triangle_set(vertices, faces) == triangle_set(rt_vertices, rt_faces)
+
+    for (rt_vertices, _, rt_faces) in decode_many_drc_bytes([drc_bytes]*3, deduplicate=False):
+        assert triangle_set(vertices, faces) == triangle_set(rt_vertices, rt_faces)
+
+
+def test_noncontiguous_input():
+    vertices, normals, faces = _random_mesh(0)
+    
+    # Reversed views are not C-contiguous; results must match packed copies.
+    rev_vertices = vertices[:, ::-1]
+    rev_normals = normals[:, ::-1]
+    rev_faces = faces[:, ::-1]
+    assert not rev_vertices.flags['C_CONTIGUOUS']
+
+    packed = encode_faces_to_drc_bytes(rev_vertices.copy(), rev_normals.copy(), rev_faces.copy())
+    assert encode_faces_to_drc_bytes(rev_vertices, rev_normals, rev_faces) == packed
+
+    fragment_shape = np.array([10,10,10], np.int32)
+    fragment_origin = np.array([0,0,0], np.int32)
+    packed = encode_faces_to_custom_drc_bytes(rev_vertices.copy(), rev_normals.copy(), rev_faces.copy(),
+                                              fragment_shape, fragment_origin, position_quantization_bits=10)
+    assert encode_faces_to_custom_drc_bytes(rev_vertices, rev_normals, rev_faces,
+                                            fragment_shape, fragment_origin, position_quantization_bits=10) == packed
+
+
+def test_wrong_column_count():
+    # An (N,2) array must be rejected, not read as if it had 3 columns.
+    vertices, normals, faces = _random_mesh(0)
+    flat_vertices = np.ascontiguousarray(vertices[:, :2])
+    flat_faces = np.ascontiguousarray(faces[:, :2])
+    empty_normals = np.zeros((0,3), np.float32)
+
+    calls = [
+        lambda v, f: encode_faces_to_drc_bytes(v, empty_normals, f),
+        lambda v, f: encode_faces_to_custom_drc_bytes(v, empty_normals, f, np.array([10,10,10], np.int32),
+                                                      np.array([0,0,0], np.int32), position_quantization_bits=10),
+        lambda v, f: encode_many_to_drc_bytes([(v, empty_normals, f)]),
+        lambda v, f: encode_lattice_faces_to_custom_drc_bytes(v.astype(np.uint32), f, np.array([1,1,1], np.int32),
+                                                              np.array([0,0,0], np.int32)),
+    ]
+    for call in calls:
+        with pytest.raises(RuntimeError):
+            call(flat_vertices, faces)
+        with pytest.raises(RuntimeError):
+            call(vertices, flat_faces)
+
+    with pytest.raises(RuntimeError):
+        encode_faces_to_drc_bytes(vertices, np.ascontiguousarray(normals[:, :2]), faces)
+
+
+def test_return_buffer():
+    vertices, normals, faces = _random_mesh(0)
+    drc_bytes = encode_faces_to_drc_bytes(vertices, normals, faces)
+
+    buf = encode_faces_to_drc_bytes(vertices, normals, faces, return_buffer=True)
+    assert isinstance(buf, DracoBuffer)
+    assert len(buf) == len(drc_bytes)
+    assert buf.tobytes() == drc_bytes
+
+    view = memoryview(buf)
+    assert view.format == 'B' and view.nbytes == len(drc_bytes)
+    assert bytes(view) == drc_bytes
+
+    # The encoded bytes can't be modified in place
+    assert view.readonly
+    with pytest.raises(TypeError):
+        view[0] = 0
+    assert not np.frombuffer(buf, np.uint8).flags['WRITEABLE']
+
+    fragment_shape = np.array([10,10,10], np.int32)
+    fragment_origin = np.array([0,0,0], np.int32)
+    custom_bytes = encode_faces_to_custom_drc_bytes(vertices, normals, faces, fragment_shape, fragment_origin)
+    buf = encode_faces_to_custom_drc_bytes(vertices, normals, faces, fragment_shape, fragment_origin, return_buffer=True)
+    assert bytes(buf) == custom_bytes
+
+    empty_mesh = (np.zeros((0,3), np.float32), np.zeros((0,3), np.float32), np.zeros((0,3), np.uint32))
+    bufs = encode_many_to_drc_bytes([(vertices, normals, faces), empty_mesh], return_buffer=True)
+    assert bytes(bufs[0]) == drc_bytes
+    assert bytes(bufs[1]) == b''
+
+
+def test_custom_dequantize():
+    vertices, normals, faces = _random_mesh(0)
+    vertices = vertices * 1.7 + 3.3
+    fragment_shape = np.array([20,30,40], np.int32)
+    fragment_origin = np.array([1,2,3], np.int32)
+    bits = 10
+
+    drc_bytes = encode_faces_to_custom_drc_bytes(vertices, normals, faces, fragment_shape, fragment_origin,
+                                                 position_quantization_bits=bits)
+
+    # Same as rescaling the raw quantized values in numpy
+    q_vertices, _, q_faces = decode_drc_bytes_to_faces(drc_bytes)
+    expected = (fragment_origin + q_vertices.astype(np.float64) * fragment_shape / (2**bits - 1)).astype(np.float32)
+
+    rt_vertices, rt_normals, rt_faces = decode_custom_drc_bytes_to_faces(drc_bytes, fragment_shape, fragment_origin, bits)
+    assert np.allclose(rt_vertices, expected, rtol=0, atol=1e-5)
+    assert (rt_faces == q_faces).all()
+    assert rt_normals.shape == (0,3)
+
+    # Each vertex is within half a quantization step of the original
+    step = fragment_shape / (2**bits - 1)
+    close = (np.abs(rt_vertices[:, None, :] - vertices[None, :, :]) <= step/2 + 1e-4).all(axis=2)
+    assert close.any(axis=1).all()
+
+    # Ordinary (float) meshes can't be dequantized
+    with pytest.raises(RuntimeError):
+        decode_custom_drc_bytes_to_faces(encode_faces_to_drc_bytes(vertices, normals, faces),
+                                         fragment_shape, fragment_origin, bits)
+
+
+def test_lattice_encode():
+    vertices, normals, faces = _random_mesh(0)
+    lattice_vertices = vertices.astype(np.uint32) + 5
+
+    # With a fragment of 1023 units and 10 bits, each lattice unit is exactly one quantization step,
+    # so the float path must produce the same quantized values as the integer path.
+    float_bytes = encode_faces_to_custom_drc_bytes(lattice_vertices.astype(np.float32), normals, faces,
+                                                   np.array([1023]*3, np.int32), np.array([5]*3, np.int32),
+                                                   position_quantization_bits=10)
+    
+    for dtype in (np.uint32, np.uint16):
+        lattice_bytes = encode_lattice_faces_to_custom_drc_bytes(lattice_vertices.astype(dtype), faces,
+                                                                 np.array([1]*3, np.int32), np.array([5]*3, np.int32),
+                                                                 position_quantization_bits=10)
+        assert lattice_bytes == float_bytes
+
+    # Scaled lattice
+    rt_vertices, _, rt_faces = decode_drc_bytes_to_faces(
+        encode_lattice_faces_to_custom_drc_bytes(lattice_vertices, faces,
+                                                 np.array([2,3,4], np.int32), np.array([5]*3, np.int32),
+                                                 position_quantization_bits=10))
+    expected = (lattice_vertices - 5) * [2,3,4]
+    assert set(map(tuple, rt_vertices)) == set(map(tuple, expected.astype(np.float32)))
+
+    # Attributes and return_buffer work as in the float path
+    attributes = _vertex_attributes(vertices)
+    float_bytes = encode_faces_to_custom_drc_bytes(lattice_vertices.astype(np.float32), normals, faces,
+                                                   np.array([1023]*3, np.int32), np.array([5]*3, np.int32),
+                                                   position_quantization_bits=10, generic_quantization_bits=0,
+                                                   attributes=attributes)
+    buf = encode_lattice_faces_to_custom_drc_bytes(lattice_vertices, faces,
+                                                   np.array([1]*3, np.int32), np.array([5]*3, np.int32),
+                                                   position_quantization_bits=10, generic_quantization_bits=0,
+                                                   return_buffer=True, attributes=attributes)
+    assert isinstance(buf, DracoBuffer)
+    assert bytes(buf) == float_bytes
+
+    # Out of range
+    with pytest.raises(RuntimeError):
+        encode_lattice_faces_to_custom_drc_bytes(lattice_vertices, faces,
+                                                 np.array([1]*3, np.int32), np.array([6]*3, np.int32),
+                                                 position_quantization_bits=10)
+
+    with pytest.raises(RuntimeError):
+        encode_lattice_faces_to_custom_drc_bytes(lattice_vertices, faces,
+                                                 np.array([200]*3, np.int32), np.array([0]*3, np.int32),
+                                                 position_quantization_bits=10)
+
+
+def _vertex_attributes(vertices):
+    """
+    Per-vertex attributes for the given (integer-valued) vertices,
+    computed from the vertex positions so they can be checked after a roundtrip,
+    no matter how draco reorders (or merges) the vertices.
+    """
+    v = np.round(vertices).astype(np.int64)
+
+    # Near 0 or near 2**32-1 (depending on x), so the values span the full uint32 range.
+    yz = 10*v[:,1] + v[:,2]
+    label = np.where(v[:,0] % 2 == 0, yz, 2**32 - 1 - yz)
+
+    return {
+        'supervoxel': (2**40 + 100*v[:,0] + 10*v[:,1] + v[:,2]).astype(np.uint64),
+        'label': label.astype(np.uint32),
+        'thickness': v.sum(axis=1).astype(np.float32),
+        'pair': v[:, :2].astype(np.int16) - 5,
+    }
+
+
+def _check_attributes(rt_vertices, rt_attributes):
+    expected = _vertex_attributes(rt_vertices)
+    assert sorted(rt_attributes.keys()) == sorted(expected.keys())
+    for name, values in expected.items():
+        assert rt_attributes[name].dtype == values.dtype, name
+        assert rt_attributes[name].shape == values.shape, name
+        assert (rt_attributes[name] == values).all(), name
+
+
+def test_generic_attributes():
+    vertices, normals, faces = _random_mesh(0)
+    attributes = _vertex_attributes(vertices)
+    # Float attributes aren't quantized by default.
+    drc_bytes = encode_faces_to_drc_bytes(vertices, normals, faces, normal_quantization_bits=14, attributes=attributes)
+
+    rt_vertices, rt_normals, rt_faces, rt_attributes = decode_drc_bytes_to_faces(drc_bytes, return_attributes=True)
+    _compare(vertices, normals, faces, rt_vertices, rt_normals, rt_faces, True)
+    _check_attributes(rt_vertices, rt_attributes)
+
+    # Without return_attributes, the usual triple is returned.
+    assert len(decode_drc_bytes_to_faces(drc_bytes)) == 3
+
+    # Meshes without attributes yield an empty dict.
+    drc_bytes = encode_faces_to_drc_bytes(vertices, normals, faces)
+    assert decode_drc_bytes_to_faces(drc_bytes, return_attributes=True)[3] == {}
+    assert decode_drc_bytes_to_faces(b'', return_attributes=True)[3] == {}
+
+    # The 'custom' format can carry attributes, too.
+    fragment_shape = np.array([10, 10, 10], np.int32)
+    fragment_origin = np.array([0, 0, 0], np.int32)
+    drc_bytes = encode_faces_to_custom_drc_bytes(vertices, normals, faces, fragment_shape, fragment_origin,
+                                                 position_quantization_bits=10, generic_quantization_bits=0,
+                                                 attributes=attributes)
+    rt_vertices, _, _ = decode_custom_drc_bytes_to_faces(drc_bytes, fragment_shape, fragment_origin,
+                                                         position_quantization_bits=10)
+    _, _, _, rt_attributes = decode_drc_bytes_to_faces(drc_bytes, return_attributes=True)
+    _check_attributes(rt_vertices, rt_attributes)
+
+    # Each attribute must have one row per vertex
+    with pytest.raises(RuntimeError):
+        encode_faces_to_drc_bytes(vertices, normals, faces, attributes={'x': np.zeros(len(vertices)-1, np.uint32)})
+
+
+def test_generic_attributes_many():
+    meshes = [_random_mesh(seed) for seed in range(10)]
+    attributes_list = [_vertex_attributes(v) for (v, _, _) in meshes]
+
+    drc_list = encode_many_to_drc_bytes(meshes, num_threads=4, generic_quantization_bits=0,
+                                        attributes_list=attributes_list)
+    for (v, n, f), attributes, drc_bytes in zip(meshes, attributes_list, drc_list):
+        assert drc_bytes == encode_faces_to_drc_bytes(v, n, f, generic_quantization_bits=0, attributes=attributes)
+
+    decoded = decode_many_drc_bytes(drc_list, num_threads=4, return_attributes=True)
+    for rt_vertices, _, _, rt_attributes in decoded:
+        _check_attributes(rt_vertices, rt_attributes)
+
+    # Concatenated attributes
+    drc_list.insert(3, b'')
+    rt_vertices, _, _, rt_attributes = decode_many_drc_bytes(drc_list, concatenate=True, return_attributes=True)
+    _check_attributes(rt_vertices, rt_attributes)
+
+    # Meshes with different attributes can't be concatenated
+    v, n, f = meshes[0]
+    drc_list.append(encode_faces_to_drc_bytes(v, n, f))
+    with pytest.raises(RuntimeError):
+        decode_many_drc_bytes(drc_list, concatenate=True, return_attributes=True)
+
+    with pytest.raises(RuntimeError):
+        encode_many_to_drc_bytes(meshes, attributes_list=attributes_list[:-1])
+
+
+def _random_mesh(seed):
+    np.random.seed(seed) # Force deterministic testing.
     
     vertices = np.zeros((10,3), dtype=np.float32)
     vertices[:,0] = np.random.choice(list(range(10)), size=(10,))
@@ -116,17 +506,7 @@ def test_random_roundtrip():
     faces = pd.DataFrame(faces)
     faces.drop_duplicates(inplace=True)
     faces = faces.values
- 
-    #print(f"\nEncoding {len(vertices)} verts, {len(normals)} norms, {len(faces)} faces\n")
- 
-    # Must use better than default normals quantization, or comparisons
-    # in this test will fail (rounding to nearest .1 isn't enough).
-    drc_bytes = encode_faces_to_drc_bytes(vertices, normals, faces, normal_quantization_bits=14)
-    rt_vertices, rt_normals, rt_faces = decode_drc_bytes_to_faces(drc_bytes)
-      
-    #print(f"\nGot {len(rt_vertices)} verts, {len(rt_normals)} norms, {len(rt_faces)} faces\n")
-         
-    _compare(vertices, normals, faces, rt_vertices, rt_normals, rt_faces, True)
+    return vertices, normals, faces
 
 
 def _compare(vertices, normals, faces, rt_vertices, rt_normals, rt_faces, check_normals): 
@@ -0,0 +1,105 @@
+import pytest
+import numpy as np
+from dvidutils import simplify_mesh, simplify_mesh_lods, encode_faces_to_drc_bytes, decode_drc_bytes_to_faces
+
+import faulthandler
+faulthandler.enable()
+
+
+def grid_mesh(n=30):
+    """
+    Returns (vertices, faces) for a flat, open n x n grid in the z=0 plane.
+    """
+    ys, xs = np.mgrid[:n+1, :n+1]
+    vertices = np.stack([xs.ravel(), ys.ravel(), np.zeros(xs.size)], axis=1).astype(np.float32)
+    faces = []
+    for y in range(n):
+        for x in range(n):
+            a = y*(n+1) + x
+            faces.append((a, a+1, a+n+1))
+            faces.append((a+1, a+n+2, a+n+1))
+    return vertices, np.array(faces, np.uint32)
+
+
+def edge_face_counts(faces):
+    edges = np.sort(np.concatenate([faces[:, [0,1]], faces[:, [1,2]], faces[:, [2,0]]]), axis=1)
+    _, counts = np.unique(edges, axis=0, return_counts=True)
+    return counts
+
+
+def test_simplify_sphere(uv_sphere_mesh):
+    vertices, faces = uv_sphere_mesh(rings=40, segments=80)
+    radius = np.linalg.norm(vertices, axis=1).max()
+
+    simple_vertices, simple_faces = simplify_mesh(vertices, faces, 0.1)
+    assert simple_vertices.dtype == np.float32
+    assert simple_faces.dtype == np.uint32
+    assert 0 < len(simple_faces) <= round(0.1 * len(faces))
+    assert simple_faces.max() < len(simple_vertices)
+
+    # Still a closed, manifold surface
+    assert (edge_face_counts(simple_faces) == 2).all()
+
+    # Still a sphere
+    assert np.allclose(np.linalg.norm(simple_vertices, axis=1), radius, rtol=0.05)
+
+    # Unused vertices are dropped
+    assert len(np.unique(simple_faces)) == len(simple_vertices)
+
+
+def test_simplify_lods(uv_sphere_mesh):
+    vertices, faces = uv_sphere_mesh(rings=40, segments=80)
+    fractions = [1.0, 0.5, 0.25, 0.1]
+    lods = simplify_mesh_lods(vertices, faces, fractions)
+    assert len(lods) == len(fractions)
+    assert len(lods[0][1]) == len(faces)
+
+    face_counts = [len(f) for (_, f) in lods]
+    assert face_counts == sorted(face_counts, reverse=True)
+    for (lod_vertices, lod_faces), fraction in zip(lods, fractions):
+        assert len(lod_faces) <= round(fraction * len(faces))
+
+        # The output can be encoded directly
+        drc = encode_faces_to_drc_bytes(lod_vertices, np.zeros((0,3), np.float32), lod_faces)
+        _, _, decoded_faces = decode_drc_bytes_to_faces(drc)
+        assert len(decoded_faces) == len(lod_faces)
+
+    with pytest.raises(RuntimeError):
+        simplify_mesh_lods(vertices, faces, [0.1, 0.5])
+
+
+def test_simplify_preserve_boundary():
+    vertices, faces = grid_mesh()
+    n = 30
+
+    def boundary_vertices(v):
+        on_edge = (v[:, 0] == 0) | (v[:, 0] == n) | (v[:, 1] == 0) | (v[:, 1] == n)
+        return set(map(tuple, v[on_edge]))
+
+    simple_vertices, simple_faces = simplify_mesh(vertices, faces, 0.2, preserve_boundary=True)
+    assert len(simple_faces) <= round(0.2 * len(faces))
+
+    # The grid is flat, so it stays flat
+    assert (simple_vertices[:, 2] == 0).all()
+
+    # Every original boundary vertex survives
+    assert boundary_vertices(vertices) <= boundary_vertices(simple_vertices)
+
+
+def test_simplify_bad_faces(uv_sphere_mesh):
+    vertices, faces = uv_sphere_mesh(rings=4, segments=8)
+    faces[0, 0] = len(vertices)
+    with pytest.raises(RuntimeError):
+        simplify_mesh(vertices, faces, 0.5)
+
+
+def test_simplify_wrong_column_count(uv_sphere_mesh):
+    vertices, faces = uv_sphere_mesh(rings=4, segments=8)
+    with pytest.raises(RuntimeError):
+        simplify_mesh(np.ascontiguousarray(vertices[:, :2]), faces, 0.5)
+    with pytest.raises(RuntimeError):
+        simplify_mesh_lods(vertices, np.ascontiguousarray(faces[:, :2]), [0.5])
+
+
+if __name__ == "__main__":
+    pytest.main()
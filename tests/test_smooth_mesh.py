@@ -0,0 +1,95 @@
+import pytest
+import numpy as np
+from dvidutils import smooth_mesh
+
+import faulthandler
+faulthandler.enable()
+
+
+def grid_mesh(n=20, seed=0):
+    """
+    An open n x n grid in the XY plane, with noisy Z.
+    """
+    y, x = np.mgrid[:n, :n]
+    z = np.random.RandomState(seed).uniform(-1, 1, (n, n))
+    vertices = np.stack([x, y, z], axis=-1).reshape(-1, 3).astype(np.float32)
+
+    a = (y[:-1, :-1] * n + x[:-1, :-1]).reshape(-1)
+    b, c, d = a + 1, a + n, a + n + 1
+    faces = np.concatenate([np.stack([a, b, d], axis=1), np.stack([a, d, c], axis=1)]).astype(np.uint32)
+    return vertices, faces
+
+
+def numpy_smooth(vertices, faces, iterations, lambda_, mu):
+    n = len(vertices)
+    edges = np.concatenate([faces[:, [0,1]], faces[:, [1,2]], faces[:, [2,0]]])
+    edges = np.unique(np.sort(edges, axis=1), axis=0)
+    adjacency = np.zeros((n, n))
+    adjacency[edges[:,0], edges[:,1]] = 1
+    adjacency[edges[:,1], edges[:,0]] = 1
+    degree = adjacency.sum(axis=1)[:, None]
+
+    v = vertices.astype(np.float64)
+    for _ in range(iterations):
+        for factor in (lambda_, mu):
+            v = v + factor * (adjacency.dot(v) / degree - v)
+    return v
+
+
+def test_smooth_grid():
+    vertices, faces = grid_mesh()
+    smoothed = smooth_mesh(vertices, faces, iterations=5, lambda_=0.5, mu=-0.53, num_threads=4)
+    assert smoothed.dtype == np.float32 and smoothed.shape == vertices.shape
+    assert np.allclose(smoothed, numpy_smooth(vertices, faces, 5, 0.5, -0.53), atol=1e-4)
+    assert smoothed[:, 2].std() < vertices[:, 2].std()
+
+    # Same result with any number of threads
+    assert (smooth_mesh(vertices, faces, iterations=5, num_threads=1) == smooth_mesh(vertices, faces, iterations=5)).all()
+
+
+def test_fix_boundary():
+    n = 20
+    vertices, faces = grid_mesh(n)
+    smoothed = smooth_mesh(vertices, faces, iterations=5, fix_boundary=True)
+
+    y, x = np.divmod(np.arange(n*n), n)
+    boundary = (x == 0) | (x == n-1) | (y == 0) | (y == n-1)
+    assert (smoothed[boundary] == vertices[boundary]).all()
+    assert (smoothed[~boundary] != vertices[~boundary]).any(axis=1).all()
+
+
+def test_taubin_volume(label_sphere_mesh):
+    vertices, faces = label_sphere_mesh()
+    center = vertices.mean(axis=0)
+    radius = np.linalg.norm(vertices - center, axis=1).mean()
+
+    # Plain Laplacian smoothing shrinks the mesh, but Taubin smoothing (mostly) doesn't.
+    laplacian = smooth_mesh(vertices, faces, iterations=20, lambda_=0.5, mu=0.0)
+    taubin = smooth_mesh(vertices, faces, iterations=20, lambda_=0.5, mu=-0.53)
+
+    laplacian_radius = np.linalg.norm(laplacian - center, axis=1).mean()
+    taubin_radius = np.linalg.norm(taubin - center, axis=1).mean()
+    assert laplacian_radius < radius
+    assert abs(taubin_radius - radius) < abs(laplacian_radius - radius)
+
+    # Smoother: less variation in the distance to the center
+    assert np.linalg.norm(taubin - center, axis=1).std() < np.linalg.norm(vertices - center, axis=1).std()
+
+
+def test_bad_faces():
+    vertices, faces = grid_mesh()
+    faces[0,0] = len(vertices)
+    with pytest.raises(RuntimeError):
+        smooth_mesh(vertices, faces)
+
+
+def test_wrong_column_count():
+    vertices, faces = grid_mesh()
+    with pytest.raises(RuntimeError):
+        smooth_mesh(np.ascontiguousarray(vertices[:, :2]), faces)
+    with pytest.raises(RuntimeError):
+        smooth_mesh(vertices, np.ascontiguousarray(faces[:, :2]))
+
+
+if __name__ == "__main__":
+    pytest.main()